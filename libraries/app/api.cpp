@@ -28,6 +28,8 @@
 
 #include "database_api_helper.hxx"
 
+#include <graphene/account_history/account_history_plugin.hpp>
+
 #include <fc/crypto/base64.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/thread/future.hpp>
@@ -373,6 +375,135 @@ namespace graphene { namespace app {
     { // Nothing else to do
     }
 
+    /// @return the store of the account history that was removed from memory, or null if it is not used
+    static std::shared_ptr<const account_history::history_store> get_history_store( const application& app )
+    {
+       if( !app.is_plugin_enabled( "account_history" ) )
+          return nullptr;
+       return app.get_plugin<account_history::account_history_plugin>( "account_history" )->get_history_store();
+    }
+
+    /// @return the index of the account history by operation type, or null if it is not used
+    static const account_history::operation_type_history_index* get_operation_type_history_index(
+          const application& app )
+    {
+       if( !app.is_plugin_enabled( "account_history" ) )
+          return nullptr;
+       return app.get_plugin<account_history::account_history_plugin>( "account_history" )
+                 ->get_operation_type_history_index();
+    }
+
+    /// @return the entries of the account history with sequence numbers from @p start down to @p stop, at most
+    ///         @p limit, from memory and from the history store
+    static vector<operation_history_object> get_account_history_by_sequence( const application& app,
+          const account_statistics_object& stats, uint64_t stop, uint32_t limit, uint64_t start )
+    {
+       const auto& db = *app.chain_database();
+       const account_id_type account = stats.owner;
+       vector<operation_history_object> result;
+       if( start >= stop && start > stats.removed_ops && limit > 0 )
+       {
+          const auto& hist_idx = db.get_index_type<account_history_index>();
+          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+
+          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
+          auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
+
+          do
+          {
+             --itr;
+             result.push_back( itr->operation_id(db) );
+          }
+          while ( itr != itr_stop && result.size() < limit );
+       }
+
+       // the entries up to removed_ops may be in the history store
+       const auto store = get_history_store( app );
+       if( store && limit > 0 )
+       {
+          for( uint64_t seq = std::min( start, stats.removed_ops );
+               seq >= std::max<uint64_t>( stop, 1 ) && result.size() < limit; --seq )
+          {
+             const auto op_id = store->get_account_history_entry( account, seq );
+             if( !op_id.valid() )
+                break;
+             const auto op = store->get_operation( *op_id );
+             if( op.valid() )
+                result.push_back( *op );
+          }
+       }
+       return result;
+    }
+
+    /// @return the block time of the entry of the account history with the sequence number, if it is available
+    static optional<time_point_sec> get_account_history_time( const graphene::chain::database& db,
+                                                              const account_history::history_store* store,
+                                                              const account_statistics_object& stats,
+                                                              uint64_t sequence )
+    {
+       if( sequence > stats.removed_ops )
+       {
+          const auto& by_seq_idx = db.get_index_type<account_history_index>().indices().get<by_seq>();
+          auto itr = by_seq_idx.find( boost::make_tuple( stats.owner, sequence ) );
+          if( itr != by_seq_idx.end() )
+             return itr->operation_id(db).block_time;
+       }
+       else if( store != nullptr )
+       {
+          const auto op_id = store->get_account_history_entry( stats.owner, sequence );
+          if( op_id.valid() )
+          {
+             const auto op = store->get_operation( *op_id );
+             if( op.valid() )
+                return op->block_time;
+          }
+       }
+       return {};
+    }
+
+    /**
+     * @return the sequence number of the latest entry of the account history whose block time is not after
+     *         @p time, or 0 if there is none
+     *
+     * The time marks of the account narrow the search down to the entries between two marks, which are searched
+     * by bisection. Without marks, e.g. for history that was recorded before them, the whole history is bisected.
+     */
+    static uint64_t find_account_history_by_time( const application& app, const account_statistics_object& stats,
+                                                  const time_point_sec& time )
+    {
+       const auto& db = *app.chain_database();
+       const auto store = get_history_store( app );
+       uint64_t first = store ? 1 : stats.removed_ops + 1;
+       uint64_t last = stats.total_ops;
+
+       if( app.is_plugin_enabled( "account_history" ) )
+       {
+          const auto& mark_idx = db.get_index_type<account_history::history_time_mark_index>()
+                                   .indices().get<by_time>();
+          auto itr = mark_idx.upper_bound( boost::make_tuple( stats.owner, time ) );
+          if( itr != mark_idx.end() && itr->account == stats.owner )
+             last = std::min( last, itr->sequence - 1 );
+          if( itr != mark_idx.begin() && (--itr)->account == stats.owner )
+             first = std::max( first, itr->sequence );
+       }
+
+       uint64_t result = 0;
+       while( first <= last )
+       {
+          const uint64_t middle = first + ( last - first ) / 2;
+          const auto middle_time = get_account_history_time( db, store.get(), stats, middle );
+          // an entry that is not available does not stop the search, the history ends before it anyway
+          if( !middle_time.valid() || *middle_time <= time )
+          {
+             result = middle;
+             first = middle + 1;
+          }
+          else
+             last = middle - 1;
+       }
+       return result;
+    }
+
     vector<order_history_object> history_api::get_fill_order_history( const std::string& asset_a,
                                                                       const std::string& asset_b,
                                                                       uint32_t limit )const
@@ -458,6 +589,23 @@ namespace graphene { namespace app {
              result.emplace_back( obj.operation_id(db) );
        }
 
+       // continue with the older history that was moved to the history store
+       const auto store = get_history_store( _app );
+       if( store && result.size() < limit )
+       {
+          const auto& stats = account(db).statistics(db);
+          for( uint64_t seq = store->find_account_history_entry( account, start, stats.removed_ops );
+               seq > 0 && result.size() < limit; --seq )
+          {
+             const auto op_id = store->get_account_history_entry( account, seq );
+             if( !op_id.valid() || ( op_id->instance.value <= stop.instance.value && 0 != stop.instance.value ) )
+                break;
+             const auto op = store->get_operation( *op_id );
+             if( op.valid() )
+                result.push_back( *op );
+          }
+       }
+
        return result;
     }
 
@@ -484,22 +632,12 @@ namespace graphene { namespace app {
 
        fc::time_point_sec start = ostart.valid() ? *ostart : fc::time_point_sec::maximum();
 
-       const auto& op_hist_idx = db.get_index_type<operation_history_index>().indices().get<by_time>();
-       auto op_hist_itr = op_hist_idx.lower_bound( start );
-       if( op_hist_itr == op_hist_idx.end() )
+       const auto& stats = account(db).statistics(db);
+       const uint64_t sequence = find_account_history_by_time( _app, stats, start );
+       if( 0 == sequence )
           return result;
 
-       const auto& acc_hist_idx = db.get_index_type<account_history_index>().indices().get<by_op>();
-       auto itr = acc_hist_idx.lower_bound( boost::make_tuple( account, op_hist_itr->get_id() ) );
-       auto itr_end = acc_hist_idx.upper_bound( account );
-
-       while( itr != itr_end && result.size() < limit )
-       {
-          result.emplace_back( itr->operation_id(db) );
-          ++itr;
-       }
-
-       return result;
+       return get_account_history_by_sequence( _app, stats, 0, limit, sequence );
     }
 
     vector<operation_history_object> history_api::get_account_history_operations(
@@ -529,16 +667,53 @@ namespace graphene { namespace app {
        if( start == operation_history_id_type() )
           start = node->operation_id;
 
-       while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+       const auto* type_idx = get_operation_type_history_index( _app );
+       if( type_idx != nullptr )
+       {
+          // find the sequence number of the start operation, then only visit the entries of the operation type
+          const auto& by_op_idx = db.get_index_type<account_history_index>().indices().get<by_op>();
+          auto start_itr = by_op_idx.lower_bound( boost::make_tuple( account, start ) );
+          if( start_itr != by_op_idx.end() && start_itr->account == account
+                && operation_type >= 0 && operation_type <= std::numeric_limits<uint16_t>::max() )
+          {
+             auto range = type_idx->get_history( account, static_cast<uint16_t>( operation_type ),
+                                                 1, start_itr->sequence );
+             for( auto itr = range.second; itr != range.first && result.size() < limit; )
+             {
+                --itr;
+                if( itr->operation_id.instance.value <= stop.instance.value )
+                   break;
+                result.push_back( itr->operation_id(db) );
+             }
+          }
+       }
+       else
        {
-          if( node->operation_id.instance.value <= start.instance.value ) {
+          while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
+          {
+             if( node->operation_id.instance.value <= start.instance.value ) {
 
-             if(node->operation_id(db).op.which() == operation_type)
-               result.push_back( node->operation_id(db) );
+                if(node->operation_id(db).op.which() == operation_type)
+                  result.push_back( node->operation_id(db) );
+             }
+             if( node->next == account_history_id_type() )
+                node = nullptr;
+             else node = &node->next(db);
+          }
+       }
+       const auto store = get_history_store( _app );
+       if( store && result.size() < limit )
+       {
+          for( uint64_t seq = store->find_account_history_entry( account, start, stats.removed_ops );
+               seq > 0 && result.size() < limit; --seq )
+          {
+             const auto op_id = store->get_account_history_entry( account, seq );
+             if( !op_id.valid() || op_id->instance.value <= stop.instance.value )
+                break;
+             const auto op = store->get_operation( *op_id );
+             if( op.valid() && op->op.which() == operation_type )
+                result.push_back( *op );
           }
-          if( node->next == account_history_id_type() )
-             node = nullptr;
-          else node = &node->next(db);
        }
        if( stop.instance.value == 0 && result.size() < limit ) {
           const auto* head = db.find(account_history_id_type());
@@ -574,22 +749,7 @@ namespace graphene { namespace app {
        else
           start = std::min( stats.total_ops, start );
 
-       if( start >= stop && start > stats.removed_ops && limit > 0 )
-       {
-          const auto& hist_idx = db.get_index_type<account_history_index>();
-          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
-
-          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-          auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
-
-          do
-          {
-             --itr;
-             result.push_back( itr->operation_id(db) );
-          }
-          while ( itr != itr_stop && result.size() < limit );
-       }
-       return result;
+       return get_account_history_by_sequence( _app, stats, stop, limit, start );
     }
 
     vector<operation_history_object> history_api::get_block_operation_history(
@@ -643,6 +803,57 @@ namespace graphene { namespace app {
                   ("configured_limit", configured_limit) );
 
        history_operation_detail result;
+       const auto* type_idx = get_operation_type_history_index( _app );
+       if( type_idx != nullptr && !operation_types.empty() && limit > 0 )
+       {
+          FC_ASSERT( _app.chain_database(), "database unavailable" );
+          const auto& db = *_app.chain_database();
+          account_id_type account;
+          try {
+             database_api_helper db_api_helper( _app );
+             account = db_api_helper.get_account_from_string(account_id_or_name)->get_id();
+          } catch(...) { return result; }
+          const auto& stats = account(db).statistics(db);
+
+          // the range of sequence numbers that get_relative_account_history() returns below
+          uint64_t last = uint32_t( limit + start - 1 );
+          last = ( 0 == last ) ? stats.total_ops : std::min( stats.total_ops, last );
+          const uint64_t first = std::max<uint64_t>( { start, 1, ( last >= limit ) ? ( last + 1 - limit ) : 0 } );
+
+          // the entries after removed_ops are in memory, only those of the operation types are visited
+          const uint64_t first_in_memory = std::max( first, stats.removed_ops + 1 );
+          if( first_in_memory <= last )
+          {
+             result.total_count = last + 1 - first_in_memory;
+             vector<std::pair<uint64_t, operation_history_id_type>> entries;
+             for( const uint16_t op_type : operation_types )
+             {
+                const auto range = type_idx->get_history( account, op_type, first_in_memory, last );
+                for( auto itr = range.first; itr != range.second; ++itr )
+                   entries.emplace_back( itr->sequence, itr->operation_id );
+             }
+             std::sort( entries.begin(), entries.end(), std::greater<>() );
+             result.operation_history_objs.reserve( entries.size() );
+             for( const auto& entry : entries )
+                result.operation_history_objs.push_back( entry.second(db) );
+          }
+
+          // the older entries may be in the history store
+          const uint64_t last_removed = std::min( last, stats.removed_ops );
+          if( first <= last_removed )
+          {
+             vector<operation_history_object> objs = get_account_history_by_sequence(
+                   _app, stats, first, static_cast<uint32_t>( last_removed + 1 - first ), last_removed );
+             result.total_count += objs.size();
+             for( const operation_history_object &o : objs )
+             {
+                if( operation_types.find(o.op.which()) != operation_types.end() )
+                   result.operation_history_objs.push_back(o);
+             }
+          }
+          return result;
+       }
+
        vector<operation_history_object> objs = get_relative_account_history( account_id_or_name, start, limit,
                                                                              limit + start - 1 );
        result.total_count = objs.size();
@@ -29,6 +29,7 @@
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <graphene/protocol/signature_key_cache.hpp>
 #include <graphene/protocol/types.hpp>
 
 #include <graphene/egenesis/egenesis.hpp>
@@ -44,6 +45,7 @@
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/crypto/base64.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/signals2.hpp>
@@ -478,6 +480,10 @@ void application_impl::set_api_limit() {
       _app_options.api_limit_get_storage_info =
             _options->at("api-limit-get-storage-info").as<uint32_t>();
    }
+   if(_options->count("api-limit-subscribed-objects") > 0) {
+      _app_options.api_limit_subscribed_objects =
+            _options->at("api-limit-subscribed-objects").as<uint32_t>();
+   }
 }
 
 graphene::chain::genesis_state_type application_impl::initialize_genesis_state() const
@@ -558,6 +564,51 @@ void application_impl::open_chain_database() const
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("block-archive-chunk-size") > 0 )
+   {
+      _chain_db->set_block_archive_chunk_size( _options->at("block-archive-chunk-size").as<uint32_t>() );
+   }
+
+   if( _options->count("max-object-database-deltas") > 0 )
+   {
+      _chain_db->set_max_deltas( _options->at("max-object-database-deltas").as<uint32_t>() );
+   }
+
+   if( _options->count("state-checkpoint-interval") > 0 )
+   {
+      _chain_db->set_state_checkpoints( _options->at("state-checkpoint-interval").as<uint32_t>(),
+                                        _options->at("state-checkpoints-to-keep").as<uint32_t>() );
+   }
+
+   if( _options->count("trusted-catch-up-age") > 0 )
+   {
+      _chain_db->set_trusted_catch_up( _options->at("trusted-catch-up-age").as<uint32_t>(),
+                                       _options->at("trusted-catch-up-batch-size").as<uint32_t>() );
+   }
+
+   if( _options->count("lazy-pending-restore") > 0 )
+      _chain_db->set_lazy_pending_restore( _options->at("lazy-pending-restore").as<bool>() );
+
+   if( _options->count("signature-cache-size") > 0 )
+   {
+      graphene::protocol::signature_key_cache::instance().resize(
+            _options->at("signature-cache-size").as<uint32_t>() );
+   }
+
+   if( _options->count("parallel-authority-checks") > 0 )
+   {
+      const auto mode = _options->at("parallel-authority-checks").as<string>();
+      FC_ASSERT( mode == "off" || mode == "on" || mode == "self-check",
+                 "Invalid parallel-authority-checks mode: ${m}", ("m",mode) );
+      _chain_db->set_parallel_authority_checks( mode != "off", mode == "self-check" );
+   }
+
+   if( _options->count("vote-tally-full-recount-interval") > 0 )
+   {
+      _chain_db->set_vote_tally_full_recount_interval(
+            _options->at("vote-tally-full-recount-interval").as<uint32_t>() );
+   }
+
    if( _options->count("replay-blockchain") > 0 || _options->count("revalidate-blockchain") > 0 )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -690,6 +741,7 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
                                database::skip_nothing : database::skip_transaction_signatures;
       bool result = valve.do_serial( [this,&blk_msg,skip] () {
          _chain_db->precompute_parallel( blk_msg.block, skip ).wait();
+         _chain_db->precheck_authorities( blk_msg.block, skip );
       }, [this,&blk_msg,skip] () {
          // TODO: in the case where this block is valid but on a fork that's too old for us to switch to,
          // you can help the network code out by throwing a block_older_than_undo_history exception.
@@ -697,6 +749,10 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
          // leave that peer connected so that they can get sync blocks from us
          return _chain_db->push_block( blk_msg.block, skip );
       });
+      // while syncing the queued pending transactions are only re-applied when needed
+      if( !sync_mode )
+         schedule_pending_restore();
+      schedule_block_archiving();
 
       // the block was accepted, so we now know all of the transactions contained in the block
       if (!sync_mode)
@@ -734,6 +790,49 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    }
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) return false; }
 
+void application_impl::schedule_pending_restore()
+{
+   if( _pending_restore_scheduled || _chain_db->queued_pending_transaction_count() == 0 )
+      return;
+   _pending_restore_scheduled = true;
+   std::weak_ptr<application_impl> weak_this = shared_from_this();
+   fc::async( [weak_this]() {
+      auto self = weak_this.lock();
+      if( !self )
+         return;
+      self->_pending_restore_scheduled = false;
+      // small batches, so that incoming blocks and transactions are not kept waiting
+      self->_chain_db->restore_pending_transactions( 100 );
+      self->schedule_pending_restore();
+   }, "restore_pending_transactions" );
+}
+
+void application_impl::schedule_block_archiving()
+{
+   if( _block_archiving_scheduled )
+      return;
+   _block_archiving_scheduled = true;
+   std::weak_ptr<application_impl> weak_this = shared_from_this();
+   fc::async( [weak_this]() {
+      auto self = weak_this.lock();
+      if( !self )
+         return;
+      self->_block_archiving_scheduled = false;
+      bool more_chunks = false;
+      try
+      {
+         // one chunk at a time, so that incoming blocks and transactions are not kept waiting
+         more_chunks = self->_chain_db->archive_irreversible_blocks( 1 );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Failed to archive blocks:\n${e}", ("e", e.to_detail_string()) );
+      }
+      if( more_chunks )
+         self->schedule_block_archiving();
+   }, "archive_blocks" );
+}
+
 void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
 { try {
    static fc::time_point last_call;
@@ -1230,6 +1329,34 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("block-archive-chunk-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of irreversible blocks per compressed chunk in the block archive, 0 to disable archiving. "
+          "Can not be changed once the archive exists.")
+         ("max-object-database-deltas", bpo::value<uint32_t>()->default_value(0),
+          "On shutdown only write the objects changed since the last write as a delta to the object database, "
+          "merging them in the background once there are more than this many deltas. 0 always writes all objects.")
+         ("state-checkpoint-interval", bpo::value<uint32_t>()->default_value(0),
+          "Write a checkpoint of the chain state in the background every this many irreversible blocks, "
+          "to only replay the blocks after the newest checkpoint after an unclean shutdown. 0 to disable.")
+         ("state-checkpoints-to-keep", bpo::value<uint32_t>()->default_value(2),
+          "Number of state checkpoints to keep on disk")
+         ("trusted-catch-up-age", bpo::value<uint32_t>()->default_value(0),
+          "Apply blocks older than this many seconds in batches without undo history while catching up. "
+          "These blocks can not be popped by a fork switch. 0 to disable.")
+         ("trusted-catch-up-batch-size", bpo::value<uint32_t>()->default_value(1000),
+          "Number of blocks sharing one undo state in trusted catch-up mode")
+         ("lazy-pending-restore", bpo::value<bool>()->default_value(true),
+          "Re-apply the pending transactions in the background after a block is applied, "
+          "instead of before the block is accepted")
+         ("signature-cache-size",
+          bpo::value<uint32_t>()->default_value( graphene::protocol::signature_key_cache::default_entries ),
+          "Number of public keys recovered from signatures to keep in memory, 0 to disable the cache")
+         ("parallel-authority-checks", bpo::value<string>()->default_value("off"),
+          "Verify the transaction authorities of a block in parallel before applying it: off, on, or self-check "
+          "to also verify them serially and log any mismatch")
+         ("vote-tally-full-recount-interval", bpo::value<uint32_t>()->default_value(30),
+          "Recount all votes every this many maintenance intervals to check the incremental vote tally. "
+          "1 to recount at every maintenance, 0 to only recount when required.")
          ("api-limit-get-account-history-operations",
           bpo::value<uint32_t>()->default_value(default_opts.api_limit_get_account_history_operations),
           "For history_api::get_account_history_operations to set max limit value")
@@ -1341,6 +1468,10 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("api-limit-get-storage-info",
           bpo::value<uint32_t>()->default_value(default_opts.api_limit_get_storage_info),
           "Set maximum limit value for APIs which query for account storage info")
+         ("api-limit-subscribed-objects",
+          bpo::value<uint32_t>()->default_value(default_opts.api_limit_subscribed_objects),
+          "Maximum number of objects a connection is subscribed to, "
+          "beyond it the least recently queried objects are unsubscribed")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -67,6 +67,14 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
 
       void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
+      /// Re-applies the pending transactions queued by push_block() in the background, see
+      /// chain::database::set_lazy_pending_restore()
+      void schedule_pending_restore();
+
+      /// Moves irreversible blocks into the block archive in the background, see
+      /// chain::database::archive_irreversible_blocks()
+      void schedule_block_archiving();
+
       void handle_message(const graphene::net::message& message_to_process) override;
 
       bool is_included_block(const graphene::chain::block_id_type& block_id);
@@ -223,6 +231,8 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
 
       bool _is_finished_syncing = false;
+      bool _pending_restore_scheduled = false;
+      bool _block_archiving_scheduled = false;
 
       /// A string defined by the node operator, which can be retrieved via the login_api::get_info API
       string _node_info;
@@ -67,28 +67,9 @@ database_api_helper::database_api_helper( const graphene::app::application& app
 }
 
 database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options )
-:database_api_helper( db, app_options )
+:database_api_helper( db, app_options ), _notification_hub( notification_hub::get( db ) )
 {
    dlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids,
-                                                    const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids,
-                                                           const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids,
-                                                            const vector<const object*>& objs,
-                                                            const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
-                                });
-   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
-
-   _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
-                                if( _pending_trx_callback )
-                                   _pending_trx_callback( fc::variant(trx, GRAPHENE_MAX_NESTED_OBJECTS) );
-                      });
    try
    {
       amount_in_collateral_index = &_db.get_index_type< primary_index< call_order_index > >()
@@ -124,6 +105,7 @@ database_api_impl::database_api_impl( graphene::chain::database& db, const appli
 database_api_impl::~database_api_impl()
 {
    dlog("freeing database api ${x}", ("x",int64_t(this)) );
+   _notification_hub->remove_session( this );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -181,6 +163,8 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 
    _subscribe_callback = cb;
    _notify_remove_create = notify_remove_create;
+   add_to_notification_hub();
+   _notification_hub->set_notify_remove_create( this, notify_remove_create );
 }
 
 void database_api::set_auto_subscription( bool enable )
@@ -201,6 +185,8 @@ void database_api::set_pending_transaction_callback( std::function<void(const va
 void database_api_impl::set_pending_transaction_callback( std::function<void(const variant&)> cb )
 {
    _pending_trx_callback = cb;
+   add_to_notification_hub();
+   _notification_hub->set_pending_transaction_callback( this, bool(cb) );
 }
 
 void database_api::set_block_applied_callback( std::function<void(const variant& block_id)> cb )
@@ -211,6 +197,8 @@ void database_api::set_block_applied_callback( std::function<void(const variant&
 void database_api_impl::set_block_applied_callback( std::function<void(const variant& block_id)> cb )
 {
    _block_applied_callback = cb;
+   add_to_notification_hub();
+   _notification_hub->set_block_applied_callback( this, bool(cb) );
 }
 
 void database_api::cancel_all_subscriptions()
@@ -227,9 +215,16 @@ void database_api_impl::cancel_all_subscriptions( bool reset_callback, bool rese
       _market_subscriptions.clear();
 
    _notify_remove_create = false;
-   _subscribed_accounts.clear();
-   static fc::bloom_parameters param(10000, 1.0/100, 1024*8*8*2);
-   _subscribe_filter = fc::bloom_filter(param);
+   _notification_hub->cancel_subscriptions( this, reset_market_subscriptions );
+}
+
+void database_api_impl::add_to_notification_hub()
+{
+   if( !_added_to_notification_hub )
+   {
+      _notification_hub->add_session( shared_from_this() );
+      _added_to_notification_hub = true;
+   }
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -538,9 +533,10 @@ std::map<std::string, full_account, std::less<>> database_api_impl::get_full_acc
       if( !account )
          continue;
 
-      if( to_subscribe && _subscribed_accounts.size() < _app_options->api_limit_get_full_accounts_subscribe )
+      if( to_subscribe && _notification_hub->subscribed_account_count( this )
+                             < _app_options->api_limit_get_full_accounts_subscribe )
       {
-         _subscribed_accounts.insert( account->get_id() );
+         _notification_hub->subscribe_to_account( this, account->get_id() );
          subscribe_to_item( account->id );
       }
 
@@ -1372,6 +1368,8 @@ void database_api_impl::subscribe_to_market( std::function<void(const variant&)>
    if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions[ std::make_pair(asset_a_id,asset_b_id) ] = callback;
+   add_to_notification_hub();
+   _notification_hub->subscribe_to_market( this, std::make_pair(asset_a_id,asset_b_id) );
 }
 
 void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
@@ -1387,6 +1385,7 @@ void database_api_impl::unsubscribe_from_market(const std::string& a, const std:
    if(a > b) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id));
+   _notification_hub->unsubscribe_from_market( this, std::make_pair(asset_a_id,asset_b_id) );
 }
 
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
@@ -3148,16 +3147,6 @@ vector<limit_order_object> database_api_impl::get_limit_orders( const asset_id_t
    return result;
 }
 
-bool database_api_impl::is_impacted_account( const flat_set<account_id_type>& accounts)
-{
-   if( _subscribed_accounts.empty() || accounts.empty() )
-      return false;
-
-   return std::any_of(accounts.begin(), accounts.end(), [this](const account_id_type& account) {
-      return _subscribed_accounts.find(account) != _subscribed_accounts.end();
-   });
-}
-
 void database_api_impl::broadcast_updates( const vector<variant>& updates )
 {
    if( !updates.empty() && _subscribe_callback ) {
@@ -3185,152 +3174,32 @@ void database_api_impl::broadcast_market_updates( const market_queue_type& queue
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids,
-                                            const vector<const object*>& objs,
-                                            const flat_set<account_id_type>& impacted_accounts )
+/** note: the broadcast methods cannot yield because they are called in the middle of applying a block. */
+void database_api_impl::broadcast_block_applied( const variant& block_id )
 {
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
-
-         if (it != objs.end())
-            return *it;
-
-         return nullptr;
-      }
-   );
-}
-
-void database_api_impl::on_objects_new( const vector<object_id_type>& ids,
-                                        const flat_set<account_id_type>& impacted_accounts )
-{
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::on_objects_changed( const vector<object_id_type>& ids,
-                                            const flat_set<account_id_type>& impacted_accounts )
-{
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::handle_object_changed( bool force_notify,
-                                               bool full_object,
-                                               const vector<object_id_type>& ids,
-                                               const flat_set<account_id_type>& impacted_accounts,
-                                               std::function<const object*(object_id_type id)> find_object )
-{
-   if( _subscribe_callback )
-   {
-      vector<variant> updates;
-
-      for(auto id : ids)
-      {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
-         {
-            if( full_object )
-            {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
-            }
-            else
-            {
-               updates.emplace_back( fc::variant( id, 1 ) );
-            }
-         }
-      }
-
-      if( !updates.empty() )
-         broadcast_updates(updates);
-   }
-
-   if( !_market_subscriptions.empty() )
-   {
-      market_queue_type broadcast_queue;
-
-      for(auto id : ids)
-      {
-         if( id.is<call_order_id_type>() )
-         {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<limit_order_id_type>() )
-         {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<force_settlement_id_type>() )
-         {
-            enqueue_if_subscribed_to_market<force_settlement_object>( find_object(id), broadcast_queue,
-                                                                      full_object );
-         }
-      }
-
-      if( !broadcast_queue.empty() )
-         broadcast_market_updates(broadcast_queue);
-   }
-}
-
-/** note: this method cannot yield because it is called in the middle of
- * apply a block.
- */
-void database_api_impl::on_applied_block()
-{
-   if (_block_applied_callback)
+   if( _block_applied_callback )
    {
       auto capture_this = shared_from_this();
-      block_id_type block_id = _db.head_block_id();
       fc::async([this,capture_this,block_id](){
-         _block_applied_callback(fc::variant(block_id, 1));
+         if( _block_applied_callback )
+            _block_applied_callback(block_id);
       });
    }
+}
 
-   if( _market_subscriptions.empty() )
+void database_api_impl::broadcast_market_fills( const map<market_type, variant>& fills )
+{
+   if( fills.empty() )
       return;
 
-   const auto& ops = _db.get_applied_operations();
-   map< std::pair<asset_id_type,asset_id_type>, vector<pair<operation, operation_result>> > subscribed_markets_ops;
-   for(const optional< operation_history_object >& o_op : ops)
-   {
-      if( !o_op.valid() )
-         continue;
-      const operation_history_object& op = *o_op;
-
-      optional< std::pair<asset_id_type,asset_id_type> > market;
-      switch(op.op.which())
-      {
-         /*  This is sent via the object_changed callback
-         case operation::tag<limit_order_create_operation>::value:
-            market = op.op.get<limit_order_create_operation>().get_market();
-            break;
-         */
-         case operation::tag<fill_order_operation>::value:
-            market = op.op.get<fill_order_operation>().get_market();
-            break;
-            /*
-         case operation::tag<limit_order_cancel_operation>::value:
-         */
-         default: break;
-      }
-      if( market.valid() && _market_subscriptions.count(*market) > 0 )
-         // FIXME this may cause fill_order_operation be pushed before order creation
-         subscribed_markets_ops[*market].emplace_back(std::make_pair(op.op, op.result));
-   }
    /// we need to ensure the database_api is not deleted for the life of the async operation
    auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
-      for(auto item : subscribed_markets_ops)
+   fc::async([this,capture_this,fills](){
+      for(const auto& item : fills)
       {
          auto itr = _market_subscriptions.find(item.first);
          if(itr != _market_subscriptions.end())
-            itr->second(fc::variant(item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
+            itr->second(item.second);
       }
    });
 }
@@ -180,6 +180,7 @@ namespace graphene { namespace app {
           *
           * @note the data is fetched from the @a account_history plugin, so results may be
           *       incomplete due to the @a partial-operations option configured in the API node.
+          *       Operations moved to the @a history-store are not included either.
           *       To get complete data, it is recommended to query from ElasticSearch where the data is
           *       maintained by the @a elastic_search plugin.
           */
@@ -196,6 +197,7 @@ namespace graphene { namespace app {
           *
           * @note the data is fetched from the @a account_history plugin, so results may be
           *       incomplete or incorrect due to the @a partial-operations option configured in the API node.
+          *       Operations moved to the @a history-store are not included either.
           *       To get complete data, it is recommended to query from ElasticSearch where the data is
           *       maintained by the @a elastic_search plugin.
           */
@@ -80,6 +80,7 @@ namespace graphene { namespace app {
          uint32_t api_limit_get_samet_funds = 101;
          uint32_t api_limit_get_credit_offers = 101;
          uint32_t api_limit_get_storage_info = 101;
+         uint32_t api_limit_subscribed_objects = 10000;
 
          static constexpr application_options get_default()
          {
@@ -212,6 +213,7 @@ FC_REFLECT( graphene::app::application_options,
             ( api_limit_get_samet_funds )
             ( api_limit_get_credit_offers )
             ( api_limit_get_storage_info )
+            ( api_limit_subscribed_objects )
           )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::app::application_options )
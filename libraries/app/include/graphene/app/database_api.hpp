@@ -312,6 +312,8 @@ class database_api
 
       /**
        * @brief Returns vector of voting power sorted by reverse vp_active
+       *
+       * Only accounts which were counted by the last vote tally are returned.
        * @param limit Maximum number of accounts to retrieve, must not exceed the configured value of
        *              @a api_limit_get_top_voters
        * @return Desc Sorted voting power vector
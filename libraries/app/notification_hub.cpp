@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/database_api.hpp>
+
+#include "database_api_impl.hxx"
+#include "notification_hub.hxx"
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <mutex>
+
+namespace graphene { namespace app {
+
+object_notification::object_notification( const graphene::chain::database& db, const vector<object_id_type>& ids,
+                                          const flat_set<account_id_type>& impacted_accounts,
+                                          std::function<const object*(object_id_type id)> find_object,
+                                          bool full_object, bool new_or_removed )
+: ids( ids ), impacted_accounts( impacted_accounts ), new_or_removed( new_or_removed ),
+  _db( db ), _find_object( std::move( find_object ) ), _full_object( full_object ),
+  _updates( ids.size() ), _updates_done( ids.size(), false ),
+  _markets( ids.size() ), _markets_done( ids.size(), false )
+{ // Nothing else to do
+}
+
+const variant* object_notification::get_update( size_t index )
+{
+   if( !_updates_done[index] )
+   {
+      _updates_done[index] = true;
+      if( !_full_object )
+         _updates[index] = fc::variant( ids[index], 1 );
+      else if( const object* obj = _find_object( ids[index] ) )
+         _updates[index] = obj->to_variant();
+   }
+   return _updates[index].valid() ? &*_updates[index] : nullptr;
+}
+
+template<typename T>
+static market_type get_order_market( const graphene::chain::database&, const T& order )
+{
+   return order.get_market();
+}
+
+static market_type get_order_market( const graphene::chain::database& db, const force_settlement_object& order )
+{
+   asset_id_type backing_id = order.balance.asset_id( db ).bitasset_data( db ).options.short_backing_asset;
+   auto tmp = std::make_pair( order.balance.asset_id, backing_id );
+   if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
+   return tmp;
+}
+
+template<typename T>
+static optional<market_type> find_order_market( const graphene::chain::database& db, const object* obj )
+{
+   const T* order = dynamic_cast<const T*>( obj );
+   if( order == nullptr )
+      return {};
+   return get_order_market( db, *order );
+}
+
+const market_type* object_notification::get_market( size_t index )
+{
+   if( !_markets_done[index] )
+   {
+      _markets_done[index] = true;
+      const object_id_type id = ids[index];
+      if( id.is<call_order_id_type>() )
+         _markets[index] = find_order_market<call_order_object>( _db, _find_object( id ) );
+      else if( id.is<limit_order_id_type>() )
+         _markets[index] = find_order_market<limit_order_object>( _db, _find_object( id ) );
+      else if( id.is<force_settlement_id_type>() )
+         _markets[index] = find_order_market<force_settlement_object>( _db, _find_object( id ) );
+   }
+   return _markets[index].valid() ? &*_markets[index] : nullptr;
+}
+
+block_notification::block_notification( const graphene::chain::database& db )
+: _db( db )
+{ // Nothing else to do
+}
+
+const variant& block_notification::get_block_id()
+{
+   if( !_block_id.valid() )
+      _block_id = fc::variant( _db.head_block_id(), 1 );
+   return *_block_id;
+}
+
+const map<market_type, vector<pair<operation, operation_result>>>& block_notification::get_fills()
+{
+   if( !_fills.valid() )
+   {
+      _fills = map<market_type, vector<pair<operation, operation_result>>>();
+      for( const optional< operation_history_object >& o_op : _db.get_applied_operations() )
+      {
+         if( !o_op.valid() )
+            continue;
+         const operation_history_object& op = *o_op;
+
+         optional<market_type> op_market;
+         switch(op.op.which())
+         {
+            /*  This is sent via the object_changed callback
+            case operation::tag<limit_order_create_operation>::value:
+               op_market = op.op.get<limit_order_create_operation>().get_market();
+               break;
+            */
+            case operation::tag<fill_order_operation>::value:
+               op_market = op.op.get<fill_order_operation>().get_market();
+               break;
+               /*
+            case operation::tag<limit_order_cancel_operation>::value:
+            */
+            default: break;
+         }
+         if( op_market.valid() )
+            // FIXME this may cause fill_order_operation be pushed before order creation
+            (*_fills)[*op_market].emplace_back( std::make_pair( op.op, op.result ) );
+      }
+   }
+
+   return *_fills;
+}
+
+const variant* block_notification::get_market_fills( const market_type& market )
+{
+   const auto& all_fills = get_fills();
+   auto itr = _fill_variants.find( market );
+   if( itr == _fill_variants.end() )
+   {
+      auto fills = all_fills.find( market );
+      if( fills == all_fills.end() )
+         return nullptr;
+      itr = _fill_variants.emplace( market, fc::variant( fills->second, GRAPHENE_NET_MAX_NESTED_OBJECTS ) ).first;
+   }
+   return &itr->second;
+}
+
+notification_hub::notification_hub( graphene::chain::database& db )
+: _db( db )
+{
+   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids,
+                                                    const flat_set<account_id_type>& impacted_accounts) {
+      object_notification notification( _db, ids, impacted_accounts,
+                                        std::bind( &object_database::find_object, &_db, std::placeholders::_1 ),
+                                        true, true );
+      notify_objects( notification );
+   });
+   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids,
+                                                           const flat_set<account_id_type>& impacted_accounts) {
+      object_notification notification( _db, ids, impacted_accounts,
+                                        std::bind( &object_database::find_object, &_db, std::placeholders::_1 ),
+                                        true, false );
+      notify_objects( notification );
+   });
+   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids,
+                                                            const vector<const object*>& objs,
+                                                            const flat_set<account_id_type>& impacted_accounts) {
+      object_notification notification( _db, ids, impacted_accounts,
+         [&objs](object_id_type id) -> const object* {
+            auto it = std::find_if(
+                  objs.begin(), objs.end(),
+                  [id](const object* o) {return o != nullptr && o->id == id;});
+
+            if (it != objs.end())
+               return *it;
+
+            return nullptr;
+         },
+         false, true );
+      notify_objects( notification );
+   });
+   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
+   _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx){
+      on_pending_transaction( trx );
+   });
+}
+
+std::shared_ptr<notification_hub> notification_hub::get( graphene::chain::database& db )
+{
+   static std::mutex hubs_mutex;
+   static std::map<const graphene::chain::database*, std::weak_ptr<notification_hub>> hubs;
+
+   std::lock_guard<std::mutex> guard( hubs_mutex );
+   for( auto itr = hubs.begin(); itr != hubs.end(); )
+   {
+      if( itr->second.expired() )
+         itr = hubs.erase( itr );
+      else
+         ++itr;
+   }
+   auto& weak_hub = hubs[&db];
+   auto hub = weak_hub.lock();
+   if( !hub )
+   {
+      hub = std::make_shared<notification_hub>( db );
+      weak_hub = hub;
+   }
+   return hub;
+}
+
+template<typename Registry, typename Key>
+static void remove_from_registry( Registry& registry, const Key& key, const database_api_impl* session )
+{
+   auto itr = registry.find( key );
+   if( itr == registry.end() )
+      return;
+   itr->second.erase( session );
+   if( itr->second.empty() )
+      registry.erase( itr );
+}
+
+void notification_hub::add_session( const std::shared_ptr<database_api_impl>& session )
+{
+   _sessions[ session.get() ].session = session;
+}
+
+void notification_hub::remove_session( const database_api_impl* session )
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   cancel_subscriptions( session, true );
+   _block_applied_sessions.erase( session );
+   _pending_trx_sessions.erase( session );
+   _sessions.erase( itr );
+}
+
+void notification_hub::set_notify_remove_create( const database_api_impl* session, bool enable )
+{
+   if( enable && _sessions.find( session ) != _sessions.end() )
+      _remove_create_sessions.insert( session );
+   else
+      _remove_create_sessions.erase( session );
+}
+
+void notification_hub::set_block_applied_callback( const database_api_impl* session, bool enable )
+{
+   if( enable && _sessions.find( session ) != _sessions.end() )
+      _block_applied_sessions.insert( session );
+   else
+      _block_applied_sessions.erase( session );
+}
+
+void notification_hub::set_pending_transaction_callback( const database_api_impl* session, bool enable )
+{
+   if( enable && _sessions.find( session ) != _sessions.end() )
+      _pending_trx_sessions.insert( session );
+   else
+      _pending_trx_sessions.erase( session );
+}
+
+void notification_hub::subscribe_to_account( const database_api_impl* session, const account_id_type& account )
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   if( itr->second.accounts.insert( account ).second )
+      _account_sessions[account].insert( session );
+}
+
+size_t notification_hub::subscribed_account_count( const database_api_impl* session )const
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return 0;
+   return itr->second.accounts.size();
+}
+
+void notification_hub::subscribe_to_object( const database_api_impl* session, const object_id_type& id,
+                                            size_t max_objects )
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   session_subscriptions& subscriptions = itr->second;
+   auto position = subscriptions.object_positions.find( id );
+   if( position != subscriptions.object_positions.end() )
+   {
+      // used again, so it is dropped last
+      subscriptions.objects.splice( subscriptions.objects.end(), subscriptions.objects, position->second );
+      return;
+   }
+   _object_sessions[id].insert( session );
+   subscriptions.object_positions[id] = subscriptions.objects.insert( subscriptions.objects.end(), id );
+   while( subscriptions.objects.size() > max_objects )
+   {
+      const object_id_type& oldest = subscriptions.objects.front();
+      remove_from_registry( _object_sessions, oldest, session );
+      subscriptions.object_positions.erase( oldest );
+      subscriptions.objects.pop_front();
+   }
+}
+
+void notification_hub::subscribe_to_market( const database_api_impl* session, const market_type& market )
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   if( itr->second.markets.insert( market ).second )
+      _market_sessions[market].insert( session );
+}
+
+void notification_hub::unsubscribe_from_market( const database_api_impl* session, const market_type& market )
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   if( itr->second.markets.erase( market ) > 0 )
+      remove_from_registry( _market_sessions, market, session );
+}
+
+void notification_hub::cancel_subscriptions( const database_api_impl* session, bool markets )
+{
+   _remove_create_sessions.erase( session );
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return;
+   session_subscriptions& subscriptions = itr->second;
+   for( const account_id_type& account : subscriptions.accounts )
+      remove_from_registry( _account_sessions, account, session );
+   subscriptions.accounts.clear();
+   for( const object_id_type& id : subscriptions.objects )
+      remove_from_registry( _object_sessions, id, session );
+   subscriptions.objects.clear();
+   subscriptions.object_positions.clear();
+   if( markets )
+   {
+      for( const market_type& market : subscriptions.markets )
+         remove_from_registry( _market_sessions, market, session );
+      subscriptions.markets.clear();
+   }
+}
+
+std::shared_ptr<database_api_impl> notification_hub::lock_session( const database_api_impl* session )const
+{
+   auto itr = _sessions.find( session );
+   if( itr == _sessions.end() )
+      return {};
+   return itr->second.session.lock();
+}
+
+// The sessions to notify are collected from the registries before any of them is notified. A session is kept alive
+// while it is notified, and a session that is freed afterwards removes itself from the registries.
+
+/** note: the notifications cannot yield because they are sent in the middle of applying a block. */
+void notification_hub::notify_objects( object_notification& notification )
+{
+   const vector<object_id_type>& ids = notification.ids;
+
+   // the sessions that get all the objects
+   session_set full_sessions;
+   if( notification.new_or_removed )
+      full_sessions = _remove_create_sessions;
+   for( const account_id_type& account : notification.impacted_accounts )
+   {
+      auto itr = _account_sessions.find( account );
+      if( itr != _account_sessions.end() )
+         full_sessions.insert( itr->second.begin(), itr->second.end() );
+   }
+
+   // the other sessions get the objects they subscribed to, by index
+   std::map<const database_api_impl*, vector<size_t>> object_sessions;
+   if( !_object_sessions.empty() )
+   {
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         auto itr = _object_sessions.find( ids[i] );
+         if( itr == _object_sessions.end() )
+            continue;
+         for( const database_api_impl* session : itr->second )
+         {
+            if( full_sessions.find( session ) == full_sessions.end() )
+               object_sessions[session].push_back( i );
+         }
+      }
+   }
+
+   std::map<const database_api_impl*, market_queue_type> market_queues;
+   if( !_market_sessions.empty() )
+   {
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         const market_type* market = notification.get_market( i );
+         if( market == nullptr )
+            continue;
+         auto itr = _market_sessions.find( *market );
+         if( itr == _market_sessions.end() )
+            continue;
+         const variant* update = notification.get_update( i );
+         if( update == nullptr )
+            continue;
+         for( const database_api_impl* session : itr->second )
+            market_queues[session][*market].push_back( *update );
+      }
+   }
+
+   if( !full_sessions.empty() )
+   {
+      vector<variant> updates;
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         const variant* update = notification.get_update( i );
+         if( update != nullptr )
+            updates.push_back( *update );
+      }
+      if( !updates.empty() )
+      {
+         for( const database_api_impl* session : full_sessions )
+         {
+            auto locked_session = lock_session( session );
+            if( locked_session )
+               locked_session->broadcast_updates( updates );
+         }
+      }
+   }
+
+   for( const auto& item : object_sessions )
+   {
+      auto locked_session = lock_session( item.first );
+      if( !locked_session )
+         continue;
+      vector<variant> updates;
+      updates.reserve( item.second.size() );
+      for( size_t i : item.second )
+      {
+         const variant* update = notification.get_update( i );
+         if( update != nullptr )
+            updates.push_back( *update );
+      }
+      locked_session->broadcast_updates( updates );
+   }
+
+   for( const auto& item : market_queues )
+   {
+      auto locked_session = lock_session( item.first );
+      if( locked_session )
+         locked_session->broadcast_market_updates( item.second );
+   }
+}
+
+void notification_hub::on_applied_block()
+{
+   block_notification notification( _db );
+
+   const session_set block_sessions = _block_applied_sessions;
+   for( const database_api_impl* session : block_sessions )
+   {
+      auto locked_session = lock_session( session );
+      if( locked_session )
+         locked_session->broadcast_block_applied( notification.get_block_id() );
+   }
+
+   if( _market_sessions.empty() )
+      return;
+
+   std::map<const database_api_impl*, map<market_type, variant>> session_fills;
+   for( const auto& item : notification.get_fills() )
+   {
+      auto itr = _market_sessions.find( item.first );
+      if( itr == _market_sessions.end() )
+         continue;
+      const variant* fills = notification.get_market_fills( item.first );
+      for( const database_api_impl* session : itr->second )
+         session_fills[session][item.first] = *fills;
+   }
+   for( const auto& item : session_fills )
+   {
+      auto locked_session = lock_session( item.first );
+      if( locked_session )
+         locked_session->broadcast_market_fills( item.second );
+   }
+}
+
+void notification_hub::on_pending_transaction( const signed_transaction& trx )
+{
+   if( _pending_trx_sessions.empty() )
+      return;
+   const variant trx_variant( trx, GRAPHENE_MAX_NESTED_OBJECTS );
+   const session_set sessions = _pending_trx_sessions;
+   for( const database_api_impl* session : sessions )
+   {
+      auto locked_session = lock_session( session );
+      if( locked_session && locked_session->_pending_trx_callback )
+         locked_session->_pending_trx_callback( trx_variant );
+   }
+}
+
+} } // graphene::app
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2017 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <unordered_map>
+
+namespace graphene { namespace app {
+
+using namespace graphene::chain;
+
+class database_api_impl;
+
+using market_type = std::pair<graphene::chain::asset_id_type, graphene::chain::asset_id_type>;
+
+/**
+ *  @brief The objects of one notification of the database
+ *
+ *  Each object is converted to a variant at most once, when the first session needs it, and the variant is shared
+ *  by all sessions that are notified about the object.
+ */
+class object_notification
+{
+   public:
+      object_notification( const graphene::chain::database& db, const vector<object_id_type>& ids,
+                           const flat_set<account_id_type>& impacted_accounts,
+                           std::function<const object*(object_id_type id)> find_object,
+                           bool full_object, bool new_or_removed );
+
+      const vector<object_id_type>& ids;
+      const flat_set<account_id_type>& impacted_accounts;
+      /// Whether the objects were created or removed, rather than changed
+      const bool new_or_removed;
+
+      /// @return the update of the object, the object itself or its ID, or null if the object is not found
+      const variant* get_update( size_t index );
+      /// @return the market of the object if it is an order, or null
+      const market_type* get_market( size_t index );
+
+   private:
+      const graphene::chain::database&                          _db;
+      std::function<const object*(object_id_type id)>           _find_object;
+      const bool                                                _full_object;
+      vector<optional<variant>>                                 _updates;
+      vector<bool>                                              _updates_done;
+      vector<optional<market_type>>                             _markets;
+      vector<bool>                                              _markets_done;
+};
+
+/**
+ *  @brief The notifications of an applied block
+ *
+ *  As for the objects, the block ID and the filled orders of each market are converted to variants once for all
+ *  sessions.
+ */
+class block_notification
+{
+   public:
+      explicit block_notification( const graphene::chain::database& db );
+
+      const variant& get_block_id();
+      /// @return the fill operations of the block by market
+      const map<market_type, vector<pair<operation, operation_result>>>& get_fills();
+      /// @return the fill operations of the market in the block, or null if there are none
+      const variant* get_market_fills( const market_type& market );
+
+   private:
+      const graphene::chain::database&                                        _db;
+      optional<variant>                                                       _block_id;
+      optional<map<market_type, vector<pair<operation, operation_result>>>>  _fills;
+      map<market_type, variant>                                               _fill_variants;
+};
+
+/**
+ *  @brief Forwards the notifications of a database to the sessions of the database API that subscribed to them
+ *
+ *  There is one hub per database, shared by its sessions. The hub is connected to the signals of the database
+ *  once and converts the notified objects once. It keeps a registry of the sessions subscribed to each account,
+ *  object and market, so a notification only visits the sessions that are interested in it.
+ */
+class notification_hub
+{
+   public:
+      explicit notification_hub( graphene::chain::database& db );
+
+      /// @return the hub of the database, which is created by the first session
+      static std::shared_ptr<notification_hub> get( graphene::chain::database& db );
+
+      void add_session( const std::shared_ptr<database_api_impl>& session );
+      /// Removes the session and all its subscriptions
+      void remove_session( const database_api_impl* session );
+
+      void set_notify_remove_create( const database_api_impl* session, bool enable );
+      void set_block_applied_callback( const database_api_impl* session, bool enable );
+      void set_pending_transaction_callback( const database_api_impl* session, bool enable );
+
+      void subscribe_to_account( const database_api_impl* session, const account_id_type& account );
+      /// @return the number of accounts the session is subscribed to
+      size_t subscribed_account_count( const database_api_impl* session )const;
+      /**
+       *  Subscribes the session to the object, or marks it as used if the session is subscribed already. Beyond
+       *  @p max_objects subscribed objects, the least recently used subscriptions of the session are dropped.
+       */
+      void subscribe_to_object( const database_api_impl* session, const object_id_type& id, size_t max_objects );
+      void subscribe_to_market( const database_api_impl* session, const market_type& market );
+      void unsubscribe_from_market( const database_api_impl* session, const market_type& market );
+      /// Removes the subscriptions of the session to accounts and objects, and to markets if @p markets is set
+      void cancel_subscriptions( const database_api_impl* session, bool markets );
+
+   private:
+      using session_set = std::set<const database_api_impl*>;
+
+      struct session_subscriptions
+      {
+         std::weak_ptr<database_api_impl>  session;
+         std::set<account_id_type>         accounts;
+         /// The least recently used first
+         std::list<object_id_type>         objects;
+         std::unordered_map<object_id_type, std::list<object_id_type>::iterator> object_positions;
+         std::set<market_type>             markets;
+      };
+
+      std::shared_ptr<database_api_impl> lock_session( const database_api_impl* session )const;
+      void notify_objects( object_notification& notification );
+      void on_applied_block();
+      void on_pending_transaction( const signed_transaction& trx );
+
+      graphene::chain::database&                                 _db;
+      std::map<const database_api_impl*, session_subscriptions>  _sessions;
+
+      /// The sessions notified about all created and removed objects
+      session_set                                                _remove_create_sessions;
+      session_set                                                _block_applied_sessions;
+      session_set                                                _pending_trx_sessions;
+      std::map<account_id_type, session_set>                     _account_sessions;
+      std::unordered_map<object_id_type, session_set>            _object_sessions;
+      std::map<market_type, session_set>                         _market_sessions;
+
+      boost::signals2::scoped_connection _new_connection;
+      boost::signals2::scoped_connection _change_connection;
+      boost::signals2::scoped_connection _removed_connection;
+      boost::signals2::scoped_connection _applied_block_connection;
+      boost::signals2::scoped_connection _pending_trx_connection;
+};
+
+} } // graphene::app
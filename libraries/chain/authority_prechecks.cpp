@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/authority_prechecks.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/custom_authority_object.hpp>
+
+namespace graphene { namespace chain {
+
+void authority_prechecks::custom_authority_observer::object_inserted( const object& obj )
+{
+   _prechecks->changed( static_cast<const custom_authority_object&>( obj ).account );
+}
+
+void authority_prechecks::custom_authority_observer::object_removed( const object& obj )
+{
+   _prechecks->changed( static_cast<const custom_authority_object&>( obj ).account );
+}
+
+void authority_prechecks::custom_authority_observer::object_modified( const object& after )
+{
+   _prechecks->changed( static_cast<const custom_authority_object&>( after ).account );
+}
+
+void authority_prechecks::object_inserted( const object& obj )
+{
+   changed( static_cast<const account_object&>( obj ).get_id() );
+}
+
+void authority_prechecks::object_removed( const object& obj )
+{
+   changed( static_cast<const account_object&>( obj ).get_id() );
+}
+
+void authority_prechecks::object_modified( const object& after )
+{
+   changed( static_cast<const account_object&>( after ).get_id() );
+}
+
+void authority_prechecks::changed( account_id_type account )
+{
+   if( _active )
+      _changed.insert( account );
+}
+
+void authority_prechecks::start( const block_id_type& block_id, size_t trx_count )
+{
+   _block_id = block_id;
+   _results.clear();
+   _results.resize( trx_count );
+   _changed.clear();
+   _active = true;
+}
+
+void authority_prechecks::clear()
+{
+   _block_id = block_id_type();
+   _results.clear();
+   _changed.clear();
+   _active = false;
+}
+
+void authority_prechecks::set_result( size_t trx_in_block, bool passed, vector<account_id_type>&& accounts )
+{
+   auto& r = _results[ trx_in_block ];
+   r.passed = passed;
+   r.accounts = std::move( accounts );
+}
+
+bool authority_prechecks::passed( size_t trx_in_block )const
+{
+   if( !_active || trx_in_block >= _results.size() || !_results[ trx_in_block ].passed )
+      return false;
+   for( const auto& account : _results[ trx_in_block ].accounts )
+      if( _changed.find( account ) != _changed.end() )
+         return false;
+   return true;
+}
+
+} } // graphene::chain
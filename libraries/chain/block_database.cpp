@@ -23,9 +23,15 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <boost/endian/buffers.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -38,11 +44,122 @@ struct index_entry
    boost::endian::little_uint32_buf_t block_size;
    block_id_type                      block_id;
 };
+
+/// An entry of the archive chunk table. The first entry of the table is the header of the archive.
+struct archive_chunk_entry
+{
+   boost::endian::little_uint64_buf_t pos;       ///< chunk: position in the archive file; header: @c _blocks_base
+   boost::endian::little_uint32_buf_t size;      ///< chunk: compressed size; header: blocks per chunk
+   boost::endian::little_uint32_buf_t raw_size;  ///< chunk: uncompressed size; header: flags
+};
+
+/// Location of a block inside an uncompressed chunk, a chunk starts with one slot per block
+struct archive_slot
+{
+   boost::endian::little_uint32_buf_t offset;
+   boost::endian::little_uint32_buf_t size;
+};
+
+static constexpr uint32_t archive_compaction_pending = 1;
+static constexpr size_t   archive_chunk_cache_size = 8;
+/// Bytes written past the mappings before they are replaced, see block_database::store()
+static constexpr uint64_t remap_threshold = 64 * 1024 * 1024;
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
+struct block_database::archived_chunk
+{
+   std::vector<char> data;
+   uint32_t          first_block_num = 0;
+   uint32_t          block_count = 0;
+
+   /// @return the packed block, or a null pointer with @p size 0 if the slot is empty
+   const char* get( uint32_t block_num, uint32_t& size )const
+   {
+      size = 0;
+      if( block_num < first_block_num || block_num - first_block_num >= block_count )
+         return nullptr;
+      archive_slot slot;
+      std::memcpy( (char*)&slot, data.data() + sizeof(archive_slot) * (block_num - first_block_num), sizeof(slot) );
+      const size_t begin = sizeof(archive_slot) * block_count + slot.offset.value();
+      FC_ASSERT( begin + slot.size.value() <= data.size(), "Corrupt archive chunk" );
+      size = slot.size.value();
+      return data.data() + begin;
+   }
+};
+
+} }
+
+namespace graphene { namespace chain {
+
+/**
+ * Read-only mappings of the block database files. An instance is never modified after construction,
+ * readers hold a shared_ptr to it so that a concurrent remap() does not unmap memory in use.
+ */
+struct block_database::mapped_view
+{
+   explicit mapped_view( const block_database& db )
+   : blocks_base( db._blocks_base ), archive_chunk_size( db._archive_chunk_size )
+   {
+      map_file( db._index_filename, index_mapping, index_region, index_data, index_size );
+      map_file( db._blocks_filename, blocks_mapping, blocks_region, blocks_data, blocks_size );
+      if( archive_chunk_size > 0 )
+      {
+         map_file( db._archive_filename, archive_mapping, archive_region, archive_data, archive_size );
+         map_file( db._archive_index_filename, chunks_mapping, chunks_region, chunks_data, chunks_size );
+      }
+   }
+
+   size_t index_entries()const { return index_size / sizeof(index_entry); }
+   uint32_t archived_chunks()const
+   {
+      return chunks_size < sizeof(archive_chunk_entry) ? 0 : chunks_size / sizeof(archive_chunk_entry) - 1;
+   }
+   bool is_archived( uint32_t block_num )const
+   {
+      return archive_chunk_size > 0 && block_num / archive_chunk_size < archived_chunks();
+   }
+
+   const uint64_t                     blocks_base;
+   const uint32_t                     archive_chunk_size;
+
+   std::unique_ptr<fc::file_mapping>  index_mapping;
+   std::unique_ptr<fc::mapped_region> index_region;
+   const char*                        index_data = nullptr;
+   size_t                             index_size = 0;
+
+   std::unique_ptr<fc::file_mapping>  blocks_mapping;
+   std::unique_ptr<fc::mapped_region> blocks_region;
+   const char*                        blocks_data = nullptr;
+   size_t                             blocks_size = 0;
+
+   std::unique_ptr<fc::file_mapping>  archive_mapping;
+   std::unique_ptr<fc::mapped_region> archive_region;
+   const char*                        archive_data = nullptr;
+   size_t                             archive_size = 0;
+
+   std::unique_ptr<fc::file_mapping>  chunks_mapping;
+   std::unique_ptr<fc::mapped_region> chunks_region;
+   const char*                        chunks_data = nullptr;
+   size_t                             chunks_size = 0;
+
+private:
+   static void map_file( const fc::path& file,
+                         std::unique_ptr<fc::file_mapping>& mapping,
+                         std::unique_ptr<fc::mapped_region>& region,
+                         const char*& data, size_t& size )
+   {
+      size = fc::exists( file ) ? fc::file_size( file ) : 0;
+      if( size == 0 ) // empty files can not be mapped
+         return;
+      mapping = std::make_unique<fc::file_mapping>( file.generic_string().c_str(), fc::read_only );
+      region = std::make_unique<fc::mapped_region>( *mapping, fc::read_only, 0, size );
+      data = (const char*)region->get_address();
+   }
+};
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
@@ -50,18 +167,94 @@ void block_database::open( const fc::path& dbdir )
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
    _index_filename = dbdir / "index";
+   _blocks_filename = dbdir / "blocks";
+   _archive_filename = dbdir / "archive";
+   _archive_index_filename = dbdir / "archive_index";
    if( !fc::exists( _index_filename ) )
    {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+     _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
    }
    else
    {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+     _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
    }
+   open_archive();
+   _last_read_position = 0;
+   remap();
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
+void block_database::open_archive()
+{
+   _archive_chunk_size = 0;
+   _blocks_base = 0;
+   {
+      std::lock_guard<std::mutex> guard( _chunk_cache_mutex );
+      _chunk_cache.clear();
+   }
+   const fc::path compact_filename = _blocks_filename.generic_string() + ".compact";
+   if( !fc::exists( _archive_index_filename ) )
+   {
+      if( fc::exists( compact_filename ) )
+         fc::remove( compact_filename );
+      if( _desired_archive_chunk_size == 0 )
+         return;
+      _archive_chunk_size = _desired_archive_chunk_size;
+      _archive_index.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      _archive.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      _archive_index.open( _archive_index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+      _archive.open( _archive_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+      write_archive_header( 0 );
+      return;
+   }
+
+   _archive_index.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   _archive.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   _archive_index.open( _archive_index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   _archive.open( _archive_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+
+   archive_chunk_entry header;
+   _archive_index.seekg( 0 );
+   _archive_index.read( (char*)&header, sizeof(header) );
+   FC_ASSERT( header.size.value() > 0, "Corrupt block archive header" );
+   _archive_chunk_size = header.size.value();
+   _blocks_base = header.pos.value();
+   if( _desired_archive_chunk_size != 0 && _desired_archive_chunk_size != _archive_chunk_size )
+      wlog( "Keeping the existing block archive chunk size ${n} instead of ${d}",
+            ("n", _archive_chunk_size)("d", _desired_archive_chunk_size) );
+
+   // finish an interrupted compaction, see compact_blocks()
+   if( header.raw_size.value() & archive_compaction_pending )
+   {
+      if( fc::exists( compact_filename ) )
+      {
+         _blocks.close();
+         fc::rename( compact_filename, _blocks_filename );
+         _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      }
+      write_archive_header( 0 );
+   }
+   else if( fc::exists( compact_filename ) )
+      fc::remove( compact_filename );
+
+   // drop a chunk table entry that was only partially written
+   const size_t table_size = fc::file_size( _archive_index_filename );
+   if( table_size % sizeof(archive_chunk_entry) != 0 )
+      fc::resize_file( _archive_index_filename, table_size - table_size % sizeof(archive_chunk_entry) );
+}
+
+void block_database::write_archive_header( uint32_t flags )
+{
+   archive_chunk_entry header;
+   header.pos = _blocks_base;
+   header.size = _archive_chunk_size;
+   header.raw_size = flags;
+   _archive_index.seekp( 0 );
+   _archive_index.write( (char*)&header, sizeof(header) );
+   _archive_index.flush();
+}
+
 bool block_database::is_open()const
 {
   return _blocks.is_open();
@@ -69,14 +262,204 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
+  std::atomic_store( &_view, std::shared_ptr<const mapped_view>() );
+  {
+     std::lock_guard<std::mutex> guard( _tail_mutex );
+     _index_tail.close();
+     _blocks_tail.close();
+  }
   _blocks.close();
   _block_num_to_pos.close();
+  if( _archive.is_open() )
+     _archive.close();
+  if( _archive_index.is_open() )
+     _archive_index.close();
 }
 
 void block_database::flush()
 {
   _blocks.flush();
   _block_num_to_pos.flush();
+  if( _archive.is_open() )
+     _archive.flush();
+  if( _archive_index.is_open() )
+     _archive_index.flush();
+}
+
+void block_database::remap()const
+{
+   auto view = std::make_shared<const mapped_view>( *this );
+   {
+      // the blocks file is replaced by compact_blocks()
+      std::lock_guard<std::mutex> guard( _tail_mutex );
+      if( _index_tail.is_open() )
+         _index_tail.close();
+      if( _blocks_tail.is_open() )
+         _blocks_tail.close();
+      _index_tail.open( _index_filename.generic_string().c_str(), std::ifstream::binary | std::ifstream::in );
+      _blocks_tail.open( _blocks_filename.generic_string().c_str(), std::ifstream::binary | std::ifstream::in );
+      _tail_blocks_base = view->blocks_base;
+   }
+   _index_end = view->index_size;
+   _blocks_end = view->blocks_base + view->blocks_size;
+   std::atomic_store( &_view, std::shared_ptr<const mapped_view>( std::move( view ) ) );
+}
+
+uint64_t block_database::unmapped_bytes( const mapped_view& view )const
+{
+   return ( _index_end - view.index_size ) + ( _blocks_end - view.blocks_base - view.blocks_size );
+}
+
+bool block_database::read_index_tail( uint64_t offset, char* data, size_t size )const
+{
+   if( offset + size > _index_end )
+      return false;
+   std::lock_guard<std::mutex> guard( _tail_mutex );
+   _index_tail.clear();
+   _index_tail.seekg( offset );
+   _index_tail.read( data, size );
+   return _index_tail.gcount() == std::streamsize( size );
+}
+
+bool block_database::read_blocks_tail( uint64_t pos, char* data, size_t size )const
+{
+   if( pos + size > _blocks_end )
+      return false;
+   std::lock_guard<std::mutex> guard( _tail_mutex );
+   if( pos < _tail_blocks_base )
+      return false;
+   _blocks_tail.clear();
+   _blocks_tail.seekg( pos - _tail_blocks_base );
+   _blocks_tail.read( data, size );
+   return _blocks_tail.gcount() == std::streamsize( size );
+}
+
+std::shared_ptr<const block_database::mapped_view> block_database::current_view()const
+{
+   auto view = std::atomic_load( &_view );
+   FC_ASSERT( view, "block_database is not open" );
+   return view;
+}
+
+optional<index_entry> block_database::read_index_entry( const mapped_view& view, uint32_t block_num )const
+{
+   index_entry e;
+   if( block_num < view.index_entries() )
+      std::memcpy( (char*)&e, view.index_data + sizeof(index_entry) * size_t(block_num), sizeof(e) );
+   else if( !read_index_tail( sizeof(index_entry) * uint64_t(block_num), (char*)&e, sizeof(e) ) )
+      return {};
+   return e;
+}
+
+optional<signed_block> block_database::read_block( const mapped_view& view, const index_entry& e )const
+{
+   const uint64_t pos = e.block_pos.value();
+   const uint32_t size = e.block_size.value();
+   if( size == 0 )
+      return {};
+   if( pos < view.blocks_base ) // cut off from the blocks file
+      return read_archived_block( view, e );
+   const char* data = view.blocks_data + ( pos - view.blocks_base );
+   std::vector<char> tail;
+   if( pos - view.blocks_base + size > view.blocks_size )
+   {
+      tail.resize( size );
+      if( !read_blocks_tail( pos, tail.data(), size ) )
+         return {};
+      data = tail.data();
+   }
+   fc::datastream<const char*> ds( data, size );
+   signed_block result;
+   fc::raw::unpack( ds, result );
+   FC_ASSERT( result.id() == e.block_id );
+   _last_read_position = pos + size;
+   return result;
+}
+
+optional<signed_block> block_database::read_archived_block( const mapped_view& view, const index_entry& e )const
+{
+   const uint32_t block_num = block_header::num_from_id( e.block_id );
+   if( !view.is_archived( block_num ) )
+      return {};
+   const auto chunk = load_chunk( view, block_num / view.archive_chunk_size );
+   uint32_t size = 0;
+   const char* data = chunk->get( block_num, size );
+   if( size == 0 )
+      return {};
+   fc::datastream<const char*> ds( data, size );
+   signed_block result;
+   fc::raw::unpack( ds, result );
+   FC_ASSERT( result.id() == e.block_id );
+   return result;
+}
+
+bool block_database::read_packed_block( const mapped_view& view, const index_entry& e, std::vector<char>& data )const
+{
+   const uint64_t pos = e.block_pos.value();
+   const uint32_t size = e.block_size.value();
+   if( size == 0 )
+      return false;
+   if( pos < view.blocks_base )
+   {
+      const uint32_t block_num = block_header::num_from_id( e.block_id );
+      if( !view.is_archived( block_num ) )
+         return false;
+      const auto chunk = load_chunk( view, block_num / view.archive_chunk_size );
+      uint32_t archived_size = 0;
+      const char* archived_data = chunk->get( block_num, archived_size );
+      if( archived_size == 0 )
+         return false;
+      data.assign( archived_data, archived_data + archived_size );
+      return true;
+   }
+   if( pos - view.blocks_base + size > view.blocks_size )
+   {
+      data.resize( size );
+      if( !read_blocks_tail( pos, data.data(), size ) )
+         return false;
+   }
+   else
+   {
+      const char* begin = view.blocks_data + ( pos - view.blocks_base );
+      data.assign( begin, begin + size );
+   }
+   _last_read_position = pos + size;
+   return true;
+}
+
+std::shared_ptr<const block_database::archived_chunk> block_database::load_chunk( const mapped_view& view,
+                                                                                  uint32_t chunk )const
+{
+   std::lock_guard<std::mutex> guard( _chunk_cache_mutex );
+   for( auto itr = _chunk_cache.begin(); itr != _chunk_cache.end(); ++itr )
+   {
+      if( itr->first == chunk )
+      {
+         _chunk_cache.splice( _chunk_cache.begin(), _chunk_cache, itr );
+         return _chunk_cache.front().second;
+      }
+   }
+
+   FC_ASSERT( chunk < view.archived_chunks(), "Chunk ${c} is not archived", ("c", chunk) );
+   archive_chunk_entry c;
+   std::memcpy( (char*)&c, view.chunks_data + sizeof(archive_chunk_entry) * ( size_t(chunk) + 1 ), sizeof(c) );
+   FC_ASSERT( c.pos.value() + c.size.value() <= view.archive_size, "Corrupt block archive" );
+
+   auto result = std::make_shared<archived_chunk>();
+   result->first_block_num = chunk * view.archive_chunk_size;
+   result->block_count = view.archive_chunk_size;
+   result->data.resize( c.raw_size.value() );
+   uLongf raw_size = c.raw_size.value();
+   FC_ASSERT( uncompress( (Bytef*)result->data.data(), &raw_size,
+                          (const Bytef*)view.archive_data + c.pos.value(), c.size.value() ) == Z_OK
+              && raw_size == c.raw_size.value()
+              && raw_size >= sizeof(archive_slot) * result->block_count,
+              "Failed to decompress block archive chunk ${c}", ("c", chunk) );
+
+   _chunk_cache.emplace_front( chunk, result );
+   if( _chunk_cache.size() > archive_chunk_cache_size )
+      _chunk_cache.pop_back();
+   return result;
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -91,29 +474,35 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
    index_entry e;
    _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   e.block_pos  = _blocks_base + uint64_t( _blocks.tellp() );
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   // readers only see what is on disk, and the index entry must not become visible before the block itself
+   _blocks.flush();
+   _block_num_to_pos.flush();
+   const uint64_t index_end = sizeof(index_entry) * ( uint64_t(block_header::num_from_id(id)) + 1 );
+   _index_end = std::max<uint64_t>( _index_end, index_end );
+   _blocks_end = e.block_pos.value() + e.block_size.value();
+   // mapping the files again costs time in their size, until then the new data is read through the streams
+   if( unmapped_bytes( *current_view() ) >= remap_threshold )
+      remap();
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
-   index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   const auto view = current_view();
+   optional<index_entry> e = read_index_entry( *view, block_header::num_from_id(id) );
+   if( !e.valid() )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-   if( e.block_id == id )
+   if( e->block_id == id )
    {
-      e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      e->block_size = 0;
+      _block_num_to_pos.seekp( sizeof(index_entry) * int64_t(block_header::num_from_id(id)) );
+      _block_num_to_pos.write( (char*)&(*e), sizeof(index_entry) );
+      _block_num_to_pos.flush();
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
@@ -122,55 +511,32 @@ bool block_database::contains( const block_id_type& id )const
    if( id == block_id_type() )
       return false;
 
-   index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
-      return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-   return e.block_id == id && e.block_size.value() > 0;
+   const auto view = current_view();
+   optional<index_entry> e = read_index_entry( *view, block_header::num_from_id(id) );
+   return e.valid() && e->block_id == id && e->block_size.value() > 0;
 }
 
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
-   index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   const auto view = current_view();
+   optional<index_entry> e = read_index_entry( *view, block_num );
+   if( !e.valid() )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-   FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
-   return e.block_id;
+   FC_ASSERT( e->block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+   return e->block_id;
 }
 
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
-      index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
-
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      if( e.block_id != id ) return optional<signed_block>();
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      const auto view = current_view();
+      optional<index_entry> e = read_index_entry( *view, block_header::num_from_id(id) );
+      if( !e.valid() || e->block_id != id )
+         return optional<signed_block>();
+      return read_block( *view, *e );
    }
    catch (const fc::exception&)
    {
@@ -185,21 +551,11 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
-      index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
-
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      const auto view = current_view();
+      optional<index_entry> e = read_index_entry( *view, block_num );
+      if( !e.valid() )
+         return optional<signed_block>();
+      return read_block( *view, *e );
    }
    catch (const fc::exception&)
    {
@@ -210,38 +566,42 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<index_entry> block_database::last_index_entry()const {
+optional< std::vector<char> > block_database::fetch_packed_by_number( uint32_t block_num )const
+{
    try
    {
-      index_entry e;
-
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
-         return optional<index_entry>();
-
-      pos -= pos % sizeof(index_entry);
+      const auto view = current_view();
+      optional<index_entry> e = read_index_entry( *view, block_num );
+      std::vector<char> data;
+      if( e.valid() && read_packed_block( *view, *e, data ) )
+         return data;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return optional< std::vector<char> >();
+}
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
-      while( pos > 0 )
+optional<index_entry> block_database::last_index_entry()const {
+   try
+   {
+      const auto view = current_view();
+      size_t count = _index_end / sizeof(index_entry);
+      bool truncated = false;
+      optional<index_entry> result;
+      while( count > 0 && !result.valid() )
       {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
+         --count;
+         optional<index_entry> e = read_index_entry( *view, count );
+         if( e.valid() && e->block_size.value() > 0
+             && e->block_pos.value() + e->block_size.value() <= _blocks_end )
             try
             {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               if( read_block( *view, *e ).valid() )
+                  result = e;
             }
             catch (const fc::exception&)
             {
@@ -249,8 +609,15 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
-         fc::resize_file( _index_filename, pos );
+         if( !result.valid() )
+         {
+            fc::resize_file( _index_filename, count * sizeof(index_entry) );
+            truncated = true;
+         }
       }
+      if( truncated )
+         remap();
+      return result;
    }
    catch (const fc::exception&)
    {
@@ -277,13 +644,132 @@ optional<block_id_type> block_database::last_id()const
 
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   return _last_read_position;
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   return _blocks_end;
+}
+
+uint32_t block_database::archived_chunk_count()const
+{
+   return current_view()->archived_chunks();
+}
+
+bool block_database::archive_blocks( uint32_t last_irreversible_block_num, uint32_t max_chunks )
+{ try {
+   if( _desired_archive_chunk_size == 0 || _archive_chunk_size == 0 )
+      return false;
+
+   auto view = current_view();
+   uint32_t next_chunk = view->archived_chunks();
+   const auto chunk_ready = [this,&next_chunk,last_irreversible_block_num]() {
+      return uint64_t( next_chunk + 1 ) * _archive_chunk_size <= uint64_t( last_irreversible_block_num ) + 1
+             && uint64_t( next_chunk + 1 ) * _archive_chunk_size <= _index_end / sizeof(index_entry);
+   };
+   uint32_t archived = 0;
+   while( archived < max_chunks && chunk_ready() )
+   {
+      // the chunk is read from the mappings
+      if( unmapped_bytes( *view ) > 0 )
+      {
+         remap();
+         view = current_view();
+      }
+      write_archive_chunk( *view, next_chunk );
+      ++next_chunk;
+      ++archived;
+      remap();
+      view = current_view();
+   }
+   if( archived > 0 )
+   {
+      compact_blocks();
+      view = current_view();
+   }
+   return chunk_ready();
+} FC_CAPTURE_AND_RETHROW( (last_irreversible_block_num)(max_chunks) ) }
+
+void block_database::write_archive_chunk( const mapped_view& view, uint32_t chunk )
+{
+   const uint32_t first = chunk * _archive_chunk_size;
+   std::vector<char> raw( sizeof(archive_slot) * _archive_chunk_size );
+   for( uint32_t i = 0; i < _archive_chunk_size; ++i )
+   {
+      archive_slot slot;
+      slot.offset = 0;
+      slot.size = 0;
+      optional<index_entry> e = read_index_entry( view, first + i );
+      if( e.valid() && e->block_size.value() > 0 )
+      {
+         const uint64_t pos = e->block_pos.value();
+         const uint32_t size = e->block_size.value();
+         FC_ASSERT( pos >= view.blocks_base && pos - view.blocks_base + size <= view.blocks_size,
+                    "Block ${n} is missing from the blocks file", ("n", first + i) );
+         slot.offset = raw.size() - sizeof(archive_slot) * _archive_chunk_size;
+         slot.size = size;
+         const char* data = view.blocks_data + ( pos - view.blocks_base );
+         raw.insert( raw.end(), data, data + size );
+      }
+      std::memcpy( raw.data() + sizeof(archive_slot) * i, (const char*)&slot, sizeof(slot) );
+   }
+
+   uLongf compressed_size = compressBound( raw.size() );
+   std::vector<char> compressed( compressed_size );
+   FC_ASSERT( compress2( (Bytef*)compressed.data(), &compressed_size, (const Bytef*)raw.data(), raw.size(),
+                         Z_DEFAULT_COMPRESSION ) == Z_OK,
+              "Failed to compress block archive chunk ${c}", ("c", chunk) );
+
+   archive_chunk_entry c;
+   _archive.seekp( 0, _archive.end );
+   c.pos = _archive.tellp();
+   c.size = compressed_size;
+   c.raw_size = raw.size();
+   _archive.write( compressed.data(), compressed_size );
+   _archive.flush();
+   // the chunk becomes visible to readers with its table entry
+   _archive_index.seekp( sizeof(archive_chunk_entry) * ( size_t(chunk) + 1 ) );
+   _archive_index.write( (char*)&c, sizeof(c) );
+   _archive_index.flush();
+}
+
+void block_database::compact_blocks()
+{
+   const auto view = current_view();
+   const uint64_t blocks_end = view->blocks_base + view->blocks_size;
+
+   // everything before the first block that is not archived is unused
+   uint64_t first_used = blocks_end;
+   for( size_t num = size_t( view->archived_chunks() ) * _archive_chunk_size; num < view->index_entries(); ++num )
+   {
+      optional<index_entry> e = read_index_entry( *view, num );
+      if( e->block_size.value() > 0 && e->block_pos.value() >= view->blocks_base )
+         first_used = std::min<uint64_t>( first_used, e->block_pos.value() );
+   }
+   if( ( first_used - view->blocks_base ) * 2 < view->blocks_size )
+      return;
+
+   ilog( "Compacting the blocks file, releasing ${n} bytes of archived blocks",
+         ("n", first_used - view->blocks_base) );
+   const fc::path compact_filename = _blocks_filename.generic_string() + ".compact";
+   {
+      std::ofstream out( compact_filename.generic_string().c_str(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out );
+      out.write( view->blocks_data + ( first_used - view->blocks_base ), blocks_end - first_used );
+      out.flush();
+      FC_ASSERT( out, "Failed to write ${f}", ("f", compact_filename) );
+   }
+
+   // From here on open_archive() completes the compaction if we crash
+   _blocks_base = first_used;
+   write_archive_header( archive_compaction_pending );
+   _blocks.close();
+   fc::rename( compact_filename, _blocks_filename );
+   _blocks.open( _blocks_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   write_archive_header( 0 );
+   remap();
 }
 
 } }
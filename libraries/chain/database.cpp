@@ -23,6 +23,7 @@
  */
 #include "db_balance.cpp"
 #include "db_block.cpp"
+#include "db_checkpoint.cpp"
 #include "db_debug.cpp"
 #include "db_genesis.cpp"
 #include "db_getter.cpp"
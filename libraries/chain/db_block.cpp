@@ -26,10 +26,12 @@
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/hardfork.hpp>
 
+#include <graphene/chain/authority_prechecks.hpp>
 #include <graphene/chain/block_summary_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 
+#include <graphene/chain/custom_authority_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/samet_fund_object.hpp>
 #include <graphene/chain/transaction_history_object.hpp>
@@ -43,6 +45,8 @@
 #include <fc/io/raw.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <future>
+
 namespace graphene { namespace chain {
 
 bool database::is_known_block( const block_id_type& id )const
@@ -117,6 +121,8 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
 //   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   // unless the node did it together with the precomputations
+   precheck_authorities( new_block, skip );
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -151,6 +157,7 @@ bool database::_push_block(const signed_block& new_block)
       //Only switch forks if new_head is actually higher than head
       if( new_head->data.block_num() > head_block_num() )
       {
+         finish_catch_up_batch();
          wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
          auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
 
@@ -211,6 +218,21 @@ bool database::_push_block(const signed_block& new_block)
       else return false;
    }
 
+   if( _trusted_catch_up_age > 0 && _undo_db.enabled()
+       && new_block.timestamp.sec_since_epoch() + _trusted_catch_up_age < now )
+   {
+      apply_catch_up_block( new_block, new_head, skip );
+      write_state_checkpoint();
+      return false;
+   }
+   if( _catch_up_blocks > 0 )
+   {
+      finish_catch_up_batch();
+      ilog( "Left trusted catch-up mode after ${b} blocks at block #${n}",
+            ("b", _catch_up_blocks)("n", head_block_num()) );
+      _catch_up_blocks = 0;
+   }
+
    try {
       auto session = _undo_db.start_undo_session();
       apply_block(new_block, skip);
@@ -224,9 +246,84 @@ bool database::_push_block(const signed_block& new_block)
       throw;
    }
 
+   write_state_checkpoint();
+
    return false;
 } FC_CAPTURE_AND_RETHROW( (new_block) ) }
 
+void database::set_trusted_catch_up( uint32_t seconds, uint32_t batch_size )
+{
+   _trusted_catch_up_age = seconds;
+   _catch_up_batch_size = std::max<uint32_t>( batch_size, 1 );
+}
+
+bool database::archive_irreversible_blocks( uint32_t max_chunks )
+{
+   return _block_id_to_block.archive_blocks( get_dynamic_global_properties().last_irreversible_block_num,
+                                             max_chunks );
+}
+
+/**
+ * Applies a block which is so old that it is treated as irreversible, while syncing after a long downtime.
+ *
+ * Instead of one undo state per block in the undo history, all blocks of a batch share one undo state. Every
+ * block is applied in a nested session which is merged into it, so a block which fails to apply is undone
+ * alone and the blocks before it are neither undone nor applied again. When the batch is full it is committed
+ * and the undo history is dropped, so these blocks can not be popped later, just like the blocks before the
+ * head of a replayed or restarted node.
+ */
+void database::apply_catch_up_block( const signed_block& new_block, const shared_ptr<fork_item>& new_head,
+                                     uint32_t skip )
+{
+   if( !_catch_up_session.valid() )
+   {
+      if( _catch_up_blocks == 0 )
+      {
+         ilog( "Block #${n} is ${s} seconds old, applying blocks in trusted catch-up mode",
+               ("n", new_block.block_num())
+               ("s", fc::time_point::now().sec_since_epoch() - new_block.timestamp.sec_since_epoch()) );
+         _catch_up_start = fc::time_point::now();
+      }
+      _catch_up_session = _undo_db.start_undo_session();
+   }
+
+   try {
+      // a failing block only undoes its own session, the batch keeps the state of the last valid block
+      auto session = _undo_db.start_undo_session();
+      apply_block( new_block, skip );
+      if( new_block.timestamp.sec_since_epoch() > fc::time_point::now().sec_since_epoch() - 86400 )
+         update_witnesses( *new_head );
+      _block_id_to_block.store( new_block.id(), new_block );
+      session.merge();
+   } catch ( const fc::exception& e ) {
+      elog( "Failed to push new block:\n${e}", ("e", e.to_detail_string()) );
+      _fork_db.remove( new_block.id() );
+      throw;
+   }
+
+   ++_catch_up_batch_blocks;
+   ++_catch_up_blocks;
+   if( _catch_up_batch_blocks >= _catch_up_batch_size )
+   {
+      finish_catch_up_batch();
+      const auto elapsed = std::max<int64_t>( ( fc::time_point::now() - _catch_up_start ).count() / 1000, 1 );
+      ilog( "Trusted catch-up at block #${n}, ${b} blocks in ${t} s (${r} blocks/s)",
+            ("n", new_block.block_num())("b", _catch_up_blocks)("t", elapsed / 1000)
+            ("r", uint64_t(_catch_up_blocks) * 1000 / elapsed) );
+   }
+}
+
+void database::finish_catch_up_batch()
+{
+   if( _catch_up_session.valid() )
+   {
+      _catch_up_session->commit();
+      _catch_up_session.reset();
+      _catch_up_batch_blocks = 0;
+      _undo_db.discard_history();
+   }
+}
+
 void database::verify_signing_witness( const signed_block& new_block, const fork_item& fork_entry )const
 {
    FC_ASSERT( new_block.timestamp >= fork_entry.next_block_time );
@@ -272,6 +369,8 @@ processed_transaction database::push_transaction( const precomputable_transactio
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
+      // the queued transactions were received before this one
+      restore_pending_transactions();
       result = _push_transaction( trx );
    } );
    return result;
@@ -297,13 +396,81 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
 
+   if( _candidate_valid )
+      append_candidate_transaction( processed_trx );
+
    // notify anyone listening to pending transactions
    notify_on_pending_transaction( trx );
    return processed_trx;
 }
 
+void database::set_candidate_block( bool enabled )
+{
+   _candidate_block_enabled = enabled;
+   // the current pending transactions are not in the candidate, it starts with the next block
+   _candidate_valid = false;
+   _candidate_tx.clear();
+   _candidate_merkle.clear();
+}
+
+void database::reset_candidate_block()
+{
+   _candidate_valid = _candidate_block_enabled;
+   _candidate_tx.clear();
+   _candidate_merkle.clear();
+   _candidate_size = 0;
+   _candidate_skip = 0;
+}
+
+void database::append_candidate_transaction( const processed_transaction& trx )
+{
+   processed_transaction ptx( trx );
+   // the copy would keep a merkle digest cached with the results
+   ptx.set_operation_results( {} );
+   const size_t size = fc::raw::pack_size( ptx );
+   // _generate_block() would postpone a transaction which does not fit, and apply the later ones to another state
+   if( _candidate_size + size > get_global_properties().parameters.maximum_block_size )
+   {
+      _candidate_valid = false;
+      return;
+   }
+   _candidate_size += size;
+   _candidate_skip |= get_node_properties().skip_flags;
+   _candidate_merkle.append( ptx.merkle_digest() );
+   _candidate_tx.push_back( std::move( ptx ) );
+}
+
+bool database::candidate_block_usable( uint32_t skip, size_t max_transactions_size )const
+{
+   // the candidate transactions were applied to the pending state in the order _generate_block() would apply
+   // them, and without skipping any check which _generate_block() would do
+   return _candidate_valid && _queued_pending_tx.empty() && _candidate_tx.size() == _pending_tx.size()
+          && 0 == ( _candidate_skip & ~skip ) && _candidate_size <= max_transactions_size;
+}
+
+size_t database::restore_pending_transactions( size_t max_count )
+{
+   size_t count = 0;
+   while( !_queued_pending_tx.empty() && count < max_count )
+   {
+      const precomputable_transaction tx = std::move( _queued_pending_tx.front() );
+      _queued_pending_tx.pop_front();
+      ++count;
+      try
+      {
+         if( !is_known_transaction( tx.id() ) )
+            _push_transaction( tx );
+      }
+      catch( const fc::exception& )
+      { // ignore invalid transactions
+      }
+   }
+   return count;
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
+   restore_pending_transactions();
    auto session = _undo_db.start_undo_session();
    return _apply_transaction( trx );
 }
@@ -398,6 +565,18 @@ signed_block database::_generate_block(
    witness_id_type scheduled_witness = get_scheduled_witness( slot_num );
    FC_ASSERT( scheduled_witness == witness_id );
 
+   static const size_t max_partial_block_header_size = fc::raw::pack_size( signed_block_header() )
+                                                       - fc::raw::pack_size( witness_id_type() ) // witness_id
+                                                       + 3; // max space to store size of transactions (out of block header),
+                                                            // +3 means 3*7=21 bits so it's practically safe
+   const size_t max_block_header_size = max_partial_block_header_size + fc::raw::pack_size( witness_id );
+   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
+
+   // The candidate block was built by applying the pending transactions to the head block state, exactly what
+   // the rebuild below would do, so it is used as it is.
+   const bool use_candidate = maximum_block_size >= max_block_header_size
+                              && candidate_block_usable( skip, maximum_block_size - max_block_header_size );
+
    //
    // The following code throws away existing pending_tx_session and
    // rebuilds it by re-applying pending transactions.
@@ -411,7 +590,8 @@ signed_block database::_generate_block(
    //
 
    // pop pending state (reset to head block state)
-   _pending_tx_session.reset();
+   if( !use_candidate )
+      _pending_tx_session.reset();
 
    // Check witness signing key
    if( 0 == (skip & skip_witness_signature) )
@@ -424,21 +604,24 @@ signed_block database::_generate_block(
       FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
    }
 
-   static const size_t max_partial_block_header_size = fc::raw::pack_size( signed_block_header() )
-                                                       - fc::raw::pack_size( witness_id_type() ) // witness_id
-                                                       + 3; // max space to store size of transactions (out of block header),
-                                                            // +3 means 3*7=21 bits so it's practically safe
-   const size_t max_block_header_size = max_partial_block_header_size + fc::raw::pack_size( witness_id );
-   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
    size_t total_block_size = max_block_header_size;
 
    signed_block pending_block;
 
-   _pending_tx_session = _undo_db.start_undo_session();
+   if( use_candidate )
+      pending_block.transactions = std::move( _candidate_tx );
+   else
+      _pending_tx_session = _undo_db.start_undo_session();
+
+   // the queued transactions are applied here anyway, so they are not restored before
+   const size_t queued_count = use_candidate ? 0 : _queued_pending_tx.size();
+   const size_t candidate_count = use_candidate ? 0 : queued_count + _pending_tx.size();
 
    uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   for( size_t i = 0; i < candidate_count; ++i )
    {
+      const precomputable_transaction& tx = ( i < queued_count ) ? _queued_pending_tx[i]
+                                                                 : _pending_tx[ i - queued_count ];
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
       // postpone transaction if it would make block too big
@@ -485,6 +668,7 @@ signed_block database::_generate_block(
    }
 
    _pending_tx_session.reset();
+   _candidate_valid = false;
 
    // We have temporarily broken the invariant that
    // _pending_tx_session is the result of applying _pending_tx, as
@@ -494,7 +678,10 @@ signed_block database::_generate_block(
 
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
-   pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+   if( use_candidate )
+      pending_block.transaction_merkle_root = pending_block.calculate_merkle_root( _candidate_merkle );
+   else
+      pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
    pending_block.witness = witness_id;
 
    if( 0 == (skip & skip_witness_signature) )
@@ -512,6 +699,8 @@ signed_block database::_generate_block(
 void database::pop_block()
 { try {
    _pending_tx_session.reset();
+   _candidate_valid = false;
+   finish_catch_up_batch();
    auto fork_db_head = _fork_db.head();
    FC_ASSERT( fork_db_head, "Trying to pop() from empty fork database!?" );
    if( fork_db_head->id == head_block_id() )
@@ -529,7 +718,9 @@ void database::clear_pending()
 { try {
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _queued_pending_tx.clear();
    _pending_tx_session.reset();
+   reset_candidate_block();
 } FC_CAPTURE_AND_RETHROW() }
 
 uint32_t database::push_applied_operation( const operation& op, bool is_virtual /* = true */ )
@@ -612,18 +803,31 @@ void database::_apply_block( const signed_block& next_block )
 
    _issue_453_affected_assets.clear();
 
+   // the prechecks are only used by the block they were made for, see precheck_authorities()
+   if( !_authority_prechecks->is_for( next_block.id() ) )
+      _authority_prechecks->clear();
+
    signed_block processed_block( next_block ); // make a copy
-   for( auto& trx : processed_block.transactions )
+   try
+   {
+      for( auto& trx : processed_block.transactions )
+      {
+         /* We do not need to push the undo state for each transaction
+          * because they either all apply and are valid or the
+          * entire block fails to apply.  We only need an "undo" state
+          * for transactions when validating broadcast transactions or
+          * when building a block.
+          */
+         trx.set_operation_results( std::move( apply_transaction( trx, skip ).operation_results ) );
+         ++_current_trx_in_block;
+      }
+   }
+   catch( ... )
    {
-      /* We do not need to push the undo state for each transaction
-       * because they either all apply and are valid or the
-       * entire block fails to apply.  We only need an "undo" state
-       * for transactions when validating broadcast transactions or
-       * when building a block.
-       */
-      trx.operation_results = apply_transaction( trx, skip ).operation_results;
-      ++_current_trx_in_block;
+      _authority_prechecks->clear();
+      throw;
    }
+   _authority_prechecks->clear();
 
    _current_op_in_trx    = 0;
    _current_virtual_op   = 0;
@@ -689,7 +893,6 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    trx.validate();
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
-   const chain_id_type& chain_id = get_chain_id();
    if( 0 == (skip & skip_transaction_dupe_check) )
    {
       GRAPHENE_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx.id()) == trx_idx.indices().get<by_trx_id>().end(),
@@ -703,16 +906,21 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
    if( 0 == (skip & skip_transaction_signatures) )
    {
-      bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
-      auto get_active = [this]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [this]( account_id_type id ) { return &id(*this).owner;  };
-      auto get_custom = [this]( account_id_type id, const operation& op, rejected_predicate_map* rejects ) {
-         return get_viable_custom_authorities(id, op, rejects);
-      };
-
-      trx.verify_authority(chain_id, get_active, get_owner, get_custom, allow_non_immediate_owner,
-                           MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(head_block_time()),
-                           get_global_properties().parameters.max_authority_depth);
+      if( !_authority_prechecks->passed( _current_trx_in_block ) )
+         verify_transaction_authority( trx );
+      else if( _authority_self_check )
+      {
+         try
+         {
+            verify_transaction_authority( trx );
+         }
+         catch( const fc::exception& )
+         {
+            elog( "Parallel authority check of transaction ${n} in block ${b} passed, but the serial check failed",
+                  ("n",_current_trx_in_block)("b",_current_block_num) );
+            throw;
+         }
+      }
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -768,6 +976,88 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    return ptrx;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+void database::verify_transaction_authority( const signed_transaction& trx,
+                                             vector<account_id_type>* read_accounts )const
+{
+   bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
+   auto get_active = [this,read_accounts]( account_id_type id ) {
+      if( read_accounts != nullptr )
+         read_accounts->push_back( id );
+      return &id(*this).active;
+   };
+   auto get_owner  = [this,read_accounts]( account_id_type id ) {
+      if( read_accounts != nullptr )
+         read_accounts->push_back( id );
+      return &id(*this).owner;
+   };
+   auto get_custom = [this,read_accounts]( account_id_type id, const operation& op, rejected_predicate_map* rejects ) {
+      if( read_accounts == nullptr )
+         return get_viable_custom_authorities(id, op, rejects);
+      // the predicates are cached in the objects on first use, so they are only evaluated in block order
+      read_accounts->push_back( id );
+      const auto& index = get_index_type<custom_authority_index>().indices().get<by_account_custom>();
+      auto range = index.equal_range( boost::make_tuple( id, unsigned_int( op.which() ), true ) );
+      FC_ASSERT( range.first == range.second, "Custom authorities are only checked in block order" );
+      return vector<authority>();
+   };
+
+   trx.verify_authority(get_chain_id(), get_active, get_owner, get_custom, allow_non_immediate_owner,
+                        MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(head_block_time()),
+                        get_global_properties().parameters.max_authority_depth);
+}
+
+/**
+ * The transactions do not change the state used by the checks, except accounts and custom authorities, so the
+ * result of a check stays valid as long as none of the accounts it read changes, see authority_prechecks.
+ *
+ * The workers read the object database, which only the main thread writes. So the calling thread waits for them
+ * without yielding: an fc wait would let other tasks of the main thread push transactions or blocks meanwhile.
+ */
+void database::precheck_authorities( const signed_block& block, uint32_t skip )
+{
+   const auto& trxs = block.transactions;
+   if( !_parallel_authority_checks || 0 != (skip & skip_transaction_signatures) || trxs.size() <= 1
+         || block.previous != head_block_id() || _authority_prechecks->is_for( block.id() ) )
+      return;
+   _authority_prechecks->start( block.id(), trxs.size() );
+
+   const size_t chunks = fc::asio::default_io_service_scope::get_num_threads();
+   const size_t chunk_size = ( trxs.size() + chunks - 1 ) / chunks;
+   std::vector<std::future<void>> workers;
+   workers.reserve( chunks );
+   for( size_t base = 0; base < trxs.size(); base += chunk_size )
+   {
+      auto done = std::make_shared<std::promise<void>>();
+      workers.push_back( done->get_future() );
+      fc::do_parallel( [this,&trxs,base,chunk_size,done] () {
+         const size_t end = std::min( base + chunk_size, trxs.size() );
+         for( size_t i = base; i < end; ++i )
+         {
+            vector<account_id_type> accounts;
+            bool passed = true;
+            try
+            {
+               verify_transaction_authority( trxs[i], &accounts );
+            }
+            catch( ... )
+            {
+               passed = false;
+            }
+            _authority_prechecks->set_result( i, passed, std::move( accounts ) );
+         }
+         done->set_value();
+      });
+   }
+   for( auto& worker : workers )
+      worker.wait();
+}
+
+void database::set_parallel_authority_checks( bool enabled, bool self_check )
+{
+   _parallel_authority_checks = enabled;
+   _authority_self_check = self_check;
+}
+
 operation_result database::apply_operation( transaction_evaluation_state& eval_state, const operation& op,
                                             bool is_virtual /* = true */ )
 { try {
@@ -829,6 +1119,10 @@ bool database::before_last_checkpoint()const
 static const uint32_t skip_expensive = database::skip_transaction_signatures | database::skip_witness_signature
                                        | database::skip_merkle_check | database::skip_transaction_dupe_check;
 
+/// The merkle digests of block transactions are cached, so the merkle root only has to hash the tree
+static void precompute_merkle_digest( const processed_transaction& trx ) { trx.merkle_digest(); }
+static void precompute_merkle_digest( const precomputable_transaction& ) {}
+
 template<typename Trx>
 void database::_precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const
 {
@@ -841,6 +1135,8 @@ void database::_precompute_parallel( const Trx* trx, const size_t count, const u
          trx->id();
       if( 0 == (skip&skip_transaction_signatures) )
          trx->get_signature_keys( get_chain_id() );
+      if( 0 == (skip&skip_merkle_check) )
+         precompute_merkle_digest( *trx );
    }
 }
 
@@ -867,20 +1163,28 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
 
    if( 0 == (skip&skip_witness_signature) )
       workers.push_back( fc::do_parallel( [&block] () { block.signee(); } ) );
-   if( 0 == (skip&skip_merkle_check) )
-      block.calculate_merkle_root();
    block.id();
 
-   if( workers.empty() )
-      return fc::future< void >( fc::promise< void >::create( true ) );
+   for( auto& worker : workers )
+      worker.wait();
+   // the workers computed the merkle digests of the transactions
+   if( 0 == (skip&skip_merkle_check) )
+      block.calculate_merkle_root();
 
-   auto first = workers.begin();
-   auto worker = first;
-   while( ++worker != workers.end() )
-      worker->wait();
-   return *first;
+   return fc::future< void >( fc::promise< void >::create( true ) );
 } FC_LOG_AND_RETHROW() }
 
+void database::_precompute_block( const signed_block& block, const uint32_t skip )const
+{
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( 0 == (skip&skip_witness_signature) )
+      block.signee();
+   if( 0 == (skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+}
+
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
    return fc::do_parallel([this,&trx] () {
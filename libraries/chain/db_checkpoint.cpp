@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/global_property_object.hpp>
+
+#include <fc/io/fstream.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/*
+ * State checkpoints bound the replay after an unclean shutdown.
+ *
+ * Every state_checkpoint_interval irreversible blocks, the complete object state at the last irreversible
+ * block is written to checkpoints/<block number>: the reversible blocks are rewound in the written copy by
+ * means of the undo states, because their undo history is not part of a checkpoint. On POSIX systems the
+ * writer is a forked child process, so the node keeps applying blocks while the child serializes its
+ * copy-on-write image of the indexes. The files are opened before the fork, the child only writes them.
+ * A checkpoint is written into a .tmp directory and renamed when complete, so every directory with a
+ * plain number as name is a consistent state.
+ *
+ * While the database is open, the file open_state_head contains the head block number of the state
+ * in the object_database directory. It is removed by a clean close(), so if it exists on open(), the
+ * node was killed and the newest checkpoint which is newer than that state and whose head block is
+ * still part of the block log is loaded instead, and only the blocks after it are replayed.
+ */
+
+namespace graphene { namespace chain {
+
+namespace {
+
+/// @return block numbers of the complete checkpoints in @p dir in ascending order
+std::vector<uint32_t> list_state_checkpoints( const fc::path& dir )
+{
+   std::vector<uint32_t> result;
+   if( !fc::exists( dir ) )
+      return result;
+   for( fc::directory_iterator itr( dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const std::string name = (*itr).filename().generic_string();
+      if( !name.empty() && std::all_of( name.begin(), name.end(), []( char c ) { return c >= '0' && c <= '9'; } ) )
+         result.push_back( std::stoul( name ) );
+   }
+   std::sort( result.begin(), result.end() );
+   return result;
+}
+
+void write_string_file( const fc::path& file, const std::string& content )
+{
+   std::ofstream out( file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+   out.write( content.c_str(), content.size() );
+   FC_ASSERT( out.flush(), "Failed to write ${f}", ("f", file) );
+}
+
+} // anonymous namespace
+
+void database::set_state_checkpoints( uint32_t interval, uint32_t checkpoints_to_keep )
+{
+   _state_checkpoint_interval = interval;
+   _state_checkpoints_to_keep = std::max<uint32_t>( checkpoints_to_keep, 1 );
+}
+
+bool database::open_state_checkpoint( const fc::path& data_dir )
+{ try {
+   _state_checkpoint_dir = data_dir / "checkpoints";
+   const auto head_file = data_dir / "open_state_head";
+   if( !fc::exists( head_file ) )
+      return false;
+
+   std::string content;
+   fc::read_file_contents( head_file, content );
+   const uint32_t state_head = content.empty() ? 0 : std::stoul( content );
+   wlog( "The database was not closed cleanly, the object database is at block ${n}", ("n", state_head) );
+
+   auto checkpoints = list_state_checkpoints( _state_checkpoint_dir );
+   for( auto itr = checkpoints.rbegin(); itr != checkpoints.rend() && *itr > state_head; ++itr )
+   {
+      const auto dir = _state_checkpoint_dir / fc::to_string( *itr );
+      if( !fc::exists( dir / "head_block_id" ) )
+         continue;
+      fc::read_file_contents( dir / "head_block_id", content );
+      const block_id_type head_id( content );
+      if( !_block_id_to_block.contains( head_id ) )
+      {
+         wlog( "Skipping state checkpoint at block ${n}, its head block is not in the block log", ("n", *itr) );
+         continue;
+      }
+      ilog( "Loading state checkpoint at block ${n}", ("n", *itr) );
+      object_database::open_checkpoint( data_dir, dir );
+      return true;
+   }
+   return false;
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+void database::write_state_head_file( const fc::path& data_dir )
+{
+   if( _state_checkpoint_interval == 0 )
+      return;
+   const auto* dgp = find( dynamic_global_property_id_type() );
+   write_string_file( data_dir / "open_state_head", fc::to_string( dgp ? dgp->head_block_number : 0 ) );
+}
+
+void database::remove_state_head_file( const fc::path& data_dir )
+{
+   fc::remove_all( data_dir / "open_state_head" );
+}
+
+void database::write_state_checkpoint()
+{
+   if( _state_checkpoint_interval == 0 )
+      return;
+   finish_state_checkpoint( false );
+
+   const uint32_t lib = get_dynamic_global_properties().last_irreversible_block_num;
+   if( lib / _state_checkpoint_interval <= _last_state_checkpoint_lib / _state_checkpoint_interval )
+      return;
+   if( _state_checkpoint_writer != 0 ) // the previous checkpoint is still being written, retry on next block
+      return;
+   // The undo states of the reversible blocks are not saved, so like close(), the checkpoint contains the state
+   // at the last irreversible block, as far as the undo history reaches. During a catch-up batch the undo states
+   // do not match the blocks, retry after it.
+   if( _undo_db.active_sessions() > 0 )
+      return;
+   _last_state_checkpoint_lib = lib;
+
+   try
+   {
+      const uint32_t rewind = std::min<uint32_t>( head_block_num() - lib, _undo_db.size() );
+      const uint32_t checkpoint_num = head_block_num() - rewind;
+      const auto dir = _state_checkpoint_dir / fc::to_string( checkpoint_num );
+      const auto tmp_dir = _state_checkpoint_dir / ( fc::to_string( checkpoint_num ) + ".tmp" );
+      if( fc::exists( dir ) )
+         return;
+      if( fc::exists( tmp_dir ) )
+         fc::remove_all( tmp_dir );
+      fc::create_directories( tmp_dir );
+      write_string_file( tmp_dir / "head_block_id", get_block_id_for_num( checkpoint_num ).str() );
+
+      const auto start = fc::time_point::now();
+      auto checkpoint = object_database::prepare_checkpoint( tmp_dir, rewind );
+#ifdef _WIN32
+      // no fork(), write the checkpoint in place
+      const bool written = object_database::write_checkpoint( *checkpoint );
+      checkpoint.reset();
+      FC_ASSERT( written, "Failed to write ${d}", ("d", tmp_dir) );
+      fc::rename( tmp_dir, dir );
+      ilog( "Wrote state checkpoint at block ${n} in ${t} ms",
+            ("n", checkpoint_num)("t", (fc::time_point::now() - start).count() / 1000) );
+      prune_state_checkpoints();
+#else
+      const std::string tmp_name = tmp_dir.generic_string();
+      const std::string dir_name = dir.generic_string();
+      const pid_t pid = ::fork();
+      if( pid == 0 )
+      {
+         // Child process: only the forking thread exists here, and the other threads may have held locks, e.g.
+         // of the heap. So the files and buffers were prepared before the fork, and only write(), fsync(),
+         // rename() and _exit() are called: no allocation, no logging, no exceptions and no destructors.
+         const bool written = object_database::write_checkpoint( *checkpoint )
+                              && ::rename( tmp_name.c_str(), dir_name.c_str() ) == 0;
+         ::_exit( written ? 0 : 1 );
+      }
+      checkpoint.reset(); // the child has its own copies of the files
+      if( pid < 0 )
+      {
+         wlog( "Failed to fork the state checkpoint writer, errno ${e}", ("e", errno) );
+         fc::remove_all( tmp_dir );
+         return;
+      }
+      _state_checkpoint_writer = pid;
+      ilog( "Writing state checkpoint at block ${n} in process ${p}, forked in ${t} ms",
+            ("n", checkpoint_num)("p", pid)("t", (fc::time_point::now() - start).count() / 1000) );
+#endif
+   }
+   catch( const fc::exception& e )
+   {
+      // the block is applied already, a missing checkpoint only means a longer replay after a crash
+      elog( "Failed to write state checkpoint: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
+void database::finish_state_checkpoint( bool wait )
+{
+#ifndef _WIN32
+   if( _state_checkpoint_writer == 0 )
+      return;
+   int status = 0;
+   const pid_t result = ::waitpid( _state_checkpoint_writer, &status, wait ? 0 : WNOHANG );
+   if( result == 0 ) // still running
+      return;
+   _state_checkpoint_writer = 0;
+   if( result < 0 || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+   {
+      wlog( "Failed to write state checkpoint, status ${s}", ("s", status) );
+      return;
+   }
+   ilog( "Done writing state checkpoint" );
+   prune_state_checkpoints();
+#endif
+}
+
+void database::prune_state_checkpoints()
+{
+   auto checkpoints = list_state_checkpoints( _state_checkpoint_dir );
+   for( size_t i = 0; i + _state_checkpoints_to_keep < checkpoints.size(); ++i )
+      fc::remove_all( _state_checkpoint_dir / fc::to_string( checkpoints[i] ) );
+   // no writer is running, so any incomplete checkpoint was left behind by a crash
+   std::vector<fc::path> incomplete;
+   for( fc::directory_iterator itr( _state_checkpoint_dir ); itr != fc::directory_iterator(); ++itr )
+      if( (*itr).extension().generic_string() == ".tmp" )
+         incomplete.push_back( *itr );
+   for( const auto& dir : incomplete )
+      fc::remove_all( dir );
+}
+
+} }
@@ -51,6 +51,8 @@
 #include <graphene/chain/worker_object.hpp>
 #include <graphene/chain/htlc_object.hpp>
 #include <graphene/chain/custom_authority_object.hpp>
+#include <graphene/chain/vote_tally_engine.hpp>
+#include <graphene/chain/authority_prechecks.hpp>
 
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/asset_evaluator.hpp>
@@ -157,7 +159,9 @@ void database::initialize_indexes()
    add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
    add_index< primary_index<force_settlement_index> >();
 
-   add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   auto acnt_idx = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   _vote_tally_engine = acnt_idx->add_secondary_index<vote_tally_engine>();
+   _authority_prechecks = acnt_idx->add_secondary_index<authority_prechecks>();
    add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
    add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
    add_index< primary_index<limit_order_index > >();
@@ -169,7 +173,8 @@ void database::initialize_indexes()
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
    add_index< primary_index< htlc_index> >();
-   add_index< primary_index< custom_authority_index> >();
+   auto cust_auth_idx = add_index< primary_index< custom_authority_index> >();
+   cust_auth_idx->add_secondary_index<authority_prechecks::custom_authority_observer>( _authority_prechecks );
    add_index< primary_index<ticket_index> >();
    add_index< primary_index<liquidity_pool_index> >();
    add_index< primary_index<samet_fund_index> >();
@@ -185,7 +190,8 @@ void database::initialize_indexes()
    add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
+   auto stats_idx = add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
+   stats_idx->add_secondary_index<vote_tally_engine::statistics_observer>( _vote_tally_engine );
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<simple_index<block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 
+#include <fc/asio.hpp>
 #include <fc/uint128.hpp>
 
 #include <graphene/protocol/market.hpp>
@@ -44,6 +45,7 @@
 #include <graphene/chain/ticket_object.hpp>
 #include <graphene/chain/vesting_balance_object.hpp>
 #include <graphene/chain/vote_count.hpp>
+#include <graphene/chain/vote_tally_engine.hpp>
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 #include <graphene/chain/custom_authority_object.hpp>
@@ -74,8 +76,17 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
    return refs;
 }
 
-template<class Type>
-void database::perform_account_maintenance(Type tally_helper)
+void database::set_vote_tally_full_recount_interval( uint32_t tallies )
+{
+   _vote_tally_engine->set_full_recount_interval( tallies );
+}
+
+void database::set_vote_tally_self_check( bool enabled )
+{
+   _vote_tally_engine->set_self_check( enabled );
+}
+
+void database::update_core_in_balances()
 {
    const auto& bal_idx = get_index_type< account_balance_index >().indices().get< by_maintenance_flag >();
    if( bal_idx.begin() != bal_idx.end() )
@@ -96,7 +107,11 @@ void database::perform_account_maintenance(Type tally_helper)
          bal_itr = bal_idx.rbegin();
       }
    }
+}
 
+template<class Type>
+void database::perform_account_maintenance(Type tally_helper)
+{
    const auto& stats_idx = get_index_type< account_stats_index >().indices().get< by_maintenance_seq >();
    auto stats_itr = stats_idx.lower_bound( true );
 
@@ -1170,57 +1185,6 @@ void process_hf_2281( database& db )
 
 namespace detail {
 
-   struct vote_recalc_times
-   {
-      time_point_sec full_power_time;
-      time_point_sec zero_power_time;
-   };
-
-   struct vote_recalc_options
-   {
-      vote_recalc_options( uint32_t f, uint32_t d, uint32_t s )
-      : full_power_seconds(f), recalc_steps(d), seconds_per_step(s)
-      {
-         total_recalc_seconds = ( recalc_steps - 1 ) * seconds_per_step; // should not overflow
-         power_percents_to_subtract.reserve( recalc_steps - 1 );
-         for( uint32_t i = 1; i < recalc_steps; ++i )
-            // should not overflow
-            power_percents_to_subtract.push_back( (uint16_t)( ( GRAPHENE_100_PERCENT * i ) / recalc_steps ) );
-      }
-
-      vote_recalc_times get_vote_recalc_times( const time_point_sec now ) const
-      {
-         return { now - full_power_seconds, now - full_power_seconds - total_recalc_seconds };
-      }
-
-      uint32_t full_power_seconds;
-      uint32_t recalc_steps; // >= 1
-      uint32_t seconds_per_step;
-      uint32_t total_recalc_seconds;
-      vector<uint16_t> power_percents_to_subtract;
-
-      static const vote_recalc_options& witness();
-      static const vote_recalc_options& committee();
-      static const vote_recalc_options& worker();
-      static const vote_recalc_options& delegator();
-
-      // return the stake that is "recalced to X"
-      uint64_t get_recalced_voting_stake( const uint64_t stake, const time_point_sec last_vote_time,
-                                         const vote_recalc_times& recalc_times ) const
-      {
-         if( last_vote_time > recalc_times.full_power_time )
-            return stake;
-         if( last_vote_time <= recalc_times.zero_power_time )
-            return 0;
-         uint32_t diff = recalc_times.full_power_time.sec_since_epoch() - last_vote_time.sec_since_epoch();
-         uint32_t steps_to_subtract_minus_1 = diff / seconds_per_step;
-         fc::uint128_t stake_to_subtract( stake );
-         stake_to_subtract *= power_percents_to_subtract[steps_to_subtract_minus_1];
-         stake_to_subtract /= GRAPHENE_100_PERCENT;
-         return stake - static_cast<uint64_t>(stake_to_subtract);
-      }
-   };
-
    const vote_recalc_options& vote_recalc_options::witness()
    {
       static const vote_recalc_options o( 360*86400, 8, 45*86400 );
@@ -1462,7 +1426,53 @@ void database::perform_chain_maintenance( const signed_block& next_block )
 
    vote_tally_helper tally_helper(*this);
 
-   perform_account_maintenance( tally_helper );
+   update_core_in_balances();
+
+   if( tally_helper.hf2262_passed && _vote_tally_engine != nullptr )
+   {
+      // After hard fork core-2262 the voting stakes do not depend on the fees paid out during the account
+      // maintenance, so all accounts can be tallied at once from the arrays of the tally engine.
+      vote_tally_engine::parameters params;
+      params.now = tally_helper.now;
+      params.count_non_member_votes = gpo.parameters.count_non_member_votes;
+      params.pob_activated = tally_helper.pob_activated;
+      params.maximum_witness_count = gpo.parameters.maximum_witness_count;
+      params.maximum_committee_count = gpo.parameters.maximum_committee_count;
+      params.next_available_vote_id = gpo.next_available_vote_id;
+      params.witness_recalc_times = *tally_helper.witness_recalc_times;
+      params.committee_recalc_times = *tally_helper.committee_recalc_times;
+      params.worker_recalc_times = *tally_helper.worker_recalc_times;
+      params.delegator_recalc_times = *tally_helper.delegator_recalc_times;
+
+      params.last_vote_tally_time = dgpo.last_vote_tally_time;
+
+      auto tally = _vote_tally_engine->update_tally( params,
+                                                     fc::asio::default_io_service_scope::get_num_threads() );
+      _vote_tally_buffer = std::move( tally.vote_tally );
+      _witness_count_histogram_buffer = std::move( tally.witness_count_histogram );
+      _committee_count_histogram_buffer = std::move( tally.committee_count_histogram );
+      _total_voting_stake = tally.total_voting_stake;
+
+      // like the tally helper, every counted opinion account gets the time of this tally, so the voting power
+      // stats of accounts which are not counted anymore stay behind last_vote_tally_time
+      const auto now = tally_helper.now;
+      for( const auto& vp : tally.voting_powers )
+      {
+         modify( account_id_type( vp.opinion_account )( *this ).statistics( *this ),
+                 [&vp,now]( account_statistics_object& update_stats ) {
+            update_stats.vp_all = vp.vp_all;
+            update_stats.vp_active = vp.vp_active;
+            update_stats.vp_committee = vp.vp_committee;
+            update_stats.vp_witness = vp.vp_witness;
+            update_stats.vp_worker = vp.vp_worker;
+            update_stats.vote_tally_time = now;
+         });
+      }
+
+      perform_account_maintenance( []( const account_object&, const account_statistics_object& ) {} );
+   }
+   else
+      perform_account_maintenance( tally_helper );
 
    struct clear_canary {
       explicit clear_canary(vector<uint64_t>& target): target(target){}
@@ -32,12 +32,13 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/thread/parallel.hpp>
 
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <memory>
 
 namespace graphene { namespace chain {
 
@@ -50,8 +51,67 @@ database::database()
 database::~database()
 {
    clear_pending();
+   finish_state_checkpoint( true );
 }
 
+namespace {
+
+/// A block on its way through the replay pipeline
+struct replay_block
+{
+   uint32_t            block_num = 0;
+   size_t              position = 0;    ///< end position in the block log, for progress reporting
+   std::vector<char>   packed;          ///< released once unpacked
+   signed_block        block;
+   bool                unreadable = false; ///< the block could not be unpacked, it is treated as missing
+   uint32_t            skip = 0;
+   int64_t             decode_time = 0; ///< microseconds spent unpacking and precomputing
+};
+
+/// Consecutive blocks read from the block log by one reader task
+struct replay_read_batch
+{
+   uint32_t                                       first_block_num = 0;
+   std::vector< std::shared_ptr<replay_block> >   blocks;
+   bool                                           gap = false; ///< a block is missing, nothing after it was read
+   size_t                                         bytes = 0;
+   int64_t                                        read_time = 0;
+};
+
+/// Moving average of a stage latency in microseconds
+struct replay_latency
+{
+   double value = 0;
+   void add( double sample ) { value = ( value == 0 ) ? sample : value * 0.95 + sample * 0.05; }
+};
+
+/// Work done by each replay stage since the last progress report
+struct replay_stage_stats
+{
+   uint32_t read_blocks = 0;
+   size_t   read_bytes = 0;
+   int64_t  read_time = 0;
+   uint32_t decoded_blocks = 0;
+   int64_t  decode_time = 0;
+   uint32_t applied_blocks = 0;
+   int64_t  apply_time = 0;
+   int64_t  starved_time = 0;
+   fc::time_point since = fc::time_point::now();
+};
+
+} // anonymous namespace
+
+/**
+ * Replays the blocks in the block log which are not contained in the current state.
+ *
+ * Replay is a pipeline of three stages, so that the main thread only applies blocks:
+ *  1. a reader task copies batches of consecutive serialized blocks out of the block log,
+ *  2. one task per block unpacks it and does the precomputations of precompute_parallel(),
+ *     spread over all threads of the default io service,
+ *  3. the main thread applies the blocks in order.
+ * The number of blocks in flight is derived from the observed stage latencies: blocks have to enter the
+ * pipeline early enough to be read and decoded by the time the main thread gets to them.
+ */
 void database::reindex( fc::path data_dir )
 { try {
    auto last_block = _block_id_to_block.last();
@@ -76,56 +136,167 @@ void database::reindex( fc::path data_dir )
    else
       _undo_db.disable();
 
-   uint32_t skip = node_properties().skip_flags;
+   const uint32_t skip = node_properties().skip_flags;
 
    size_t total_block_size = _block_id_to_block.total_block_size();
    const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
-   uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
+   const uint32_t threads = fc::asio::default_io_service_scope::get_num_threads();
+
+   constexpr size_t min_window = 20;
+   constexpr size_t max_window = 4096;
+   size_t window = min_window;
+   uint32_t read_batch_size = 5;
+   replay_latency read_latency;
+   replay_latency decode_latency;
+   replay_latency apply_latency;
+   replay_stage_stats stats;
+
+   std::shared_ptr<replay_read_batch> reading;
+   fc::future<void> read_done;
+   std::deque< std::shared_ptr<replay_block> > undecoded;
+   std::deque< std::pair< std::shared_ptr<replay_block>, fc::future<void> > > decoding;
+
+   uint32_t next_block_num = head_block_num() + 1; // next block to read
+   uint32_t gap_block_num = 0; // first missing or unreadable block, 0 if none
+   uint32_t i = next_block_num; // next block to apply
+
+   auto start_read = [this,&reading,&read_done,&next_block_num,&read_batch_size,last_block_num]() {
+      const uint32_t count = std::min( read_batch_size, last_block_num - next_block_num + 1 );
+      reading = std::make_shared<replay_read_batch>();
+      reading->first_block_num = next_block_num;
+      read_done = fc::do_parallel( [this,batch=reading,count] () {
+         const auto read_start = fc::time_point::now();
+         batch->blocks.reserve( count );
+         for( uint32_t n = 0; n < count; ++n )
+         {
+            auto packed = _block_id_to_block.fetch_packed_by_number( batch->first_block_num + n );
+            if( !packed.valid() )
+            {
+               batch->gap = true;
+               break;
+            }
+            auto item = std::make_shared<replay_block>();
+            item->block_num = batch->first_block_num + n;
+            item->packed = std::move( *packed );
+            item->position = _block_id_to_block.blocks_current_position();
+            batch->bytes += item->packed.size();
+            batch->blocks.push_back( std::move( item ) );
+         }
+         batch->read_time = ( fc::time_point::now() - read_start ).count();
+      } );
+      next_block_num += count;
+   };
+
+   auto start_decode = [this,&decoding,&gpo,skip,&last_block]( std::shared_ptr<replay_block> item ) {
+      // read on this thread, the global properties change while replaying
+      const auto dupe_check_start = last_block->timestamp - gpo.parameters.maximum_time_until_expiration;
+      auto task = fc::do_parallel( [this,item,skip,dupe_check_start] () {
+         const auto decode_start = fc::time_point::now();
+         try
+         {
+            item->block = fc::raw::unpack<signed_block>( item->packed );
+            FC_ASSERT( item->block.block_num() == item->block_num, "Block ${n} is corrupt", ("n", item->block_num) );
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Failed to read block ${n}: ${e}", ("n", item->block_num)("e", e.to_detail_string()) );
+            item->unreadable = true;
+            return;
+         }
+         item->packed = std::vector<char>();
+         // errors of a readable block are errors of the chain, they are thrown
+         item->skip = skip;
+         if( item->block.timestamp >= dupe_check_start )
+            item->skip &= (uint32_t)(~skip_transaction_dupe_check);
+         _precompute_block( item->block, item->skip );
+         item->decode_time = ( fc::time_point::now() - decode_start ).count();
+      } );
+      decoding.emplace_back( std::move( item ), std::move( task ) );
+   };
+
+   auto collect_read = [&]() {
+      read_done.wait();
+      read_done = fc::future<void>();
+      read_latency.add( reading->read_time );
+      stats.read_blocks += reading->blocks.size();
+      stats.read_bytes += reading->bytes;
+      stats.read_time += reading->read_time;
+      for( auto& item : reading->blocks )
+         undecoded.push_back( std::move( item ) );
+      if( reading->gap )
+      {
+         gap_block_num = reading->first_block_num + reading->blocks.size();
+         next_block_num = last_block_num + 1; // don't read more blocks
+      }
+      reading.reset();
+   };
+
+   auto wait_for_tasks = [&]() {
+      for( auto& item : decoding )
+      {
+         try { item.second.wait(); } catch( ... ) {}
+      }
+      decoding.clear();
+      if( read_done.valid() )
+      {
+         try { read_done.wait(); } catch( ... ) {}
+         read_done = fc::future<void>();
+      }
+   };
+
+   try
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      while( true )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
+         if( read_done.valid() && read_done.ready() )
+            collect_read();
+         while( !undecoded.empty() && decoding.size() < window )
          {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= (uint32_t)(~skip_transaction_dupe_check);
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
+            start_decode( std::move( undecoded.front() ) );
+            undecoded.pop_front();
          }
-         else
+         if( !read_done.valid() && next_block_num <= last_block_num
+               && decoding.size() + undecoded.size() + read_batch_size <= window )
+            start_read();
+
+         if( decoding.empty() )
          {
-            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-            uint32_t dropped_count = 0;
-            while( true )
+            if( read_done.valid() ) // starving on the reader
             {
-               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-               if( !last_id.valid() )
-                  break;
-               // we've caught up to the gap
-               if( block_header::num_from_id( *last_id ) <= i )
-                  break;
-               _block_id_to_block.remove( *last_id );
-               dropped_count++;
+               const auto wait_start = fc::time_point::now();
+               collect_read();
+               stats.starved_time += ( fc::time_point::now() - wait_start ).count();
+               continue;
             }
-            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
+            if( !undecoded.empty() )
+               continue;
+            break;
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
+         if( !decoding.front().second.ready() ) // starving on the decoders
+         {
+            const auto wait_start = fc::time_point::now();
+            try { decoding.front().second.wait(); } catch( ... ) {}
+            stats.starved_time += ( fc::time_point::now() - wait_start ).count();
+         }
+         const std::shared_ptr<replay_block> item = decoding.front().first;
+         decoding.front().second.wait();
+         decoding.pop_front();
+         if( item->unreadable )
+         {
+            gap_block_num = i;
+            break;
+         }
+         decode_latency.add( item->decode_time );
+         ++stats.decoded_blocks;
+         stats.decode_time += item->decode_time;
+
+         const signed_block& block = item->block;
          if( i % 10000 == 0 )
          {
             std::stringstream bysize;
             std::stringstream bynum;
-            size_t current_pos = std::get<0>(blocks.front());
+            size_t current_pos = item->position;
             if( current_pos > total_block_size )
                total_block_size = current_pos;
             bysize << std::fixed << std::setprecision(5) << double(current_pos) / total_block_size * 100;
@@ -139,6 +310,24 @@ void database::reindex( fc::path data_dir )
                ("i", i)
                ("last", last_block_num)
             );
+
+            const double elapsed = std::max<int64_t>( ( fc::time_point::now() - stats.since ).count(), 1 );
+            auto per_second = []( uint64_t count, int64_t usec ) {
+               return usec > 0 ? uint64_t( count * 1000000.0 / usec ) : 0;
+            };
+            ilog(
+               "   [read: ${rb} blocks/s ${rk} KiB/s]   [decode: ${db} blocks/s in ${t} threads]   "
+               "[apply: ${ab} blocks/s, ${ap} blocks/s overall, waiting ${w}%]   [window: ${win} blocks]",
+               ("rb", per_second( stats.read_blocks, stats.read_time ))
+               ("rk", per_second( stats.read_bytes / 1024, stats.read_time ))
+               ("db", per_second( stats.decoded_blocks, stats.decode_time ) * threads)
+               ("t", threads)
+               ("ab", per_second( stats.applied_blocks, stats.apply_time ))
+               ("ap", uint64_t( stats.applied_blocks * 1000000.0 / elapsed ))
+               ("w", int64_t( stats.starved_time * 100 / elapsed ))
+               ("win", window)
+            );
+            stats = replay_stage_stats();
          }
          if( i == undo_point )
          {
@@ -146,18 +335,59 @@ void database::reindex( fc::path data_dir )
             flush();
             ilog( "Done writing object database to disk" );
          }
+         const auto apply_start = fc::time_point::now();
          if( i < undo_point )
-            apply_block( block, skip );
+         {
+            apply_block( block, item->skip );
+            write_state_checkpoint();
+         }
          else
          {
             _undo_db.enable();
-            push_block( block, skip );
+            push_block( block, item->skip );
          }
-         blocks.pop();
+         const int64_t apply_time = ( fc::time_point::now() - apply_start ).count();
+         apply_latency.add( apply_time );
+         ++stats.applied_blocks;
+         stats.apply_time += apply_time;
          i++;
+
+         // Blocks must be read and decoded while the blocks before them are applied. Keep a safety
+         // margin of two, and keep every decoding thread busy.
+         const double lead_time = read_latency.value + decode_latency.value;
+         const size_t wanted = threads + size_t( 2 * lead_time / std::max( apply_latency.value, 1.0 ) );
+         window = std::min( max_window, std::max( min_window, wanted ) );
+         read_batch_size = std::max<uint32_t>( 1, window / 4 );
+      }
+   }
+   catch( ... )
+   {
+      wait_for_tasks();
+      throw;
+   }
+   wait_for_tasks();
+
+   if( gap_block_num != 0 )
+   {
+      wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", gap_block_num) );
+      uint32_t dropped_count = 0;
+      while( true )
+      {
+         fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+         // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+         if( !last_id.valid() )
+            break;
+         // we've caught up to the gap
+         if( block_header::num_from_id( *last_id ) < gap_block_num )
+            break;
+         _block_id_to_block.remove( *last_id );
+         dropped_count++;
       }
+      wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
    }
+
    _undo_db.enable();
+   _block_id_to_block.archive_blocks( get_dynamic_global_properties().last_irreversible_block_num );
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
@@ -169,6 +399,8 @@ void database::wipe(const fc::path& data_dir, bool include_blocks)
      close();
    }
    object_database::wipe(data_dir);
+   fc::remove_all( data_dir / "checkpoints" );
+   remove_state_head_file( data_dir );
    if( include_blocks )
       fc::remove_all( data_dir / "database" );
 }
@@ -192,16 +424,21 @@ void database::open(
       if( wipe_object_db ) {
           ilog("Wiping object_database due to missing or wrong version");
           object_database::wipe( data_dir );
+          fc::remove_all( data_dir / "checkpoints" );
           std::ofstream version_file( (data_dir / "db_version").generic_string().c_str(),
                                       std::ios::out | std::ios::binary | std::ios::trunc );
           version_file.write( db_version.c_str(), db_version.size() );
           version_file.close();
       }
 
-      object_database::open(data_dir);
-
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
 
+      if( !open_state_checkpoint( data_dir ) )
+      {
+         object_database::open(data_dir);
+         write_state_head_file( data_dir );
+      }
+
       if( !find(global_property_id_type()) )
          init_genesis(genesis_loader());
       else
@@ -213,6 +450,7 @@ void database::open(
          _p_dyn_global_prop_obj = &get( dynamic_global_property_id_type() );
          _p_witness_schedule_obj = &get( witness_schedule_id_type() );
       }
+      _last_state_checkpoint_lib = get_dynamic_global_properties().last_irreversible_block_num;
 
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
       if( last_block.valid() )
@@ -234,6 +472,7 @@ void database::close(bool rewind)
       
    // TODO:  Save pending tx's on close()
    clear_pending();
+   finish_catch_up_batch();
 
    // pop all of the blocks that we can given our undo history, this should
    // throw when there is no more undo history to pop
@@ -262,9 +501,15 @@ void database::close(bool rewind)
    // DB state (issue #336).
    clear_pending();
 
+   finish_state_checkpoint( true );
+
    ilog( "Writing object database to disk at block ${i}, please DO NOT kill the program", ("i", head_block_num()) );
-   object_database::flush();
+   if( delta_flush_enabled() )
+      object_database::flush_delta();
+   else
+      object_database::flush();
    ilog( "Done writing object database to disk" );
+   remove_state_head_file( _state_checkpoint_dir.parent_path() );
 
    object_database::close();
 
@@ -579,7 +579,8 @@ void database::notify_on_pending_transaction( const signed_transaction& tx )
 
 void database::notify_changed_objects()
 { try {
-   if( _undo_db.enabled() )
+   // the undo state of a trusted catch-up batch spans many blocks, its changes are not reported like in a replay
+   if( _undo_db.enabled() && !_catch_up_session.valid() )
    {
       const auto& head_undo = _undo_db.head();
       auto chain_time = head_block_time();
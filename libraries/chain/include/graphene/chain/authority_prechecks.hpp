@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/types.hpp>
+#include <graphene/db/index.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief Results of the authority checks of the transactions of a block, done in parallel before the block
+    *  is applied
+    *
+    *  The authorities are verified against the state of the head block the block builds on, and the accounts read
+    *  by each check are recorded. From then on, including while the pending transactions are popped and the
+    *  transactions of the block are applied, this index observes the changes of the accounts, and
+    *  @ref custom_authority_observer the changes of the custom authorities. A precheck is only used if it passed
+    *  and no account it read was changed by an earlier transaction of the block, otherwise the authority is
+    *  verified again in block order. So the outcome, including the reported error, is the one of serial checks.
+    *
+    *  This is a secondary index of the account index.
+    */
+   class authority_prechecks : public secondary_index
+   {
+      public:
+         /// Forwards the changes of the custom authority index to the prechecks
+         class custom_authority_observer : public secondary_index
+         {
+            public:
+               explicit custom_authority_observer( authority_prechecks* prechecks ) : _prechecks( prechecks ) {}
+
+               virtual void object_inserted( const object& obj ) override;
+               virtual void object_removed( const object& obj ) override;
+               virtual void object_modified( const object& after ) override;
+
+            private:
+               authority_prechecks* _prechecks;
+         };
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after ) override;
+
+         /// Drops the previous results and starts observing changes for the block @p block_id of @p trx_count
+         /// transactions
+         void start( const block_id_type& block_id, size_t trx_count );
+         /// @return true if the results are for the block @p block_id
+         bool is_for( const block_id_type& block_id )const { return _active && _block_id == block_id; }
+         /// Drops the results and stops observing changes
+         void clear();
+
+         /// Records the precheck of one transaction, may be called concurrently for different transactions
+         void set_result( size_t trx_in_block, bool passed, vector<account_id_type>&& accounts );
+         /// @return true if the transaction passed its precheck and none of the accounts read by it changed since
+         bool passed( size_t trx_in_block )const;
+
+      private:
+         void changed( account_id_type account );
+
+         struct result
+         {
+            bool                       passed = false;
+            vector<account_id_type>    accounts;
+         };
+
+         block_id_type                 _block_id;
+         vector<result>                _results;
+         flat_set<account_id_type>     _changed;
+         bool                          _active = false;
+   };
+
+} } // graphene::chain
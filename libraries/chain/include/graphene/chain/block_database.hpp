@@ -23,6 +23,11 @@
  */
 #pragma once
 #include <fstream>
+#include <atomic>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <graphene/protocol/block.hpp>
 
 #include <fc/filesystem.hpp>
@@ -31,6 +36,22 @@ namespace graphene { namespace chain {
    struct index_entry;
    using namespace graphene::protocol;
 
+   /**
+    *  @class block_database
+    *  @brief append-only log of blocks with a fixed-width index by block number
+    *
+    *  Writes go through the file streams, reads go through read-only memory mappings of the
+    *  @c index and @c blocks files. The mappings are replaced as a whole once the files grew by
+    *  @c remap_threshold bytes past them, reads of the data written since go through separate read
+    *  streams. So the read-only methods only need a snapshot of the current mapping and can be called
+    *  from any thread while the main thread keeps storing blocks.
+    *
+    *  Optionally, irreversible blocks are moved into an archive tier: chunks of a fixed number of
+    *  consecutive blocks compressed with zlib and stored in the @c archive file, located through a
+    *  fixed-width chunk table in @c archive_index. Once most of the @c blocks file is only used by
+    *  archived blocks, its head is cut off and @ref _blocks_base records the logical position of
+    *  its first byte, so index entries never have to be rewritten.
+    */
    class block_database 
    {
       public:
@@ -46,14 +67,85 @@ namespace graphene { namespace chain {
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /// The serialized block with the given number, for callers which deserialize blocks themselves
+         optional< std::vector<char> > fetch_packed_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
          size_t                 blocks_current_position()const;
          size_t                 total_block_size()const;
+
+         /**
+          * Set the number of blocks per chunk of the archive tier, 0 disables archiving.
+          * Takes effect on the next open(). The chunk size of an existing archive can not be changed.
+          */
+         void     set_archive_chunk_size( uint32_t chunk_size ) { _desired_archive_chunk_size = chunk_size; }
+         uint32_t archive_chunk_size()const { return _archive_chunk_size; }
+         uint32_t archived_chunk_count()const;
+
+         /**
+          * Move up to @p max_chunks complete chunks of blocks up to and including @p last_irreversible_block_num
+          * into the archive, then reclaim the space in the blocks file if enough of it became unused.
+          * Does nothing if archiving is disabled.
+          * @return true if more chunks are ready to be archived
+          */
+         bool     archive_blocks( uint32_t last_irreversible_block_num,
+                                  uint32_t max_chunks = std::numeric_limits<uint32_t>::max() );
       private:
-         optional<index_entry> last_index_entry()const;
+         struct mapped_view;
+         struct archived_chunk;
+
+         optional<index_entry>  last_index_entry()const;
+         optional<index_entry>  read_index_entry( const mapped_view& view, uint32_t block_num )const;
+         optional<signed_block> read_block( const mapped_view& view, const index_entry& e )const;
+         optional<signed_block> read_archived_block( const mapped_view& view, const index_entry& e )const;
+         /// Copies the serialized block into @p data, @return false if it is not stored
+         bool                   read_packed_block( const mapped_view& view, const index_entry& e,
+                                                   std::vector<char>& data )const;
+         std::shared_ptr<const archived_chunk> load_chunk( const mapped_view& view, uint32_t chunk )const;
+         /// Reads data written past the mappings, @return false if it is not in the files
+         bool                   read_index_tail( uint64_t offset, char* data, size_t size )const;
+         /// @p pos is a logical position, like the block positions in the index
+         bool                   read_blocks_tail( uint64_t pos, char* data, size_t size )const;
+         /// Number of bytes written to the files since the mappings of @p view were made
+         uint64_t               unmapped_bytes( const mapped_view& view )const;
+
+         void open_archive();
+         void write_archive_header( uint32_t flags );
+         void write_archive_chunk( const mapped_view& view, uint32_t chunk );
+         void compact_blocks();
+
+         /// Replaces the current mappings by mappings of the files as they are on disk now, and reopens the
+         /// read streams of the data written after them
+         void                                remap()const;
+         std::shared_ptr<const mapped_view>  current_view()const;
+
          fc::path _index_filename;
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         fc::path _blocks_filename;
+         fc::path _archive_filename;
+         fc::path _archive_index_filename;
+         std::fstream _blocks;
+         std::fstream _block_num_to_pos;
+         std::fstream _archive;
+         std::fstream _archive_index;
+
+         uint32_t _desired_archive_chunk_size = 0;
+         uint32_t _archive_chunk_size = 0;
+         uint64_t _blocks_base = 0;
+
+         mutable std::shared_ptr<const mapped_view> _view;
+         /// Size of the index file and logical end of the blocks file, including the data past the mappings
+         mutable std::atomic<uint64_t>              _index_end { 0 };
+         mutable std::atomic<uint64_t>              _blocks_end { 0 };
+         /// Read streams of the data past the mappings, @ref _tail_blocks_base is the base of @ref _blocks_tail
+         mutable std::mutex                         _tail_mutex;
+         mutable std::ifstream                      _index_tail;
+         mutable std::ifstream                      _blocks_tail;
+         mutable uint64_t                           _tail_blocks_base = 0;
+         /// End position of the last block read, used for progress reporting
+         mutable std::atomic<size_t>                _last_read_position { 0 };
+
+         /// Most recently used decompressed chunks, so that sequential reads decompress each chunk once
+         mutable std::mutex                                                                _chunk_cache_mutex;
+         mutable std::list< std::pair< uint32_t, std::shared_ptr<const archived_chunk> > > _chunk_cache;
    };
 } }
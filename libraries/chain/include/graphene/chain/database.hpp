@@ -41,6 +41,8 @@
 
 #include <fc/log/logger.hpp>
 
+#include <deque>
+#include <limits>
 #include <map>
 
 namespace graphene { namespace protocol { struct predicate_result; } }
@@ -59,6 +61,8 @@ namespace graphene { namespace chain {
    class limit_order_object;
    class collateral_bid_object;
    class call_order_object;
+   class vote_tally_engine;
+   class authority_prechecks;
 
    struct budget_record;
    enum class vesting_balance_type;
@@ -560,9 +564,30 @@ namespace graphene { namespace chain {
       public:
          // It is public because it is used in pending_transactions_restorer in db_with.hpp
          processed_transaction _push_transaction( const precomputable_transaction& trx );
+
+         /**
+          *  When @p lazy is true, push_block() only queues the pending and popped transactions which are still
+          *  candidates, and they are re-applied by restore_pending_transactions(), which push_transaction() and
+          *  validate_transaction() call first. Otherwise push_block() re-applies them right away.
+          */
+         void   set_lazy_pending_restore( bool lazy ) { _lazy_pending_restore = lazy; }
+         /// Re-applies up to @p max_count queued pending transactions, invalid ones are dropped
+         /// @return the number of queued transactions processed
+         size_t restore_pending_transactions( size_t max_count = std::numeric_limits<size_t>::max() );
+         size_t queued_pending_transaction_count()const { return _queued_pending_tx.size(); }
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
 
+         /**
+          *  When @p enabled, the transactions of the next block are collected while transactions are pushed to
+          *  the pending state, with their size and merkle digests. generate_block() then only applies the pending
+          *  transactions again if the candidate does not match them, e.g. after a transaction was too big for the
+          *  block. Block producers enable it to spend less time in their slots.
+          */
+         void   set_candidate_block( bool enabled );
+         /// @return the number of transactions in the candidate block, 0 if it is disabled or out of date
+         size_t candidate_transaction_count()const { return _candidate_valid ? _candidate_tx.size() : 0; }
+
          signed_block generate_block(
             const fc::time_point_sec when,
             witness_id_type witness_id,
@@ -641,6 +666,11 @@ namespace graphene { namespace chain {
           * can be reapplied at the proper time */
          std::deque< precomputable_transaction > _popped_tx;
 
+         /** pending transactions which were not re-applied after the last block yet, in the order in which they
+          * are re-applied, see set_lazy_pending_restore() */
+         std::deque< precomputable_transaction > _queued_pending_tx;
+         bool                                     _lazy_pending_restore = false;
+
          /**
           * @}
           */
@@ -664,9 +694,19 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /**
+          * Verifies the authorities of the transactions of @p block in parallel against the current state, if
+          * parallel authority checks are enabled and the block builds on the head block. Needs the signature keys
+          * of the transactions, so it is called after precompute_parallel(). The results are used when the block
+          * is applied, push_block() does this if it was not done for the block yet.
+          */
+         void precheck_authorities( const signed_block& block, const uint32_t skip = skip_nothing );
       private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         /// Same precomputations as precompute_parallel( block, skip ), but all in the calling thread
+         void _precompute_block( const signed_block& block, const uint32_t skip )const;
 
       protected:
          // Mark pop_undo() as protected -- we do not want outside calling pop_undo(),
@@ -747,10 +787,34 @@ namespace graphene { namespace chain {
 
          template<class Type>
          void perform_account_maintenance( Type tally_helper );
+         /// Copies the core balances changed since the last maintenance to the account statistics
+         void update_core_in_balances();
          ///@}
          ///@}
 
          vector< processed_transaction >        _pending_tx;
+
+         /// @name Candidate block, see set_candidate_block()
+         ///@{
+         /// Adds a transaction which was just added to the pending state to the candidate block
+         void append_candidate_transaction( const processed_transaction& trx );
+         /// Starts an empty candidate block for an empty pending state
+         void reset_candidate_block();
+         /// @return true if the candidate block contains the transactions _generate_block() would include
+         bool candidate_block_usable( uint32_t skip, size_t max_transactions_size )const;
+
+         bool                                   _candidate_block_enabled = false;
+         /// The candidate block contains all transactions of _pending_tx, in the same order
+         bool                                   _candidate_valid = false;
+         /// The transactions without their operation results, as they are included in a block
+         vector< processed_transaction >        _candidate_tx;
+         merkle_accumulator                     _candidate_merkle;
+         /// Packed size of the candidate transactions
+         size_t                                 _candidate_size = 0;
+         /// All skip flags used when the candidate transactions were applied
+         uint32_t                               _candidate_skip = 0;
+         ///@}
+
          fork_database                          _fork_db;
 
          /**
@@ -785,6 +849,8 @@ namespace graphene { namespace chain {
          vector<uint64_t>                  _committee_count_histogram_buffer;
          std::array<uint64_t,2>            _total_voting_stake; // 0=committee, 1=witness,
                                                                 // as in vote_id_type::vote_type
+         /// Secondary index of the account index, owned by the index
+         vote_tally_engine*                _vote_tally_engine = nullptr;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
@@ -821,6 +887,83 @@ namespace graphene { namespace chain {
       public:
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
+         /// Set the number of irreversible blocks per compressed chunk in the block archive, 0 to disable archiving.
+         /// Must be called before @ref open.
+         inline void set_block_archive_chunk_size( uint32_t chunk_size )
+         { _block_id_to_block.set_archive_chunk_size( chunk_size ); }
+         /**
+          * Moves up to @p max_chunks chunks of irreversible blocks into the block archive. This is not done by
+          * push_block(), the node calls it in the background.
+          * @return true if more chunks are ready to be archived
+          */
+         bool archive_irreversible_blocks( uint32_t max_chunks );
+         /// Write a checkpoint of the state every @p interval irreversible blocks and keep the newest
+         /// @p checkpoints_to_keep of them, 0 disables checkpoints. Must be called before @ref open.
+         void set_state_checkpoints( uint32_t interval, uint32_t checkpoints_to_keep );
+      private:
+         /// @name State checkpoints, see db_checkpoint.cpp
+         ///@{
+         /// Loads the newest usable checkpoint if the database was not closed cleanly
+         /// @return true if a checkpoint was loaded
+         bool open_state_checkpoint( const fc::path& data_dir );
+         void write_state_head_file( const fc::path& data_dir );
+         void remove_state_head_file( const fc::path& data_dir );
+         /// Starts writing a checkpoint if the last irreversible block passed the next interval
+         void write_state_checkpoint();
+         /// Reaps the checkpoint writer if it finished, or waits for it if @p wait is true
+         void finish_state_checkpoint( bool wait );
+         void prune_state_checkpoints();
+
+         uint32_t                          _state_checkpoint_interval = 0;
+         uint32_t                          _state_checkpoints_to_keep = 1;
+         uint32_t                          _last_state_checkpoint_lib = 0;
+         fc::path                          _state_checkpoint_dir;
+         /// Process ID of the running checkpoint writer, 0 if none
+         int64_t                           _state_checkpoint_writer = 0;
+         ///@}
+      public:
+         /// Apply blocks older than @p seconds in batches of @p batch_size blocks which share one undo state,
+         /// and drop the undo history of these blocks, 0 disables the trusted catch-up mode.
+         void set_trusted_catch_up( uint32_t seconds, uint32_t batch_size );
+         /// Recount all votes every @p tallies maintenance intervals to check the incremental vote tally,
+         /// 1 to recount at every maintenance, 0 to only recount when required
+         void set_vote_tally_full_recount_interval( uint32_t tallies );
+         /// Compare every incremental vote tally to a full recount and fail the maintenance if they differ,
+         /// enabled by default in debug builds
+         void set_vote_tally_self_check( bool enabled );
+         /// Verify the transaction authorities of a block in parallel before the block is applied, see
+         /// @ref authority_prechecks. With @p self_check every precheck which is used is verified serially too.
+         void set_parallel_authority_checks( bool enabled, bool self_check );
+      private:
+         /// @name Trusted catch-up, see _push_block()
+         ///@{
+         void apply_catch_up_block( const signed_block& new_block, const shared_ptr<fork_item>& new_head,
+                                    uint32_t skip );
+         /// Commits the open catch-up batch and drops the undo history, which can not be popped block by block
+         void finish_catch_up_batch();
+
+         uint32_t                          _trusted_catch_up_age = 0;
+         uint32_t                          _catch_up_batch_size = 1000;
+         /// Undo state of all blocks applied in the current batch
+         optional<undo_database::session>  _catch_up_session;
+         uint32_t                          _catch_up_batch_blocks = 0;
+         /// Blocks applied since the node entered the trusted catch-up mode
+         uint32_t                          _catch_up_blocks = 0;
+         fc::time_point                    _catch_up_start;
+         ///@}
+
+         /// @name Parallel authority checks, see precheck_authorities()
+         ///@{
+         /// Verifies the authorities of @p trx. If @p read_accounts is not null, the accounts read by the check
+         /// are added to it, and the check fails if a custom authority would have to be evaluated.
+         void verify_transaction_authority( const signed_transaction& trx,
+                                            vector<account_id_type>* read_accounts = nullptr )const;
+
+         bool                              _parallel_authority_checks = false;
+         bool                              _authority_self_check = false;
+         /// Secondary index of the account index, owned by the index
+         authority_prechecks*              _authority_prechecks = nullptr;
+         ///@}
    };
 
 } }
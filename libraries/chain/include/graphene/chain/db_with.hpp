@@ -69,39 +69,37 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ),
+        _queued_transactions( std::move(db._queued_pending_tx) )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception& ) { // ignore invalid transactions
-         }
-      }
+      // Queue the popped transactions first, then the ones which were still queued and the pending ones.
+      // Transactions included in the new blocks or expired meanwhile are dropped without evaluating them.
+      const auto now = _db.head_block_time();
+      auto queue = [this,&now]( precomputable_transaction&& tx ) {
+         if( now <= tx.expiration && !_db.is_known_transaction( tx.id() ) )
+            _db._queued_pending_tx.push_back( std::move(tx) );
+      };
+      auto popped = std::move( _db._popped_tx );
       _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& )
-         { // ignore invalid transactions
-         }
-      }
+      for( auto& tx : popped )
+         queue( std::move(tx) );
+      for( auto& tx : _queued_transactions )
+         queue( std::move(tx) );
+      for( auto& tx : _pending_transactions )
+         queue( std::move(tx) );
+
+      if( !_db._lazy_pending_restore )
+         _db.restore_pending_transactions();
    }
 
    database& _db;
    std::vector< processed_transaction > _pending_transactions;
+   std::deque< precomputable_transaction > _queued_transactions;
 };
 
 /**
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/types.hpp>
+#include <graphene/db/index.hpp>
+#include <graphene/protocol/config.hpp>
+#include <graphene/protocol/vote.hpp>
+
+#include <fc/uint128.hpp>
+
+#include <array>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   class account_object;
+   class account_statistics_object;
+
+namespace detail {
+
+   struct vote_recalc_times
+   {
+      time_point_sec full_power_time;
+      time_point_sec zero_power_time;
+   };
+
+   struct vote_recalc_options
+   {
+      vote_recalc_options( uint32_t f, uint32_t d, uint32_t s )
+      : full_power_seconds(f), recalc_steps(d), seconds_per_step(s)
+      {
+         total_recalc_seconds = ( recalc_steps - 1 ) * seconds_per_step; // should not overflow
+         power_percents_to_subtract.reserve( recalc_steps - 1 );
+         for( uint32_t i = 1; i < recalc_steps; ++i )
+            // should not overflow
+            power_percents_to_subtract.push_back( (uint16_t)( ( GRAPHENE_100_PERCENT * i ) / recalc_steps ) );
+      }
+
+      vote_recalc_times get_vote_recalc_times( const time_point_sec now ) const
+      {
+         return { now - full_power_seconds, now - full_power_seconds - total_recalc_seconds };
+      }
+
+      uint32_t full_power_seconds;
+      uint32_t recalc_steps; // >= 1
+      uint32_t seconds_per_step;
+      uint32_t total_recalc_seconds;
+      vector<uint16_t> power_percents_to_subtract;
+
+      static const vote_recalc_options& witness();
+      static const vote_recalc_options& committee();
+      static const vote_recalc_options& worker();
+      static const vote_recalc_options& delegator();
+
+      // return the stake that is "recalced to X"
+      uint64_t get_recalced_voting_stake( const uint64_t stake, const time_point_sec last_vote_time,
+                                         const vote_recalc_times& recalc_times ) const
+      {
+         if( last_vote_time > recalc_times.full_power_time )
+            return stake;
+         if( last_vote_time <= recalc_times.zero_power_time )
+            return 0;
+         uint32_t diff = recalc_times.full_power_time.sec_since_epoch() - last_vote_time.sec_since_epoch();
+         uint32_t steps_to_subtract_minus_1 = diff / seconds_per_step;
+         fc::uint128_t stake_to_subtract( stake );
+         stake_to_subtract *= power_percents_to_subtract[steps_to_subtract_minus_1];
+         stake_to_subtract /= GRAPHENE_100_PERCENT;
+         return stake - static_cast<uint64_t>(stake_to_subtract);
+      }
+   };
+
+} // namespace detail
+
+   /**
+    *  @brief Keeps the inputs and the results of the vote tally in flat arrays, indexed by account instance
+    *
+    *  This is a secondary index of the account index, @ref statistics_observer forwards the changes of the account
+    *  statistics index to it, so the arrays follow every change of the state including undo and reload.
+    *
+    *  The engine remembers the contribution of every counted account to the running totals. When an input of an
+    *  account changes, its contribution and the contributions which use it as opinion account are subtracted
+    *  right away and the accounts are counted again by the next @ref update_tally. Contributions which change
+    *  with time alone, by the vote recalculation steps or an expiring membership, are scheduled for a recount at
+    *  the time of their next change. So a maintenance only counts the changed accounts.
+    *
+    *  A full recount of all accounts in parallel chunks is done at the first tally, after an undone tally, when
+    *  global parameters of the tally changed and periodically as a consistency check of the running totals.
+    *  With @ref set_self_check every tally is checked, and a mismatch is an error instead of being logged.
+    *
+    *  The engine implements the rules after hard fork core-2262 only: before it the stake includes the cashback
+    *  vesting balances which are paid out by the same maintenance, so the tally has to follow the order of
+    *  database::perform_account_maintenance().
+    */
+   class vote_tally_engine : public secondary_index
+   {
+      public:
+         /// Forwards the changes of the account statistics index to the engine
+         class statistics_observer : public secondary_index
+         {
+            public:
+               explicit statistics_observer( vote_tally_engine* engine ) : _engine( engine ) {}
+
+               virtual void object_inserted( const object& obj ) override;
+               virtual void object_removed( const object& obj ) override;
+               virtual void object_modified( const object& after ) override;
+
+            private:
+               vote_tally_engine* _engine;
+         };
+
+         struct parameters
+         {
+            time_point_sec               now;
+            /// The tally time of the last maintenance, to detect an undone tally
+            time_point_sec               last_vote_tally_time;
+            bool                         count_non_member_votes = false;
+            bool                         pob_activated = false;
+            uint16_t                     maximum_witness_count = 0;
+            uint16_t                     maximum_committee_count = 0;
+            uint32_t                     next_available_vote_id = 0;
+            detail::vote_recalc_times    witness_recalc_times;
+            detail::vote_recalc_times    committee_recalc_times;
+            detail::vote_recalc_times    worker_recalc_times;
+            detail::vote_recalc_times    delegator_recalc_times;
+         };
+
+         /// Voting power counted for the account whose opinions are used
+         struct voting_power
+         {
+            uint32_t opinion_account = 0;
+            uint64_t vp_all = 0;
+            uint64_t vp_active = 0;
+            uint64_t vp_committee = 0;
+            uint64_t vp_witness = 0;
+            uint64_t vp_worker = 0;
+         };
+
+         struct result
+         {
+            vector<uint64_t>         vote_tally;
+            vector<uint64_t>         witness_count_histogram;
+            vector<uint64_t>         committee_count_histogram;
+            std::array<uint64_t,2>   total_voting_stake{ { 0, 0 } }; // 0=committee, 1=witness
+            /// Every account with voting power, ascending by account
+            vector<voting_power>     voting_powers;
+         };
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after ) override;
+
+         /// Counts the accounts changed since the last tally, or all accounts in @p chunks parallel ranges
+         result update_tally( const parameters& params, uint32_t chunks );
+
+         /// Recount all accounts every @p tallies tallies, 1 to always recount, 0 to only recount when required
+         void set_full_recount_interval( uint32_t tallies ) { _full_recount_interval = tallies; }
+         /// Compare every incremental tally to a full recount and throw if they differ
+         void set_self_check( bool enabled ) { _self_check = enabled; }
+
+         size_t account_count()const { return _opinion_account.size(); }
+
+      private:
+         /// What an account adds to the running totals
+         struct contribution
+         {
+            uint32_t opinion_account = 0;
+            uint64_t vp_all = 0;
+            uint64_t vp_active = 0;
+            /// Committee stake before the division by the number of committee members voted for
+            uint64_t committee_total = 0;
+            /// Stake added to each vote, as in vote_id_type::vote_type
+            std::array<uint64_t,3> stake{ { 0, 0, 0 } };
+         };
+
+         struct totals
+         {
+            vector<uint64_t>         vote_tally;
+            /// Indexed by num_witness and num_committee, folded into pairs for the result
+            vector<uint64_t>         witness_histogram;
+            vector<uint64_t>         committee_histogram;
+            std::array<uint64_t,2>   total_voting_stake{ { 0, 0 } };
+
+            void add( const contribution& c, const vote_id_type* votes, uint32_t vote_count,
+                      uint16_t num_witness, uint16_t num_committee, bool subtract );
+            bool operator == ( const totals& o )const;
+         };
+
+         void grow( uint32_t instance );
+         void update_account( const account_object& acct );
+         void remove_account( uint32_t instance );
+         void update_statistics( const account_statistics_object& stats );
+         void remove_statistics( uint32_t instance );
+
+         /// @return false if the account is not counted, otherwise its contribution and the time when it changes
+         bool compute( const parameters& params, uint32_t account, contribution& c, uint32_t& recheck_time )const;
+         void count( const parameters& params, uint32_t account );
+         void add_counted( uint32_t account, const contribution& c, uint32_t recheck_time );
+         /// Subtracts the contribution of @p account and schedules it for the next tally
+         void uncount( uint32_t account );
+         /// Uncounts all accounts which use @p opinion_account as opinion account
+         void uncount_opinion( uint32_t opinion_account );
+         void full_recount( const parameters& params, uint32_t chunks );
+         /// Replaces the running totals by a full recount, @return false if they differed from it
+         bool recount_and_compare( const parameters& params, uint32_t chunks );
+         result make_result( const parameters& params )const;
+
+         /// @name Account data
+         ///@{
+         vector<uint32_t>        _opinion_account;       ///< the voting account, or the account itself
+         vector<uint32_t>        _membership_expiration; ///< seconds since epoch
+         vector<uint16_t>        _num_witness;
+         vector<uint16_t>        _num_committee;
+         vector<uint16_t>        _num_committee_voted;
+         vector<uint32_t>        _votes_begin;           ///< offset in _votes
+         vector<uint32_t>        _votes_size;
+         vector<vote_id_type>    _votes;
+         /// Number of entries in _votes which are not referenced anymore
+         size_t                  _unused_votes = 0;
+         ///@}
+
+         /// @name Statistics data, indexed by the owner
+         ///@{
+         vector<uint8_t>         _has_core_voting;
+         vector<int64_t>         _core_in_orders;
+         vector<int64_t>         _core_inactive;
+         vector<int64_t>         _core_pob;
+         vector<int64_t>         _core_pol;
+         vector<int64_t>         _pob_value;
+         vector<int64_t>         _pol_value;
+         vector<uint32_t>        _last_vote_time;        ///< seconds since epoch
+         ///@}
+
+         /// @name Counted contributions, indexed by the stake account
+         ///@{
+         vector<uint8_t>         _counted;
+         vector<uint32_t>        _counted_opinion;
+         vector<uint64_t>        _counted_vp_all;
+         vector<uint64_t>        _counted_vp_active;
+         vector<uint64_t>        _counted_committee_total;
+         vector<uint64_t>        _counted_committee;
+         vector<uint64_t>        _counted_witness;
+         vector<uint64_t>        _counted_worker;
+         /// Time when the contribution changes without any change of the inputs
+         vector<uint32_t>        _recheck_time;
+         /// Counted accounts which use another account as opinion account, by opinion account
+         std::unordered_map< uint32_t, flat_set<uint32_t> >  _counted_delegators;
+         ///@}
+
+         /// @name Sums of the counted contributions, indexed by the opinion account
+         ///@{
+         vector<uint64_t>        _vp_all;
+         vector<uint64_t>        _vp_active;
+         vector<uint64_t>        _vp_committee;
+         vector<uint64_t>        _vp_witness;
+         vector<uint64_t>        _vp_worker;
+         ///@}
+
+         totals                  _totals;
+         /// Accounts to count in the next tally
+         vector<uint32_t>        _dirty;
+         vector<uint8_t>         _is_dirty;
+         /// Min-heap of ( recheck time, account ), entries which do not match _recheck_time are outdated
+         vector< std::pair<uint32_t,uint32_t> > _rechecks;
+
+         /// The running totals are valid, otherwise changes are not tracked until the next full recount
+         bool                    _ready = false;
+         time_point_sec          _last_tally_time;
+         bool                    _last_count_non_member_votes = false;
+         bool                    _last_pob_activated = false;
+         uint32_t                _tallies_since_full_recount = 0;
+         uint32_t                _full_recount_interval = 30;
+#ifdef NDEBUG
+         bool                    _self_check = false;
+#else
+         bool                    _self_check = true;
+#endif
+   };
+
+} } // graphene::chain
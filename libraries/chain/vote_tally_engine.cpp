@@ -0,0 +1,721 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally_engine.hpp>
+
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/thread/parallel.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+const uint32_t never = std::numeric_limits<uint32_t>::max();
+/// Number of possible values of account_options::num_witness and num_committee
+const size_t histogram_size = size_t( std::numeric_limits<uint16_t>::max() ) + 1;
+
+/// @return the first time after @p now when the stake recalculated by @p o for @p last_vote changes
+uint32_t next_recalc_change( const detail::vote_recalc_options& o, uint32_t last_vote, uint32_t now )
+{
+   // full power until last_vote + full_power_seconds, then one step every seconds_per_step until zero
+   const uint64_t first = uint64_t( last_vote ) + o.full_power_seconds;
+   if( now < first )
+      return std::min<uint64_t>( first, never );
+   const uint64_t step = ( now - first ) / o.seconds_per_step + 1;
+   if( step >= o.recalc_steps )
+      return never;
+   return std::min<uint64_t>( first + step * o.seconds_per_step, never );
+}
+
+} // anonymous namespace
+
+void vote_tally_engine::totals::add( const contribution& c, const vote_id_type* votes, uint32_t vote_count,
+                                     uint16_t num_witness, uint16_t num_committee, bool subtract )
+{
+   auto apply = [subtract]( uint64_t& target, uint64_t value ) {
+      if( subtract )
+         target -= value;
+      else
+         target += value;
+   };
+   if( witness_histogram.empty() )
+   {
+      witness_histogram.resize( histogram_size, 0 );
+      committee_histogram.resize( histogram_size, 0 );
+   }
+
+   for( const vote_id_type* vote = votes; vote != votes + vote_count; ++vote )
+   {
+      uint32_t offset = vote->instance();
+      uint32_t type = std::min( vote->type(), vote_id_type::vote_type::worker ); // cap the data
+      if( offset >= vote_tally.size() )
+         vote_tally.resize( offset + 1, 0 );
+      apply( vote_tally[offset], c.stake[type] );
+   }
+
+   // the limits of the chain parameters are applied by make_result()
+   if( c.stake[vote_id_type::witness] > 0 )
+      apply( witness_histogram[num_witness], c.stake[vote_id_type::witness] );
+   if( c.committee_total > 0 )
+      apply( committee_histogram[num_committee], c.committee_total );
+
+   apply( total_voting_stake[vote_id_type::committee], c.committee_total );
+   apply( total_voting_stake[vote_id_type::witness], c.stake[vote_id_type::witness] );
+}
+
+bool vote_tally_engine::totals::operator == ( const totals& o )const
+{
+   auto same = []( const vector<uint64_t>& a, const vector<uint64_t>& b ) {
+      const auto& shorter = a.size() < b.size() ? a : b;
+      const auto& longer = a.size() < b.size() ? b : a;
+      return std::equal( shorter.begin(), shorter.end(), longer.begin() )
+             && std::all_of( longer.begin() + shorter.size(), longer.end(), []( uint64_t v ) { return v == 0; } );
+   };
+   return same( vote_tally, o.vote_tally ) && same( witness_histogram, o.witness_histogram )
+          && same( committee_histogram, o.committee_histogram ) && total_voting_stake == o.total_voting_stake;
+}
+
+void vote_tally_engine::statistics_observer::object_inserted( const object& obj )
+{
+   _engine->update_statistics( static_cast<const account_statistics_object&>( obj ) );
+}
+
+void vote_tally_engine::statistics_observer::object_removed( const object& obj )
+{
+   _engine->remove_statistics( static_cast<const account_statistics_object&>( obj ).owner.instance.value );
+}
+
+void vote_tally_engine::statistics_observer::object_modified( const object& after )
+{
+   _engine->update_statistics( static_cast<const account_statistics_object&>( after ) );
+}
+
+void vote_tally_engine::object_inserted( const object& obj )
+{
+   update_account( static_cast<const account_object&>( obj ) );
+}
+
+void vote_tally_engine::object_removed( const object& obj )
+{
+   remove_account( obj.id.instance() );
+}
+
+void vote_tally_engine::object_modified( const object& after )
+{
+   update_account( static_cast<const account_object&>( after ) );
+}
+
+void vote_tally_engine::grow( uint32_t instance )
+{
+   if( instance < _opinion_account.size() )
+      return;
+   const size_t old_size = _opinion_account.size();
+   const size_t new_size = instance + 1;
+   _opinion_account.resize( new_size );
+   for( size_t i = old_size; i < new_size; ++i )
+      _opinion_account[i] = i;
+   _membership_expiration.resize( new_size, 0 );
+   _num_witness.resize( new_size, 0 );
+   _num_committee.resize( new_size, 0 );
+   _num_committee_voted.resize( new_size, 0 );
+   _votes_begin.resize( new_size, 0 );
+   _votes_size.resize( new_size, 0 );
+
+   _has_core_voting.resize( new_size, 0 );
+   _core_in_orders.resize( new_size, 0 );
+   _core_inactive.resize( new_size, 0 );
+   _core_pob.resize( new_size, 0 );
+   _core_pol.resize( new_size, 0 );
+   _pob_value.resize( new_size, 0 );
+   _pol_value.resize( new_size, 0 );
+   _last_vote_time.resize( new_size, 0 );
+
+   _counted.resize( new_size, 0 );
+   _counted_opinion.resize( new_size, 0 );
+   _counted_vp_all.resize( new_size, 0 );
+   _counted_vp_active.resize( new_size, 0 );
+   _counted_committee_total.resize( new_size, 0 );
+   _counted_committee.resize( new_size, 0 );
+   _counted_witness.resize( new_size, 0 );
+   _counted_worker.resize( new_size, 0 );
+   _recheck_time.resize( new_size, never );
+
+   _vp_all.resize( new_size, 0 );
+   _vp_active.resize( new_size, 0 );
+   _vp_committee.resize( new_size, 0 );
+   _vp_witness.resize( new_size, 0 );
+   _vp_worker.resize( new_size, 0 );
+
+   _is_dirty.resize( new_size, 0 );
+}
+
+void vote_tally_engine::update_account( const account_object& acct )
+{
+   const uint32_t i = acct.id.instance();
+   grow( i );
+   const uint32_t opinion = ( acct.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT )
+                            ? i : acct.options.voting_account.instance.value;
+   const uint32_t expiration = acct.membership_expiration_date.sec_since_epoch();
+   const auto& votes = acct.options.votes;
+
+   if( _opinion_account[i] != opinion || _membership_expiration[i] != expiration )
+      uncount( i );
+   const bool opinion_changed = _num_witness[i] != acct.options.num_witness
+         || _num_committee[i] != acct.options.num_committee
+         || _num_committee_voted[i] != acct.num_committee_voted
+         || _votes_size[i] != votes.size()
+         || !std::equal( votes.begin(), votes.end(), _votes.begin() + _votes_begin[i] );
+   if( opinion_changed )
+      uncount_opinion( i );
+
+   _opinion_account[i] = opinion;
+   _membership_expiration[i] = expiration;
+   if( !opinion_changed )
+      return;
+
+   _num_witness[i] = acct.options.num_witness;
+   _num_committee[i] = acct.options.num_committee;
+   _num_committee_voted[i] = acct.num_committee_voted;
+
+   if( votes.size() > _votes_size[i] )
+   {
+      // does not fit into the old place, append
+      _unused_votes += _votes_size[i];
+      _votes_begin[i] = _votes.size();
+      _votes.insert( _votes.end(), votes.begin(), votes.end() );
+   }
+   else
+   {
+      _unused_votes += _votes_size[i] - votes.size();
+      std::copy( votes.begin(), votes.end(), _votes.begin() + _votes_begin[i] );
+   }
+   _votes_size[i] = votes.size();
+
+   if( _unused_votes > 1024 && _unused_votes > _votes.size() / 2 )
+   {
+      vector<vote_id_type> compacted;
+      compacted.reserve( _votes.size() - _unused_votes );
+      for( size_t a = 0; a < _votes_begin.size(); ++a )
+      {
+         const auto begin = _votes.begin() + _votes_begin[a];
+         _votes_begin[a] = compacted.size();
+         compacted.insert( compacted.end(), begin, begin + _votes_size[a] );
+      }
+      _votes = std::move( compacted );
+      _unused_votes = 0;
+   }
+}
+
+void vote_tally_engine::remove_account( uint32_t instance )
+{
+   if( instance >= _opinion_account.size() )
+      return;
+   uncount( instance );
+   uncount_opinion( instance );
+   _opinion_account[instance] = instance;
+   _membership_expiration[instance] = 0;
+   _num_witness[instance] = 0;
+   _num_committee[instance] = 0;
+   _num_committee_voted[instance] = 0;
+   _unused_votes += _votes_size[instance];
+   _votes_size[instance] = 0;
+}
+
+void vote_tally_engine::update_statistics( const account_statistics_object& stats )
+{
+   const uint32_t i = stats.owner.instance.value;
+   grow( i );
+   const uint8_t has_core_voting = stats.has_some_core_voting();
+   const uint32_t last_vote_time = stats.last_vote_time.sec_since_epoch();
+   // most changes of the statistics, like the operation counters, do not matter here
+   if( _last_vote_time[i] != last_vote_time )
+   {
+      uncount( i );
+      uncount_opinion( i );
+   }
+   else if( _has_core_voting[i] != has_core_voting
+            || _core_in_orders[i] != stats.total_core_in_orders.value
+            || _core_inactive[i] != stats.total_core_inactive.value
+            || _core_pob[i] != stats.total_core_pob.value
+            || _core_pol[i] != stats.total_core_pol.value
+            || _pob_value[i] != stats.total_pob_value.value
+            || _pol_value[i] != stats.total_pol_value.value )
+      uncount( i );
+   else
+      return;
+
+   _has_core_voting[i] = has_core_voting;
+   _core_in_orders[i] = stats.total_core_in_orders.value;
+   _core_inactive[i] = stats.total_core_inactive.value;
+   _core_pob[i] = stats.total_core_pob.value;
+   _core_pol[i] = stats.total_core_pol.value;
+   _pob_value[i] = stats.total_pob_value.value;
+   _pol_value[i] = stats.total_pol_value.value;
+   _last_vote_time[i] = last_vote_time;
+}
+
+void vote_tally_engine::remove_statistics( uint32_t instance )
+{
+   if( instance >= _has_core_voting.size() )
+      return;
+   uncount( instance );
+   uncount_opinion( instance );
+   _has_core_voting[instance] = 0;
+   _last_vote_time[instance] = 0;
+}
+
+bool vote_tally_engine::compute( const parameters& params, uint32_t i, contribution& c,
+                                 uint32_t& recheck_time )const
+{
+   const size_t vid_committee = static_cast<size_t>( vote_id_type::committee ); // 0
+   const size_t vid_witness = static_cast<size_t>( vote_id_type::witness ); // 1
+   const size_t vid_worker = static_cast<size_t>( vote_id_type::worker ); // 2
+   const uint32_t now = params.now.sec_since_epoch();
+
+   recheck_time = never;
+   if( !_has_core_voting[i] )
+      return false;
+   // PoB activation
+   if( params.pob_activated && _core_pob[i] == 0 && _core_inactive[i] == 0 )
+      return false;
+   // account_object::is_member()
+   if( !params.count_non_member_votes )
+   {
+      if( now > _membership_expiration[i] )
+         return false;
+      if( _membership_expiration[i] != never )
+         recheck_time = _membership_expiration[i] + 1;
+   }
+
+   const uint32_t opinion = _opinion_account[i];
+   if( opinion >= _opinion_account.size() )
+      return false;
+   const bool directly_voting = ( opinion == i );
+
+   // see vote_tally_helper in database::perform_chain_maintenance()
+   std::array<uint64_t,3> voting_stake;
+   voting_stake[vid_worker] = params.pob_activated ? 0 : _core_in_orders[i];
+
+   const uint64_t pol_amount = _core_pol[i];
+   const uint64_t pol_value = _pol_value[i];
+   const uint64_t pob_amount = _core_pob[i];
+   const uint64_t pob_value = _pob_value[i];
+   if( 0 == pob_amount )
+   {
+      voting_stake[vid_worker] += pol_value;
+   }
+   else if( 0 == pol_amount ) // and pob_amount > 0
+   {
+      if( pob_amount <= voting_stake[vid_worker] )
+      {
+         voting_stake[vid_worker] += ( pob_value - pob_amount );
+      }
+      else
+      {
+         auto base_value = ( static_cast<fc::uint128_t>( voting_stake[vid_worker] ) * pob_value )
+                           / pob_amount;
+         voting_stake[vid_worker] = static_cast<uint64_t>( base_value );
+      }
+   }
+   else if( pob_amount <= pol_amount ) // pob_amount > 0 && pol_amount > 0
+   {
+      auto base_value = ( static_cast<fc::uint128_t>( pob_value ) * pol_value ) / pol_amount;
+      auto diff_value = ( static_cast<fc::uint128_t>( pob_amount ) * pol_value ) / pol_amount;
+      base_value += ( pol_value - diff_value );
+      voting_stake[vid_worker] += static_cast<uint64_t>( base_value );
+   }
+   else // pob_amount > pol_amount > 0
+   {
+      auto base_value = ( static_cast<fc::uint128_t>( pol_value ) * pob_value ) / pob_amount;
+      fc::uint128_t diff_amount = pob_amount - pol_amount;
+      if( diff_amount <= voting_stake[vid_worker] )
+      {
+         auto diff_value = ( static_cast<fc::uint128_t>( pol_amount ) * pob_value ) / pob_amount;
+         base_value += ( pob_value - diff_value );
+         voting_stake[vid_worker] += static_cast<uint64_t>( base_value - diff_amount );
+      }
+      else // diff_amount > voting_stake[vid_worker]
+      {
+         base_value += ( static_cast<fc::uint128_t>( voting_stake[vid_worker] ) * pob_value ) / pob_amount;
+         voting_stake[vid_worker] = static_cast<uint64_t>( base_value );
+      }
+   }
+
+   if( 0 == voting_stake[vid_worker] )
+      return false;
+
+   const auto& delegator_options = detail::vote_recalc_options::delegator();
+   const auto& witness_options = detail::vote_recalc_options::witness();
+   const auto& committee_options = detail::vote_recalc_options::committee();
+   const auto& worker_options = detail::vote_recalc_options::worker();
+
+   c.opinion_account = opinion;
+   c.vp_all = voting_stake[vid_worker];
+   c.vp_active = voting_stake[vid_worker];
+   if( !directly_voting )
+   {
+      voting_stake[vid_worker] = delegator_options.get_recalced_voting_stake(
+         voting_stake[vid_worker], time_point_sec( _last_vote_time[i] ), params.delegator_recalc_times );
+      c.vp_active = voting_stake[vid_worker];
+      recheck_time = std::min( recheck_time, next_recalc_change( delegator_options, _last_vote_time[i], now ) );
+   }
+   const uint32_t opinion_last_vote = _last_vote_time[opinion];
+   voting_stake[vid_witness] = witness_options.get_recalced_voting_stake(
+      voting_stake[vid_worker], time_point_sec( opinion_last_vote ), params.witness_recalc_times );
+   voting_stake[vid_committee] = committee_options.get_recalced_voting_stake(
+      voting_stake[vid_worker], time_point_sec( opinion_last_vote ), params.committee_recalc_times );
+   c.committee_total = voting_stake[vid_committee];
+   if( _num_committee_voted[opinion] > 1 )
+      voting_stake[vid_committee] /= _num_committee_voted[opinion];
+   voting_stake[vid_worker] = worker_options.get_recalced_voting_stake(
+      voting_stake[vid_worker], time_point_sec( opinion_last_vote ), params.worker_recalc_times );
+   c.stake = voting_stake;
+
+   recheck_time = std::min( { recheck_time,
+                              next_recalc_change( witness_options, opinion_last_vote, now ),
+                              next_recalc_change( committee_options, opinion_last_vote, now ),
+                              next_recalc_change( worker_options, opinion_last_vote, now ) } );
+   return true;
+}
+
+void vote_tally_engine::count( const parameters& params, uint32_t account )
+{
+   contribution c;
+   uint32_t recheck_time;
+   if( compute( params, account, c, recheck_time ) )
+      add_counted( account, c, recheck_time );
+}
+
+void vote_tally_engine::add_counted( uint32_t i, const contribution& c, uint32_t recheck_time )
+{
+   const uint32_t o = c.opinion_account;
+   _counted[i] = 1;
+   _counted_opinion[i] = o;
+   _counted_vp_all[i] = c.vp_all;
+   _counted_vp_active[i] = c.vp_active;
+   _counted_committee_total[i] = c.committee_total;
+   _counted_committee[i] = c.stake[vote_id_type::committee];
+   _counted_witness[i] = c.stake[vote_id_type::witness];
+   _counted_worker[i] = c.stake[vote_id_type::worker];
+   _recheck_time[i] = recheck_time;
+   if( recheck_time != never )
+   {
+      _rechecks.emplace_back( recheck_time, i );
+      std::push_heap( _rechecks.begin(), _rechecks.end(), std::greater< std::pair<uint32_t,uint32_t> >() );
+   }
+
+   _totals.add( c, _votes.data() + _votes_begin[o], _votes_size[o], _num_witness[o], _num_committee[o], false );
+   _vp_all[o] += c.vp_all;
+   _vp_active[o] += c.vp_active;
+   _vp_committee[o] += c.committee_total;
+   _vp_witness[o] += c.stake[vote_id_type::witness];
+   _vp_worker[o] += c.stake[vote_id_type::worker];
+   if( o != i )
+      _counted_delegators[o].insert( i );
+}
+
+void vote_tally_engine::uncount( uint32_t i )
+{
+   if( !_ready )
+      return;
+   if( !_is_dirty[i] )
+   {
+      _is_dirty[i] = 1;
+      _dirty.push_back( i );
+   }
+   if( !_counted[i] )
+      return;
+
+   const uint32_t o = _counted_opinion[i];
+   contribution c;
+   c.opinion_account = o;
+   c.vp_all = _counted_vp_all[i];
+   c.vp_active = _counted_vp_active[i];
+   c.committee_total = _counted_committee_total[i];
+   c.stake[vote_id_type::committee] = _counted_committee[i];
+   c.stake[vote_id_type::witness] = _counted_witness[i];
+   c.stake[vote_id_type::worker] = _counted_worker[i];
+
+   // the opinion data is still the one which was counted, changes of it uncount first
+   _totals.add( c, _votes.data() + _votes_begin[o], _votes_size[o], _num_witness[o], _num_committee[o], true );
+   _vp_all[o] -= c.vp_all;
+   _vp_active[o] -= c.vp_active;
+   _vp_committee[o] -= c.committee_total;
+   _vp_witness[o] -= c.stake[vote_id_type::witness];
+   _vp_worker[o] -= c.stake[vote_id_type::worker];
+   if( o != i )
+   {
+      auto itr = _counted_delegators.find( o );
+      if( itr != _counted_delegators.end() )
+      {
+         itr->second.erase( i );
+         if( itr->second.empty() )
+            _counted_delegators.erase( itr );
+      }
+   }
+   _counted[i] = 0;
+   _recheck_time[i] = never;
+}
+
+void vote_tally_engine::uncount_opinion( uint32_t opinion_account )
+{
+   if( !_ready )
+      return;
+   if( _counted[opinion_account] && _counted_opinion[opinion_account] == opinion_account )
+      uncount( opinion_account );
+   auto itr = _counted_delegators.find( opinion_account );
+   if( itr == _counted_delegators.end() )
+      return;
+   const auto delegators = std::move( itr->second );
+   _counted_delegators.erase( itr );
+   for( uint32_t delegator : delegators )
+      uncount( delegator );
+}
+
+void vote_tally_engine::full_recount( const parameters& params, uint32_t chunks )
+{
+   const uint32_t count = _opinion_account.size();
+
+   _totals = totals();
+   std::fill( _counted.begin(), _counted.end(), 0 );
+   std::fill( _vp_all.begin(), _vp_all.end(), 0 );
+   std::fill( _vp_active.begin(), _vp_active.end(), 0 );
+   std::fill( _vp_committee.begin(), _vp_committee.end(), 0 );
+   std::fill( _vp_witness.begin(), _vp_witness.end(), 0 );
+   std::fill( _vp_worker.begin(), _vp_worker.end(), 0 );
+   std::fill( _is_dirty.begin(), _is_dirty.end(), 0 );
+   _counted_delegators.clear();
+   _dirty.clear();
+   _rechecks.clear();
+
+   // small chunks cost more in scheduling and reduction than they save
+   const uint32_t min_chunk_size = 16 * 1024;
+   chunks = std::max<uint32_t>( 1, std::min<uint32_t>( chunks, count / min_chunk_size ) );
+   const uint32_t chunk_size = ( count + chunks - 1 ) / chunks;
+
+   // every chunk writes the contributions of its own accounts and sums them up in its own totals
+   vector<totals> partial( chunks );
+   auto count_range = [this,&params,&partial]( uint32_t chunk, uint32_t begin, uint32_t end ) {
+      totals& t = partial[chunk];
+      contribution c;
+      for( uint32_t i = begin; i < end; ++i )
+      {
+         uint32_t recheck_time;
+         if( !compute( params, i, c, recheck_time ) )
+         {
+            _recheck_time[i] = never;
+            continue;
+         }
+         const uint32_t o = c.opinion_account;
+         _counted[i] = 1;
+         _counted_opinion[i] = o;
+         _counted_vp_all[i] = c.vp_all;
+         _counted_vp_active[i] = c.vp_active;
+         _counted_committee_total[i] = c.committee_total;
+         _counted_committee[i] = c.stake[vote_id_type::committee];
+         _counted_witness[i] = c.stake[vote_id_type::witness];
+         _counted_worker[i] = c.stake[vote_id_type::worker];
+         _recheck_time[i] = recheck_time;
+         t.add( c, _votes.data() + _votes_begin[o], _votes_size[o], _num_witness[o], _num_committee[o], false );
+      }
+   };
+   if( chunks == 1 )
+      count_range( 0, 0, count );
+   else
+   {
+      vector<fc::future<void>> workers;
+      workers.reserve( chunks );
+      for( uint32_t c = 0; c < chunks; ++c )
+      {
+         const uint32_t begin = c * chunk_size;
+         const uint32_t end = std::min( count, begin + chunk_size );
+         workers.push_back( fc::do_parallel( [&count_range,c,begin,end] () { count_range( c, begin, end ); } ) );
+      }
+      for( auto& worker : workers )
+         worker.wait();
+   }
+
+   // reduce
+   _totals = std::move( partial[0] );
+   for( uint32_t c = 1; c < chunks; ++c )
+   {
+      const auto& t = partial[c];
+      if( _totals.vote_tally.size() < t.vote_tally.size() )
+         _totals.vote_tally.resize( t.vote_tally.size(), 0 );
+      for( size_t i = 0; i < t.vote_tally.size(); ++i )
+         _totals.vote_tally[i] += t.vote_tally[i];
+      if( _totals.witness_histogram.empty() )
+      {
+         _totals.witness_histogram.resize( histogram_size, 0 );
+         _totals.committee_histogram.resize( histogram_size, 0 );
+      }
+      for( size_t i = 0; i < t.witness_histogram.size(); ++i )
+         _totals.witness_histogram[i] += t.witness_histogram[i];
+      for( size_t i = 0; i < t.committee_histogram.size(); ++i )
+         _totals.committee_histogram[i] += t.committee_histogram[i];
+      _totals.total_voting_stake[0] += t.total_voting_stake[0];
+      _totals.total_voting_stake[1] += t.total_voting_stake[1];
+   }
+
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      if( !_counted[i] )
+         continue;
+      const uint32_t o = _counted_opinion[i];
+      _vp_all[o] += _counted_vp_all[i];
+      _vp_active[o] += _counted_vp_active[i];
+      _vp_committee[o] += _counted_committee_total[i];
+      _vp_witness[o] += _counted_witness[i];
+      _vp_worker[o] += _counted_worker[i];
+      if( o != i )
+         _counted_delegators[o].insert( i );
+      if( _recheck_time[i] != never )
+         _rechecks.emplace_back( _recheck_time[i], i );
+   }
+   std::make_heap( _rechecks.begin(), _rechecks.end(), std::greater< std::pair<uint32_t,uint32_t> >() );
+}
+
+bool vote_tally_engine::recount_and_compare( const parameters& params, uint32_t chunks )
+{
+   const totals incremental = _totals;
+   const vector<uint64_t> vp_all = _vp_all;
+   const vector<uint64_t> vp_active = _vp_active;
+   const vector<uint64_t> vp_committee = _vp_committee;
+   const vector<uint64_t> vp_witness = _vp_witness;
+   const vector<uint64_t> vp_worker = _vp_worker;
+   full_recount( params, chunks );
+   return incremental == _totals && vp_all == _vp_all && vp_active == _vp_active
+          && vp_committee == _vp_committee && vp_witness == _vp_witness && vp_worker == _vp_worker;
+}
+
+vote_tally_engine::result vote_tally_engine::make_result( const parameters& params )const
+{
+   result r;
+   r.vote_tally.assign( _totals.vote_tally.begin(),
+                        _totals.vote_tally.begin() + std::min<size_t>( _totals.vote_tally.size(),
+                                                                        params.next_available_vote_id ) );
+   r.vote_tally.resize( params.next_available_vote_id, 0 );
+
+   // votes for a number greater than maximum_witness_count or maximum_committee_count are skipped
+   r.witness_count_histogram.resize( params.maximum_witness_count / 2 + 1, 0 );
+   r.committee_count_histogram.resize( params.maximum_committee_count / 2 + 1, 0 );
+   if( !_totals.witness_histogram.empty() )
+   {
+      for( size_t n = 0; n <= params.maximum_witness_count; ++n )
+         r.witness_count_histogram[ n / 2 ] += _totals.witness_histogram[n];
+      for( size_t n = 0; n <= params.maximum_committee_count; ++n )
+         r.committee_count_histogram[ n / 2 ] += _totals.committee_histogram[n];
+   }
+   r.total_voting_stake = _totals.total_voting_stake;
+
+   // a counted account always has a voting stake, so these are exactly the opinion accounts of counted accounts
+   for( uint32_t o = 0; o < _vp_all.size(); ++o )
+   {
+      if( _vp_all[o] == 0 )
+         continue;
+      voting_power vp;
+      vp.opinion_account = o;
+      vp.vp_all = _vp_all[o];
+      vp.vp_active = _vp_active[o];
+      vp.vp_committee = _vp_committee[o];
+      vp.vp_witness = _vp_witness[o];
+      vp.vp_worker = _vp_worker[o];
+      r.voting_powers.push_back( vp );
+   }
+   return r;
+}
+
+vote_tally_engine::result vote_tally_engine::update_tally( const parameters& params, uint32_t chunks )
+{ try {
+   const uint32_t now = params.now.sec_since_epoch();
+   // the running totals depend on these, and an undone tally left contributions of a state which is gone
+   const bool consistent = _ready && params.last_vote_tally_time == _last_tally_time
+                           && params.count_non_member_votes == _last_count_non_member_votes
+                           && params.pob_activated == _last_pob_activated;
+   const bool periodic = _full_recount_interval > 0
+                         && _tallies_since_full_recount + 1 >= _full_recount_interval;
+
+   if( consistent )
+   {
+      // count the accounts whose contribution changed with time, then all changed accounts
+      const std::greater< std::pair<uint32_t,uint32_t> > later{};
+      while( !_rechecks.empty() && _rechecks.front().first <= now )
+      {
+         const auto entry = _rechecks.front();
+         std::pop_heap( _rechecks.begin(), _rechecks.end(), later );
+         _rechecks.pop_back();
+         if( _recheck_time[entry.second] == entry.first )
+            uncount( entry.second );
+      }
+      for( uint32_t account : _dirty )
+      {
+         _is_dirty[account] = 0;
+         if( !_counted[account] )
+            count( params, account );
+      }
+      _dirty.clear();
+
+      // every account has at most one current entry, drop the outdated ones once they dominate
+      if( _rechecks.size() > 1024 && _rechecks.size() > 2 * _opinion_account.size() )
+      {
+         vector< std::pair<uint32_t,uint32_t> > current;
+         for( const auto& entry : _rechecks )
+            if( _recheck_time[entry.second] == entry.first )
+               current.push_back( entry );
+         _rechecks = std::move( current );
+         std::make_heap( _rechecks.begin(), _rechecks.end(), later );
+      }
+   }
+
+   if( !consistent || periodic || _self_check )
+   {
+      const auto start = fc::time_point::now();
+      if( !consistent )
+         full_recount( params, chunks );
+      else if( !recount_and_compare( params, chunks ) )
+      {
+         FC_ASSERT( !_self_check, "The incremental vote tally differs from the full recount at ${t}",
+                    ("t", params.now) );
+         elog( "The incremental vote tally differs from the full recount at ${t}, using the full recount",
+               ("t", params.now) );
+      }
+      _tallies_since_full_recount = 0;
+      ilog( "Recounted the votes of ${n} accounts in ${t} ms",
+            ("n", _opinion_account.size())("t", (fc::time_point::now() - start).count() / 1000) );
+   }
+   else
+      ++_tallies_since_full_recount;
+
+   _ready = true;
+   _last_tally_time = params.now;
+   _last_count_non_member_votes = params.count_non_member_votes;
+   _last_pob_activated = params.pob_activated;
+
+   return make_result( params );
+} FC_CAPTURE_AND_RETHROW( (params.now)(chunks) ) }
+
+} } // graphene::chain
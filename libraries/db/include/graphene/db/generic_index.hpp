@@ -55,6 +55,16 @@ namespace graphene { namespace db {
             return *insert_result.first;
          }
 
+         /// Inserts an object loaded from disk, with the end as hint since saved objects are in ID order
+         const object& insert_loaded( ObjectType&& obj )
+         {
+            const auto size = _indices.size();
+            auto itr = _indices.insert( _indices.end(), std::move( obj ) );
+            FC_ASSERT( _indices.size() > size,
+                       "Could not insert object, most likely a uniqueness constraint was violated" );
+            return *itr;
+         }
+
          const object&  create(const std::function<void(object&)>& constructor )override
          {
             ObjectType item;
@@ -23,18 +23,68 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/undo_database.hpp>
 
 #include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <stack>
+#include <unordered_set>
 
 namespace graphene { namespace db {
    class object_database;
 
+   /**
+    *  A range of the serialized objects in a saved index file, which can be decoded independently of the
+    *  other ranges. primary_index::save() writes a table of the chunks next to the file.
+    */
+   struct index_chunk
+   {
+      uint64_t offset  = 0; ///< in the file
+      uint64_t size    = 0; ///< in bytes
+      uint32_t objects = 0;
+   };
+
+   /// Number of objects in a chunk of a saved index
+   constexpr uint32_t index_chunk_objects = 16 * 1024;
+
+   /// @return the path of the chunk table of the saved index @p file
+   fc::path index_chunk_table( const fc::path& file );
+   void     write_index_chunks( const fc::path& file, uint64_t file_size, const std::vector<index_chunk>& chunks );
+   /**
+    *  @return the chunks of the objects in @p data, which starts with the objects at @p begin, from the chunk
+    *          table of @p file if it matches the file, otherwise from a scan of the objects
+    */
+   std::vector<index_chunk> read_index_chunks( const fc::path& file, const char* data, size_t size, size_t begin );
+
+   /**
+    *  Buffered writer to a file descriptor which neither allocates nor throws, so it can be used in a forked
+    *  child process, where only async-signal-safe functions may be called. The buffer is owned by the caller.
+    *  Errors are sticky: once a write failed, all further writes fail.
+    */
+   class fd_writer
+   {
+      public:
+         fd_writer( int fd, char* buffer, size_t capacity ) : _fd(fd), _buffer(buffer), _capacity(capacity) {}
+
+         /// @return space for @p size bytes which are written by a later flush(), nullptr on failure
+         char* reserve( size_t size );
+         bool  write( const char* data, size_t size );
+         bool  flush();
+         bool  failed()const { return _failed; }
+
+      private:
+         int    _fd;
+         char*  _buffer;
+         size_t _capacity;
+         size_t _used = 0;
+         bool   _failed = false;
+   };
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -98,6 +148,43 @@ namespace graphene { namespace db {
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
 
+         /**
+          *  Opens the index in parallel: begin_open() maps the file and returns the number of chunks, which
+          *  may be decoded by decode_chunk() on any thread and must be inserted by insert_chunk() in ascending
+          *  order on one thread. end_open() releases the file and returns the number of objects loaded.
+          *  The default implementation loads everything in begin_open().
+          */
+         ///@{
+         virtual size_t begin_open( const fc::path& db ) { open( db ); return 0; }
+         virtual void   decode_chunk( size_t chunk ) {}
+         virtual void   insert_chunk( size_t chunk ) {}
+         virtual size_t end_open() { return 0; }
+         ///@}
+
+         /**
+          *  Objects created, modified or removed since the dirty objects were last cleared can be saved
+          *  as a delta, which is applied on top of the objects loaded by open()
+          */
+         ///@{
+         virtual size_t dirty_object_count()const { return 0; }
+         virtual void   clear_dirty_objects() {}
+         virtual void   save_delta( const fc::path& db ) {}
+         virtual void   open_delta( const fc::path& db ) {}
+         ///@}
+
+         /**
+          *  Saves the index as it was before the undo states from @p first_state on, in the format of save().
+          *  undone_header() is called up front, write_undone_objects() neither allocates nor throws, so it can
+          *  run in a forked child process. The default implementation does not support this and fails.
+          */
+         ///@{
+         virtual std::vector<char> undone_header( const std::deque<undo_state>& states, size_t first_state )const
+         { return {}; }
+         virtual bool write_undone_objects( fd_writer& out, const std::deque<undo_state>& states,
+                                            size_t first_state )const
+         { return false; }
+         ///@}
+
 
 
          /** @return the object with id or nullptr if not found */
@@ -187,8 +274,13 @@ namespace graphene { namespace db {
          }
 
       protected:
+         /** marks obj as changed since the last save, if the database tracks dirty objects */
+         void mark_dirty( const object& obj );
+
          std::vector< std::shared_ptr<index_observer> >   _observers;
          std::vector< std::unique_ptr<secondary_index> >  _sindex;
+         /// IDs of objects created, modified or removed since the last save
+         std::unordered_set< object_id_type >             _dirty_ids;
 
       private:
          object_database& _db;
@@ -347,22 +439,73 @@ namespace graphene { namespace db {
 
          void open( const fc::path& db )override
          {
-            if( !fc::exists( db ) ) return;
-            fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
-            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            const size_t chunks = begin_open( db );
+            for( size_t chunk = 0; chunk < chunks; ++chunk )
+            {
+               decode_chunk( chunk );
+               insert_chunk( chunk );
+            }
+            end_open();
+         }
+
+         size_t begin_open( const fc::path& db )override
+         {
+            _load.reset();
+            if( !fc::exists( db ) ) return 0;
+            auto load = std::make_unique<chunked_load>();
+            load->mapping = std::make_unique<fc::file_mapping>( db.generic_string().c_str(), fc::read_only );
+            load->region = std::make_unique<fc::mapped_region>( *load->mapping, fc::read_only, 0, fc::file_size(db) );
+            const char* data = (const char*)load->region->get_address();
+            const size_t size = load->region->get_size();
+            fc::datastream<const char*> ds( data, size );
             fc::sha256 open_ver;
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
             FC_ASSERT( open_ver == get_object_version(),
                        "Incompatible Version, the serialization of objects in this index has changed" );
-            std::vector<char> tmp;
+            load->data = data;
+            load->chunks = read_index_chunks( db, data, size, ds.pos() - data );
+            load->decoded.resize( load->chunks.size() );
+            _load = std::move( load );
+            return _load->chunks.size();
+         }
+
+         void decode_chunk( size_t chunk )override
+         {
+            const index_chunk& c = _load->chunks[chunk];
+            auto& objects = _load->decoded[chunk];
+            objects.reserve( c.objects );
+            fc::datastream<const char*> ds( _load->data + c.offset, c.size );
             while( ds.remaining() > 0 )
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               fc::unsigned_int size;
+               fc::raw::unpack( ds, size );
+               FC_ASSERT( ds.remaining() >= size.value, "Corrupt object database file" );
+               fc::datastream<const char*> object_ds( ds.pos(), size.value );
+               objects.emplace_back();
+               fc::raw::unpack( object_ds, objects.back() );
+               ds.skip( size.value );
+            }
+         }
+
+         void insert_chunk( size_t chunk )override
+         {
+            auto objects = std::move( _load->decoded[chunk] );
+            for( auto& obj : objects )
+            {
+               const auto& result = insert_loaded<DerivedIndex>( *this, std::move( obj ), 0 );
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
             }
+            _load->objects += objects.size();
+         }
+
+         size_t end_open()override
+         {
+            const size_t objects = _load ? _load->objects : 0;
+            _load.reset();
+            return objects;
          }
 
          void save( const fc::path& db ) override
@@ -373,11 +516,160 @@ namespace graphene { namespace db {
             auto ver  = get_object_version();
             fc::raw::pack( out, _next_id );
             fc::raw::pack( out, ver );
-            this->inspect_all_objects( [&out]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+            std::vector<char> buffer;
+            std::vector<index_chunk> chunks;
+            uint64_t offset = out.tellp();
+            this->inspect_all_objects( [&out,&buffer,&chunks,&offset]( const object& o ) {
+               if( chunks.empty() || chunks.back().objects == index_chunk_objects )
+               {
+                  chunks.emplace_back();
+                  chunks.back().offset = offset;
+               }
+               offset += write_object( out, static_cast<const object_type&>(o), buffer );
+               chunks.back().size = offset - chunks.back().offset;
+               ++chunks.back().objects;
+            });
+            FC_ASSERT( out.flush(), "Failed to write ${f}", ("f", db) );
+            write_index_chunks( db, offset, chunks );
+         }
+
+         size_t dirty_object_count()const override { return _dirty_ids.size(); }
+         void   clear_dirty_objects() override     { _dirty_ids.clear(); }
+
+         /**
+          *  A delta contains the next ID, the object version, the IDs of removed objects and the
+          *  current value of all other dirty objects, in the same format as saved by save()
+          */
+         void save_delta( const fc::path& db ) override
+         {
+            std::vector<object_id_type> removed;
+            std::vector<const object_type*> changed;
+            for( const auto& id : _dirty_ids )
+            {
+               const object* obj = find( id );
+               if( obj != nullptr )
+                  changed.push_back( static_cast<const object_type*>( obj ) );
+               else
+                  removed.push_back( id );
+            }
+            std::sort( removed.begin(), removed.end() );
+            std::sort( changed.begin(), changed.end(), []( const object_type* a, const object_type* b ) {
+               return a->id < b->id;
+            });
+
+            std::ofstream out( db.generic_string(),
+                               std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+            FC_ASSERT( out );
+            fc::raw::pack( out, _next_id );
+            fc::raw::pack( out, get_object_version() );
+            fc::raw::pack( out, removed );
+            std::vector<char> buffer;
+            for( const object_type* obj : changed )
+               write_object( out, *obj, buffer );
+         }
+
+         void open_delta( const fc::path& db ) override
+         {
+            if( !fc::exists( db ) ) return;
+            fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
+            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
+            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            fc::sha256 open_ver;
+
+            fc::raw::unpack(ds, _next_id);
+            fc::raw::unpack(ds, open_ver);
+            FC_ASSERT( open_ver == get_object_version(),
+                       "Incompatible Version, the serialization of objects in this index has changed" );
+            std::vector<object_id_type> removed;
+            fc::raw::unpack( ds, removed );
+            for( const auto& id : removed )
+            {
+               const object* obj = find( id );
+               if( obj == nullptr ) continue;
+               for( const auto& item : _sindex )
+                  item->object_removed( *obj );
+               DerivedIndex::remove( *obj );
+            }
+            std::vector<char> tmp;
+            while( ds.remaining() > 0 )
+            {
+               fc::raw::unpack( ds, tmp );
+               object_type value = fc::raw::unpack<object_type>( tmp );
+               const object* obj = find( value.id );
+               if( obj == nullptr )
+               {
+                  const auto& result = DerivedIndex::insert( std::move( value ) );
+                  for( const auto& item : _sindex )
+                     item->object_inserted( result );
+                  continue;
+               }
+               for( const auto& item : _sindex )
+                  item->about_to_modify( *obj );
+               DerivedIndex::modify( *obj, [&value]( object& o ) { o.move_from( value ); } );
+               for( const auto& item : _sindex )
+                  item->object_modified( *obj );
+            }
+         }
+
+         std::vector<char> undone_header( const std::deque<undo_state>& states, size_t first_state )const override
+         {
+            object_id_type next_id = _next_id;
+            const object_id_type index_id( object_type::space_id, object_type::type_id, 0 );
+            for( size_t i = first_state; i < states.size(); ++i )
+            {
+               auto itr = states[i].old_index_next_ids.find( index_id );
+               if( itr != states[i].old_index_next_ids.end() )
+               {
+                  next_id = itr->second;
+                  break;
+               }
+            }
+            const auto ver = get_object_version();
+            std::vector<char> result( fc::raw::pack_size( next_id ) + fc::raw::pack_size( ver ) );
+            fc::datastream<char*> ds( result.data(), result.size() );
+            fc::raw::pack( ds, next_id );
+            fc::raw::pack( ds, ver );
+            return result;
+         }
+
+         bool write_undone_objects( fd_writer& out, const std::deque<undo_state>& states,
+                                    size_t first_state )const override
+         {
+            // a single reference, so the std::function below does not allocate
+            struct write_context
+            {
+               fd_writer&                     out;
+               const std::deque<undo_state>&  states;
+               size_t                         first_state;
+            } context{ out, states, first_state };
+
+            this->inspect_all_objects( [&context]( const object& o ) {
+               const object* value = &o;
+               find_undone_value( context.states, context.first_state, o.id, value );
+               if( value != nullptr )
+                  write_object( context.out, static_cast<const object_type&>( *value ) );
             });
+
+            // objects removed since, each written once by the oldest state which saved it
+            auto write_removed = [this,&out,&states,first_state]( const object_id_map<arena_object_ptr>& values ) {
+               for( const auto& item : values )
+               {
+                  const object_id_type& id = item.first;
+                  if( id.space() != object_type::space_id || id.type() != object_type::type_id
+                        || find( id ) != nullptr )
+                     continue;
+                  const object* value = nullptr;
+                  find_undone_value( states, first_state, id, value );
+                  if( value == item.second.get() )
+                     write_object( out, static_cast<const object_type&>( *value ) );
+               }
+            };
+            for( size_t i = first_state; i < states.size(); ++i )
+            {
+               write_removed( states[i].old_values );
+               write_removed( states[i].removed );
+            }
+            return !out.failed();
          }
 
          const object&  load( const std::vector<char>& data )override
@@ -450,7 +742,87 @@ namespace graphene { namespace db {
          }
 
       private:
+         /// writes obj in the same format as fc::raw::pack( fc::raw::pack( obj ) ) without a second copy
+         /// @return the number of bytes written
+         static size_t write_object( std::ostream& out, const object_type& obj, std::vector<char>& buffer )
+         {
+            buffer.resize( fc::raw::pack_size( obj ) );
+            fc::datastream<char*> ds( buffer.data(), buffer.size() );
+            fc::raw::pack( ds, obj );
+            const fc::unsigned_int size( buffer.size() );
+            fc::raw::pack( out, size );
+            out.write( buffer.data(), buffer.size() );
+            return fc::raw::pack_size( size ) + buffer.size();
+         }
+
+         /// writes obj like the other overload, into the buffer of @p out
+         static bool write_object( fd_writer& out, const object_type& obj )
+         {
+            const fc::unsigned_int size( fc::raw::pack_size( obj ) );
+            const size_t total = fc::raw::pack_size( size ) + size.value;
+            char* dest = out.reserve( total );
+            if( dest == nullptr )
+               return false;
+            fc::datastream<char*> ds( dest, total );
+            fc::raw::pack( ds, size );
+            fc::raw::pack( ds, obj );
+            return true;
+         }
+
+         /**
+          *  Sets @p value to the value of the object @p id before the undo states from @p first_state on, which
+          *  is the one saved by the oldest of them which mentions it, or to nullptr if they created it
+          *  @return false if none of them mentions the object, then its current value is unchanged
+          */
+         static bool find_undone_value( const std::deque<undo_state>& states, size_t first_state,
+                                        const object_id_type& id, const object*& value )
+         {
+            for( size_t i = first_state; i < states.size(); ++i )
+            {
+               const auto& state = states[i];
+               if( state.new_ids.count( id ) > 0 )
+               {
+                  value = nullptr;
+                  return true;
+               }
+               auto old_value = state.old_values.find( id );
+               if( old_value != state.old_values.end() )
+               {
+                  value = old_value->second.get();
+                  return true;
+               }
+               auto removed = state.removed.find( id );
+               if( removed != state.removed.end() )
+               {
+                  value = removed->second.get();
+                  return true;
+               }
+            }
+            return false;
+         }
+
+         /// Uses DerivedIndex::insert_loaded() if there is one, which may be faster for objects in ID order
+         template<typename Index>
+         static auto insert_loaded( Index& idx, object_type&& obj, int )
+            -> decltype( idx.insert_loaded( std::move( obj ) ) )
+         { return idx.insert_loaded( std::move( obj ) ); }
+         template<typename Index>
+         static const object& insert_loaded( Index& idx, object_type&& obj, long )
+         { return idx.Index::insert( std::move( obj ) ); }
+
+         /// State of an open in progress, see begin_open()
+         struct chunked_load
+         {
+            std::unique_ptr<fc::file_mapping>        mapping;
+            std::unique_ptr<fc::mapped_region>       region;
+            const char*                              data = nullptr;
+            std::vector<index_chunk>                 chunks;
+            std::vector< std::vector<object_type> >  decoded;
+            size_t                                   objects = 0;
+         };
+
          object_id_type                                 _next_id;
+         std::unique_ptr<chunked_load>                  _load;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
    };
 
@@ -24,6 +24,7 @@
 #pragma once
 #include <boost/multiprecision/integer.hpp>
 #include <graphene/protocol/object_id.hpp>
+#include <graphene/db/object_arena.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/crypto/city.hpp>
 
@@ -71,6 +72,8 @@ namespace graphene { namespace db {
          /// these methods are implemented for derived classes by inheriting base_abstract_object<DerivedClass>
          /// @{
          virtual std::unique_ptr<object> clone()const = 0;
+         /// copy constructs this object in memory of @p arena, the caller has to call the destructor
+         virtual object*                 clone_into( object_arena& arena )const = 0;
          virtual void                    move_from( object& obj ) = 0;
          virtual fc::variant             to_variant()const  = 0;
          virtual std::vector<char>       pack()const = 0;
@@ -93,6 +96,11 @@ namespace graphene { namespace db {
          {
             return std::make_unique<DerivedClass>( *static_cast<const DerivedClass*>(this) );
          }
+         object* clone_into( object_arena& arena )const override
+         {
+            return new( arena.allocate( sizeof(DerivedClass), alignof(DerivedClass) ) )
+                   DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
 
          void    move_from( object& obj ) override
          {
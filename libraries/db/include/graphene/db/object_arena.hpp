@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    * @class object_arena
+    * @brief Bump allocator for the object copies kept by an undo state
+    *
+    * Memory is taken from fixed size blocks and only released as a whole by reset() or the destructor,
+    * which hand the blocks back to the pool they came from, so that the next undo session can reuse
+    * them without calling the heap allocator. The arena never calls destructors, owners of the objects
+    * have to destroy them before the arena is reset.
+    */
+   class object_arena
+   {
+      public:
+         static constexpr size_t block_size = 16 * 1024;
+         /// Larger allocations get a dedicated block which is not pooled
+         static constexpr size_t max_pooled_size = block_size / 4;
+
+         /// Blocks released by arenas, for reuse by other arenas. Not thread safe.
+         class block_pool
+         {
+            public:
+               explicit block_pool( size_t max_free_blocks = 1024 ) : _max_free( max_free_blocks ) {}
+
+               std::unique_ptr<char[]> acquire();
+               void                    release( std::unique_ptr<char[]> block );
+               size_t                  free_blocks()const { return _free.size(); }
+
+            private:
+               std::vector< std::unique_ptr<char[]> > _free;
+               size_t                                 _max_free;
+         };
+
+         explicit object_arena( block_pool* pool = nullptr ) : _pool( pool ) {}
+         object_arena( const object_arena& ) = delete;
+         object_arena( object_arena&& ) = default;
+         ~object_arena() { reset(); }
+
+         object_arena& operator=( const object_arena& ) = delete;
+         object_arena& operator=( object_arena&& mv )
+         {
+            if( this != &mv )
+            {
+               reset();
+               _pool = mv._pool;
+               _blocks = std::move( mv._blocks );
+               _large = std::move( mv._large );
+               _used = mv._used;
+               mv._used = block_size;
+            }
+            return *this;
+         }
+
+         /// @return uninitialized memory for @p size bytes, aligned to @p alignment
+         void* allocate( size_t size, size_t alignment );
+         /// Releases all memory, the objects allocated in the arena must have been destroyed already
+         void  reset();
+         /// Takes over the memory of @p other, so that its objects can be handed to the owner of this arena
+         void  splice( object_arena& other );
+
+         size_t allocated_blocks()const { return _blocks.size() + _large.size(); }
+
+      private:
+         block_pool*                            _pool;
+         std::vector< std::unique_ptr<char[]> > _blocks;
+         std::vector< std::unique_ptr<char[]> > _large;
+         /// Bytes used in _blocks.back()
+         size_t                                 _used = block_size;
+   };
+
+} } // graphene::db
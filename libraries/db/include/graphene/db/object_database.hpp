@@ -27,6 +27,7 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/future.hpp>
 
 #include <map>
 
@@ -59,6 +60,65 @@ namespace graphene { namespace db {
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
+         /**
+          * @brief Saves the objects created, modified or removed since the last flush as a new delta
+          *
+          * Deltas are stored next to the complete state and applied on top of it by open(), in the order
+          * they were written. Requires dirty object tracking, see @ref set_max_deltas.
+          */
+         void flush_delta();
+         /**
+          * Merges all deltas into the complete state on disk in a background task. Only reads files,
+          * so it does not block changes to the objects in memory, nor flush_delta().
+          */
+         void compact_deltas();
+         /// Number of deltas on disk which are not merged into the complete state yet
+         size_t delta_count()const;
+         /**
+          * Set the number of deltas to keep before they are merged into the complete state on open(),
+          * 0 disables deltas. Enables tracking of dirty objects if non-zero, must be called before open().
+          */
+         void set_max_deltas( uint32_t max_deltas )
+         {
+            _max_deltas = max_deltas;
+            _track_dirty_objects = ( max_deltas > 0 );
+         }
+         bool delta_flush_enabled()const { return _max_deltas > 0; }
+
+         /**
+          * Files and buffers of a checkpoint, created by prepare_checkpoint(). The files are closed on
+          * destruction.
+          */
+         struct prepared_checkpoint
+         {
+            prepared_checkpoint() = default;
+            prepared_checkpoint( const prepared_checkpoint& ) = delete;
+            prepared_checkpoint& operator=( const prepared_checkpoint& ) = delete;
+            ~prepared_checkpoint();
+
+            /// the state before the undo states from this one on is written
+            size_t                                    first_state = 0;
+            std::vector< std::pair<const index*,int> > files;
+            std::vector< std::vector<char> >          headers;
+            std::vector<char>                         buffer;
+         };
+         /**
+          * Creates the files of a checkpoint in @p dir, which will contain the state before the last
+          * @p undo_states undo states, in the same format as flush().
+          */
+         std::unique_ptr<prepared_checkpoint> prepare_checkpoint( const fc::path& dir, size_t undo_states )const;
+         /**
+          * Writes a prepared checkpoint. Neither allocates nor throws and only uses the calling thread, so it is
+          * safe to call from a forked child process, as long as the state is not changed in between.
+          * @return false if writing failed
+          */
+         bool write_checkpoint( prepared_checkpoint& checkpoint )const;
+         /**
+          * Loads the state from a directory written by write_checkpoint() instead of the state in
+          * @p data_dir. The next flush will write the complete state.
+          */
+         void open_checkpoint( const fc::path& data_dir, const fc::path& dir );
+
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
@@ -188,8 +248,23 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         /// @return sequence numbers of the deltas on disk in ascending order
+         std::vector<uint32_t> list_deltas()const;
+         void wait_for_compaction();
+         /// Loads all indexes from @p dir and applies the given deltas on top
+         void load_indexes( const fc::path& dir, const std::vector<uint32_t>& deltas );
+         void clear_dirty_objects();
+
          fc::path                                                  _data_dir;
          std::vector< std::vector< std::unique_ptr<index> > >      _index;
+
+         uint32_t                                                  _max_deltas = 0;
+         bool                                                      _track_dirty_objects = false;
+         /// Sequence number of the next delta to write
+         uint32_t                                                  _next_delta = 1;
+         /// Set when the objects in memory were not loaded from the state deltas are based on
+         bool                                                      _full_flush_required = false;
+         fc::future<void>                                          _compaction;
    };
 
 } } // graphene::db
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/protocol/object_id.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   namespace detail {
+      /// Entries of object_id_map, the key is the first member
+      template< typename T >
+      struct object_id_map_traits
+      {
+         using entry_type = std::pair< object_id_type, T >;
+         static const object_id_type& key( const entry_type& e ) { return e.first; }
+         static entry_type make( const object_id_type& id )
+         { return entry_type( std::piecewise_construct, std::forward_as_tuple( id ), std::forward_as_tuple() ); }
+      };
+      /// Entries of object_id_set are the keys
+      struct object_id_set_traits
+      {
+         using entry_type = object_id_type;
+         static const object_id_type& key( const entry_type& e ) { return e; }
+         static entry_type make( const object_id_type& id ) { return id; }
+      };
+   }
+
+   /**
+    * @class object_id_table
+    * @brief Open addressing hash table keyed by object IDs, with linear probing
+    *
+    * All entries are stored in one array, so inserting an ID does not allocate unless the table has
+    * to grow. Erased entries leave a tombstone, which is reused by inserts and dropped on rehash.
+    * Inserting invalidates iterators, iteration order is unspecified.
+    * Use it through @ref object_id_map and @ref object_id_set.
+    */
+   template< typename Traits >
+   class object_id_table
+   {
+      public:
+         using entry_type = typename Traits::entry_type;
+
+         template< typename Entry, typename Table >
+         class basic_iterator
+         {
+            public:
+               using iterator_category = std::forward_iterator_tag;
+               using value_type        = entry_type;
+               using difference_type   = std::ptrdiff_t;
+               using pointer           = Entry*;
+               using reference         = Entry&;
+
+               basic_iterator() = default;
+               basic_iterator( Table* table, size_t pos ) : _table( table ), _pos( pos ) { skip_unused(); }
+               /// const_iterator from iterator
+               template< typename E, typename T >
+               basic_iterator( const basic_iterator<E,T>& other ) : _table( other._table ), _pos( other._pos ) {}
+
+               reference operator*()const  { return _table->_entries[_pos]; }
+               pointer   operator->()const { return &_table->_entries[_pos]; }
+               basic_iterator& operator++()   { ++_pos; skip_unused(); return *this; }
+               basic_iterator  operator++(int) { auto tmp = *this; ++*this; return tmp; }
+
+               friend bool operator==( const basic_iterator& a, const basic_iterator& b ) { return a._pos == b._pos; }
+               friend bool operator!=( const basic_iterator& a, const basic_iterator& b ) { return a._pos != b._pos; }
+
+            private:
+               template< typename E, typename T > friend class basic_iterator;
+               friend class object_id_table;
+
+               void skip_unused()
+               {
+                  while( _pos < _table->_states.size() && _table->_states[_pos] != used )
+                     ++_pos;
+               }
+
+               Table* _table = nullptr;
+               size_t _pos = 0;
+         };
+         using iterator       = basic_iterator< entry_type, object_id_table >;
+         using const_iterator = basic_iterator< const entry_type, const object_id_table >;
+
+         iterator       begin()       { return iterator( this, 0 ); }
+         iterator       end()         { return iterator( this, _states.size() ); }
+         const_iterator begin()const  { return const_iterator( this, 0 ); }
+         const_iterator end()const    { return const_iterator( this, _states.size() ); }
+
+         size_t size()const  { return _size; }
+         bool   empty()const { return _size == 0; }
+
+         void clear()
+         {
+            _entries.clear();
+            _states.clear();
+            _size = 0;
+            _tombstones = 0;
+         }
+
+         iterator find( const object_id_type& id )
+         {
+            return iterator( this, find_pos( id ) );
+         }
+         const_iterator find( const object_id_type& id )const
+         {
+            return const_iterator( this, find_pos( id ) );
+         }
+         size_t count( const object_id_type& id )const { return find_pos( id ) == _states.size() ? 0 : 1; }
+
+         /// Inserts a default entry for @p id if there is none, @return the entry and whether it was inserted
+         std::pair< iterator, bool > emplace_key( const object_id_type& id )
+         {
+            size_t pos = find_pos( id );
+            if( pos != _states.size() )
+               return std::make_pair( iterator( this, pos ), false );
+            if( ( _size + _tombstones + 1 ) * 4 > _states.size() * 3 )
+               rehash( _size * 2 + 2 > _states.size() / 2 ? std::max<size_t>( 16, _states.size() * 2 ) : _states.size() );
+            pos = slot_of( id );
+            while( _states[pos] == used )
+               pos = ( pos + 1 ) & ( _states.size() - 1 );
+            if( _states[pos] == tombstone )
+               --_tombstones;
+            _entries[pos] = Traits::make( id );
+            _states[pos] = used;
+            ++_size;
+            return std::make_pair( iterator( this, pos ), true );
+         }
+
+         /// @return the number of erased entries
+         size_t erase( const object_id_type& id )
+         {
+            const size_t pos = find_pos( id );
+            if( pos == _states.size() )
+               return 0;
+            erase_at( pos );
+            return 1;
+         }
+         void erase( const_iterator itr ) { erase_at( itr._pos ); }
+
+         /// Map access, inserts a default value if @p id is not in the map
+         template< typename Entry = entry_type >
+         auto operator[]( const object_id_type& id ) -> decltype( std::declval<Entry&>().second )&
+         {
+            return emplace_key( id ).first->second;
+         }
+         /// Set insert
+         std::pair< iterator, bool > insert( const object_id_type& id ) { return emplace_key( id ); }
+
+      private:
+         enum slot_state : uint8_t { unused = 0, used = 1, tombstone = 2 };
+
+         size_t slot_of( const object_id_type& id )const
+         {
+            // Fibonacci hashing, the low bits of IDs are instances, which are mostly sequential
+            return size_t( ( id.number * 0x9E3779B97F4A7C15ull ) >> ( 64 - _bits ) );
+         }
+
+         size_t find_pos( const object_id_type& id )const
+         {
+            if( _size == 0 )
+               return _states.size();
+            for( size_t pos = slot_of( id ); ; pos = ( pos + 1 ) & ( _states.size() - 1 ) )
+            {
+               if( _states[pos] == unused )
+                  return _states.size();
+               if( _states[pos] == used && Traits::key( _entries[pos] ) == id )
+                  return pos;
+            }
+         }
+
+         void erase_at( size_t pos )
+         {
+            _entries[pos] = entry_type(); // releases the value now, as a node based container would
+            _states[pos] = tombstone;
+            --_size;
+            ++_tombstones;
+         }
+
+         void rehash( size_t capacity )
+         {
+            std::vector< entry_type > entries( capacity );
+            std::vector< uint8_t > states( capacity, unused );
+            std::swap( entries, _entries );
+            std::swap( states, _states );
+            _bits = 0;
+            while( ( size_t(1) << _bits ) < capacity )
+               ++_bits;
+            _tombstones = 0;
+            for( size_t i = 0; i < states.size(); ++i )
+            {
+               if( states[i] != used )
+                  continue;
+               size_t pos = slot_of( Traits::key( entries[i] ) );
+               while( _states[pos] == used )
+                  pos = ( pos + 1 ) & ( capacity - 1 );
+               _entries[pos] = std::move( entries[i] );
+               _states[pos] = used;
+            }
+         }
+
+         std::vector< entry_type > _entries;
+         std::vector< uint8_t >    _states;
+         size_t                    _size = 0;
+         size_t                    _tombstones = 0;
+         uint32_t                  _bits = 0;
+   };
+
+   /// Map from object IDs to @p T, see object_id_table
+   template< typename T >
+   using object_id_map = object_id_table< detail::object_id_map_traits<T> >;
+   /// Set of object IDs, see object_id_table
+   using object_id_set = object_id_table< detail::object_id_set_traits >;
+
+} } // graphene::db
@@ -23,6 +23,8 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/object_arena.hpp>
+#include <graphene/db/object_id_map.hpp>
 #include <deque>
 #include <fc/exception/exception.hpp>
 
@@ -30,12 +32,28 @@ namespace graphene { namespace db {
 
    class object_database;
 
+   /// Destroys an object allocated in an object_arena, without freeing its memory
+   struct arena_object_deleter
+   {
+      void operator()( object* obj )const { obj->~object(); }
+   };
+   using arena_object_ptr = std::unique_ptr< object, arena_object_deleter >;
+
+   /**
+    * The saved objects are allocated in the arena of the state, which returns its memory to the pool of the
+    * undo_database once the state is popped, so undo sessions do not allocate on the heap in the steady state.
+    */
    struct undo_state
    {
-      std::unordered_map<object_id_type, std::unique_ptr<object> > old_values;
-      std::unordered_map<object_id_type, object_id_type>           old_index_next_ids;
-      std::unordered_set<object_id_type>                           new_ids;
-      std::unordered_map<object_id_type, std::unique_ptr<object> > removed;
+      explicit undo_state( object_arena::block_pool* pool = nullptr ) : arena( pool ) {}
+
+      // declared first to be destroyed last, after the objects in it
+      object_arena                       arena;
+
+      object_id_map< arena_object_ptr >  old_values;
+      object_id_map< object_id_type >    old_index_next_ids;
+      object_id_set                      new_ids;
+      object_id_map< arena_object_ptr >  removed;
    };
 
 
@@ -117,23 +135,33 @@ namespace graphene { namespace db {
           */
          void pop_commit();
 
+         /**
+          *  Drops all undo states without undoing them, the current state can not be
+          *  rewound afterwards. There must be no active sessions.
+          */
+         void discard_history();
+
          std::size_t size()const { return _stack.size(); }
          void set_max_size(size_t new_max_size) { _max_size = new_max_size; }
          size_t max_size()const { return _max_size; }
          uint32_t active_sessions()const { return _active_sessions; }
 
          const undo_state& head()const;
+         /// All undo states, the oldest first
+         const std::deque<undo_state>& states()const { return _stack; }
 
       private:
          void undo();
          void merge();
          void commit();
 
-         uint32_t                _active_sessions = 0;
-         bool                    _disabled = true;
-         std::deque<undo_state>  _stack;
-         object_database&        _db;
-         size_t                  _max_size = 256;
+         uint32_t                   _active_sessions = 0;
+         bool                       _disabled = true;
+         /// must outlive the arenas of the states in _stack
+         object_arena::block_pool   _arena_pool;
+         std::deque<undo_state>     _stack;
+         object_database&           _db;
+         size_t                     _max_size = 256;
    };
 
 } } // graphene::db
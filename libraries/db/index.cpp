@@ -21,23 +21,153 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <fc/io/fstream.hpp>
 #include <fc/io/raw.hpp>
 #include <graphene/db/index.hpp>
 #include <graphene/db/object_database.hpp>
 
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace graphene { namespace db {
+   fc::path index_chunk_table( const fc::path& file )
+   {
+      return fc::path( file.generic_string() + ".chunks" );
+   }
+
+   void write_index_chunks( const fc::path& file, uint64_t file_size, const std::vector<index_chunk>& chunks )
+   {
+      const auto table = index_chunk_table( file );
+      std::ofstream out( table.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out );
+      fc::raw::pack( out, file_size );
+      fc::raw::pack( out, fc::unsigned_int( chunks.size() ) );
+      for( const auto& chunk : chunks )
+      {
+         fc::raw::pack( out, chunk.offset );
+         fc::raw::pack( out, chunk.size );
+         fc::raw::pack( out, chunk.objects );
+      }
+      FC_ASSERT( out.flush(), "Failed to write ${f}", ("f", table) );
+   }
+
+   std::vector<index_chunk> read_index_chunks( const fc::path& file, const char* data, size_t size, size_t begin )
+   {
+      std::vector<index_chunk> chunks;
+      const auto table = index_chunk_table( file );
+      if( fc::exists( table ) )
+      {
+         try
+         {
+            std::string content;
+            fc::read_file_contents( table, content );
+            fc::datastream<const char*> ds( content.data(), content.size() );
+            uint64_t file_size;
+            fc::unsigned_int count;
+            fc::raw::unpack( ds, file_size );
+            fc::raw::unpack( ds, count );
+            chunks.resize( count.value );
+            uint64_t expected_offset = begin;
+            for( auto& chunk : chunks )
+            {
+               fc::raw::unpack( ds, chunk.offset );
+               fc::raw::unpack( ds, chunk.size );
+               fc::raw::unpack( ds, chunk.objects );
+               FC_ASSERT( chunk.offset == expected_offset );
+               expected_offset += chunk.size;
+            }
+            // the table of an older file which was replaced without it must not be used
+            FC_ASSERT( file_size == size && expected_offset == size );
+            return chunks;
+         }
+         catch( const fc::exception& )
+         {
+            wlog( "Ignoring invalid chunk table of ${f}", ("f", file) );
+            chunks.clear();
+         }
+      }
+
+      // no table, find the chunks from the sizes of the objects
+      fc::datastream<const char*> ds( data + begin, size - begin );
+      while( ds.remaining() > 0 )
+      {
+         if( chunks.empty() || chunks.back().objects == index_chunk_objects )
+         {
+            chunks.emplace_back();
+            chunks.back().offset = ds.pos() - data;
+         }
+         fc::unsigned_int object_size;
+         fc::raw::unpack( ds, object_size );
+         FC_ASSERT( ds.remaining() >= object_size.value, "Corrupt object database file ${f}", ("f", file) );
+         ds.skip( object_size.value );
+         chunks.back().size = ( ds.pos() - data ) - chunks.back().offset;
+         ++chunks.back().objects;
+      }
+      return chunks;
+   }
+
+   char* fd_writer::reserve( size_t size )
+   {
+      if( _used + size > _capacity && !flush() )
+         return nullptr;
+      if( size > _capacity )
+         _failed = true;
+      if( _failed )
+         return nullptr;
+      char* result = _buffer + _used;
+      _used += size;
+      return result;
+   }
+
+   bool fd_writer::write( const char* data, size_t size )
+   {
+      char* dest = reserve( size );
+      if( dest == nullptr )
+         return false;
+      std::memcpy( dest, data, size );
+      return true;
+   }
+
+   bool fd_writer::flush()
+   {
+      size_t done = 0;
+      while( !_failed && done < _used )
+      {
+         const auto written = ::write( _fd, _buffer + done, _used - done );
+         if( written < 0 )
+            _failed = ( errno != EINTR );
+         else
+            done += written;
+      }
+      _used = 0;
+      return !_failed;
+   }
+
    void base_primary_index::save_undo( const object& obj )
    { _db.save_undo( obj ); }
 
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      mark_dirty( obj );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   { _db.save_undo_remove( obj ); mark_dirty( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   { mark_dirty( obj ); for( auto ob : _observers ) ob->on_modify(  obj ); }
+
+   void base_primary_index::mark_dirty( const object& obj )
+   {
+      if( _db._track_dirty_objects )
+         _dirty_ids.insert( obj.id );
+   }
 } } // graphene::chain
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/db/object_arena.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace db {
+
+std::unique_ptr<char[]> object_arena::block_pool::acquire()
+{
+   if( _free.empty() )
+      return std::unique_ptr<char[]>( new char[block_size] );
+   auto block = std::move( _free.back() );
+   _free.pop_back();
+   return block;
+}
+
+void object_arena::block_pool::release( std::unique_ptr<char[]> block )
+{
+   if( _free.size() < _max_free )
+      _free.push_back( std::move( block ) );
+}
+
+void* object_arena::allocate( size_t size, size_t alignment )
+{
+   // new char[] is suitably aligned for any fundamental type
+   FC_ASSERT( alignment <= alignof(std::max_align_t) && ( alignment & ( alignment - 1 ) ) == 0 );
+   if( size > max_pooled_size )
+   {
+      _large.emplace_back( new char[size] );
+      return _large.back().get();
+   }
+   size_t offset = ( _used + alignment - 1 ) & ~( alignment - 1 );
+   if( _blocks.empty() || offset + size > block_size )
+   {
+      _blocks.push_back( _pool ? _pool->acquire() : std::unique_ptr<char[]>( new char[block_size] ) );
+      offset = 0;
+   }
+   _used = offset + size;
+   return _blocks.back().get() + offset;
+}
+
+void object_arena::reset()
+{
+   if( _pool )
+   {
+      for( auto& block : _blocks )
+         _pool->release( std::move( block ) );
+   }
+   _blocks.clear();
+   _large.clear();
+   _used = block_size;
+}
+
+void object_arena::splice( object_arena& other )
+{
+   // keep allocating from our current block, the blocks of other are full enough
+   _blocks.insert( _blocks.begin(), std::make_move_iterator( other._blocks.begin() ),
+                   std::make_move_iterator( other._blocks.end() ) );
+   _large.insert( _large.end(), std::make_move_iterator( other._large.begin() ),
+                  std::make_move_iterator( other._large.end() ) );
+   other._blocks.clear();
+   other._large.clear();
+   other._used = block_size;
+}
+
+} } // graphene::db
@@ -23,10 +23,23 @@
  */
 #include <graphene/db/object_database.hpp>
 
+#include <fc/io/fstream.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <map>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace graphene { namespace db {
 
 object_database::object_database()
@@ -38,6 +51,7 @@ object_database::object_database()
 
 void object_database::close()
 {
+   wait_for_compaction();
 }
 
 const object* object_database::find_object( const object_id_type& id )const
@@ -78,8 +92,142 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+namespace {
+
+const char* const deltas_dir_name = "object_database_deltas";
+
+/// The sequence number of the last delta contained in the complete state in @p dir
+uint32_t read_merged_delta( const fc::path& dir )
+{
+   if( !fc::exists( dir / "delta" ) )
+      return 0;
+   std::string content;
+   fc::read_file_contents( dir / "delta", content );
+   return content.empty() ? 0 : std::stoul( content );
+}
+
+void write_merged_delta( const fc::path& dir, uint32_t seq )
+{
+   std::ofstream out( (dir / "delta").generic_string(), std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out );
+   out << seq;
+}
+
+/// Merges the deltas into the complete state of one index, see primary_index::save_delta() for the format
+void merge_index_deltas( const fc::path& base, const std::vector<fc::path>& deltas, const fc::path& target )
+{
+   std::vector< std::unique_ptr<fc::file_mapping> >  mappings;
+   std::vector< std::unique_ptr<fc::mapped_region> > regions;
+   auto map_file = [&mappings,&regions]( const fc::path& file ) {
+      mappings.emplace_back( std::make_unique<fc::file_mapping>( file.generic_string().c_str(), fc::read_only ) );
+      regions.emplace_back( std::make_unique<fc::mapped_region>( *mappings.back(), fc::read_only,
+                                                                 0, fc::file_size( file ) ) );
+      return fc::datastream<const char*>( (const char*)regions.back()->get_address(), regions.back()->get_size() );
+   };
+   auto peek_id = []( const char* data, size_t size ) {
+      // the ID is the first serialized member of every object
+      fc::datastream<const char*> ds( data, size );
+      object_id_type id;
+      fc::raw::unpack( ds, id );
+      return id;
+   };
+
+   object_id_type next_id;
+   fc::sha256 version;
+   bool have_header = false;
+   // latest value of every object changed by the deltas, a null pointer if removed
+   std::map< object_id_type, std::pair< const char*, size_t > > changes;
+   for( const auto& delta : deltas )
+   {
+      if( !fc::exists( delta ) )
+         continue;
+      auto ds = map_file( delta );
+      fc::raw::unpack( ds, next_id );
+      fc::raw::unpack( ds, version );
+      have_header = true;
+      std::vector<object_id_type> removed;
+      fc::raw::unpack( ds, removed );
+      for( const auto& id : removed )
+         changes[id] = std::make_pair( nullptr, 0 );
+      while( ds.remaining() > 0 )
+      {
+         fc::unsigned_int size;
+         fc::raw::unpack( ds, size );
+         FC_ASSERT( ds.remaining() >= size.value, "Corrupt object database delta ${f}", ("f", delta) );
+         changes[ peek_id( ds.pos(), size.value ) ] = std::make_pair( ds.pos(), size.value );
+         ds.skip( size.value );
+      }
+   }
+
+   if( !have_header )
+   {
+      if( fc::exists( base ) )
+         fc::copy( base, target );
+      if( fc::exists( index_chunk_table( base ) ) )
+         fc::copy( index_chunk_table( base ), index_chunk_table( target ) );
+      return;
+   }
+
+   std::ofstream out( target.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out );
+   fc::raw::pack( out, next_id );
+   fc::raw::pack( out, version );
+   std::vector<index_chunk> chunks;
+   uint64_t offset = out.tellp();
+   auto write_entry = [&out,&chunks,&offset]( const char* data, size_t size ) {
+      if( chunks.empty() || chunks.back().objects == index_chunk_objects )
+      {
+         chunks.emplace_back();
+         chunks.back().offset = offset;
+      }
+      const fc::unsigned_int packed_size( size );
+      fc::raw::pack( out, packed_size );
+      out.write( data, size );
+      offset += fc::raw::pack_size( packed_size ) + size;
+      chunks.back().size = offset - chunks.back().offset;
+      ++chunks.back().objects;
+   };
+
+   if( fc::exists( base ) )
+   {
+      auto ds = map_file( base );
+      object_id_type base_next_id;
+      fc::sha256 base_version;
+      fc::raw::unpack( ds, base_next_id );
+      fc::raw::unpack( ds, base_version );
+      FC_ASSERT( base_version == version, "Object version mismatch between ${f} and its deltas", ("f", base) );
+      while( ds.remaining() > 0 )
+      {
+         fc::unsigned_int size;
+         fc::raw::unpack( ds, size );
+         FC_ASSERT( ds.remaining() >= size.value, "Corrupt object database file ${f}", ("f", base) );
+         auto itr = changes.find( peek_id( ds.pos(), size.value ) );
+         if( itr == changes.end() )
+            write_entry( ds.pos(), size.value );
+         else
+         {
+            if( itr->second.first != nullptr )
+               write_entry( itr->second.first, itr->second.second );
+            changes.erase( itr );
+         }
+         ds.skip( size.value );
+      }
+   }
+   for( const auto& item : changes )
+   {
+      if( item.second.first != nullptr )
+         write_entry( item.second.first, item.second.second );
+   }
+   FC_ASSERT( out.flush(), "Failed to write ${f}", ("f", target) );
+   write_index_chunks( target, offset, chunks );
+}
+
+} // anonymous namespace
+
 void object_database::flush()
 {
+   wait_for_compaction();
+
    const auto tmp_dir = _data_dir / "object_database.tmp";
    const auto old_dir = _data_dir / "object_database.old";
    const auto target_dir = _data_dir / "object_database";
@@ -108,6 +256,8 @@ void object_database::flush()
    }
    for( auto& task : tasks )
       task.wait();
+   // all deltas written so far are contained in the new state
+   write_merged_delta( tmp_dir, _next_delta - 1 );
    fc::remove_all( tmp_dir / "lock" );
    if( fc::exists( target_dir ) )
    {
@@ -117,6 +267,226 @@ void object_database::flush()
    }
    fc::rename( tmp_dir, target_dir );
    fc::remove_all( old_dir );
+   fc::remove_all( _data_dir / deltas_dir_name );
+   clear_dirty_objects();
+   _full_flush_required = false;
+}
+
+object_database::prepared_checkpoint::~prepared_checkpoint()
+{
+   for( const auto& file : files )
+      ::close( file.second );
+}
+
+std::unique_ptr<object_database::prepared_checkpoint> object_database::prepare_checkpoint( const fc::path& dir,
+                                                                                        size_t undo_states )const
+{ try {
+   constexpr size_t buffer_size = 16 * 1024 * 1024;
+   const auto& states = _undo_db.states();
+   FC_ASSERT( undo_states <= states.size(), "Only ${n} undo states are available", ("n", states.size()) );
+
+   auto checkpoint = std::make_unique<prepared_checkpoint>();
+   checkpoint->first_state = states.size() - undo_states;
+   checkpoint->buffer.resize( buffer_size );
+   for( size_t space = 0; space < _index.size(); ++space )
+   {
+      fc::create_directories( dir / fc::to_string(space) );
+      for( size_t type = 0; type < _index[space].size(); ++type )
+      {
+         if( !_index[space][type] )
+            continue;
+         const auto file = dir / fc::to_string(space) / fc::to_string(type);
+         int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef _WIN32
+         flags |= O_BINARY;
+#endif
+         const int fd = ::open( file.generic_string().c_str(), flags, 0644 );
+         FC_ASSERT( fd >= 0, "Failed to create ${f}, errno ${e}", ("f", file)("e", errno) );
+         checkpoint->files.emplace_back( _index[space][type].get(), fd );
+         checkpoint->headers.push_back( _index[space][type]->undone_header( states, checkpoint->first_state ) );
+      }
+   }
+   return checkpoint;
+} FC_CAPTURE_AND_RETHROW( (dir)(undo_states) ) }
+
+bool object_database::write_checkpoint( prepared_checkpoint& checkpoint )const
+{
+   const auto& states = _undo_db.states();
+   for( size_t i = 0; i < checkpoint.files.size(); ++i )
+   {
+      const int fd = checkpoint.files[i].second;
+      const auto& header = checkpoint.headers[i];
+      fd_writer out( fd, checkpoint.buffer.data(), checkpoint.buffer.size() );
+      if( !out.write( header.data(), header.size() )
+            || !checkpoint.files[i].first->write_undone_objects( out, states, checkpoint.first_state )
+            || !out.flush() )
+         return false;
+#ifndef _WIN32
+      if( ::fsync( fd ) != 0 )
+         return false;
+#endif
+   }
+   return true;
+}
+
+void object_database::open_checkpoint( const fc::path& data_dir, const fc::path& dir )
+{ try {
+   _data_dir = data_dir;
+   // the deltas on disk stay unused until the next flush removes them, but must not be overwritten
+   const auto deltas = list_deltas();
+   _next_delta = std::max( read_merged_delta( _data_dir / "object_database" ),
+                           deltas.empty() ? 0 : deltas.back() ) + 1;
+   _full_flush_required = true;
+   ilog( "Opening object database from checkpoint ${d} ...", ("d", dir) );
+   load_indexes( dir, {} );
+   ilog( "Done opening object database." );
+} FC_CAPTURE_AND_RETHROW( (data_dir)(dir) ) }
+
+void object_database::flush_delta()
+{
+   FC_ASSERT( _track_dirty_objects, "Dirty objects are not tracked" );
+   if( _full_flush_required || !fc::exists( _data_dir / "object_database" ) )
+   {
+      // a delta is useless without the complete state it is based on
+      flush();
+      return;
+   }
+
+   const auto deltas_dir = _data_dir / deltas_dir_name;
+   const auto tmp_dir = deltas_dir / ( fc::to_string( _next_delta ) + ".tmp" );
+   const auto target_dir = deltas_dir / fc::to_string( _next_delta );
+
+   if( fc::exists( tmp_dir ) )
+      fc::remove_all( tmp_dir );
+   fc::create_directories( tmp_dir );
+   std::vector<fc::future<void>> tasks;
+   size_t dirty_count = 0;
+
+   const auto spaces = _index.size();
+   for( size_t space = 0; space < spaces; ++space )
+   {
+      const auto types = _index[space].size();
+      for( size_t type = 0; type < types; ++type )
+      {
+         if( !_index[space][type] || _index[space][type]->dirty_object_count() == 0 )
+            continue;
+         dirty_count += _index[space][type]->dirty_object_count();
+         fc::create_directories( tmp_dir / fc::to_string(space) );
+         tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir] () {
+            _index[space][type]->save_delta( tmp_dir / fc::to_string(space) / fc::to_string(type) );
+         } ) );
+      }
+   }
+   for( auto& task : tasks )
+      task.wait();
+   fc::rename( tmp_dir, target_dir );
+   ilog( "Saved ${n} changed objects of ${i} indexes as object database delta ${d}",
+         ("n", dirty_count)("i", tasks.size())("d", _next_delta) );
+   ++_next_delta;
+   clear_dirty_objects();
+
+   if( _max_deltas > 0 && ( !_compaction.valid() || _compaction.ready() ) && delta_count() > _max_deltas )
+      compact_deltas();
+}
+
+std::vector<uint32_t> object_database::list_deltas()const
+{
+   std::vector<uint32_t> result;
+   const auto deltas_dir = _data_dir / deltas_dir_name;
+   if( !fc::exists( deltas_dir ) )
+      return result;
+   for( fc::directory_iterator itr( deltas_dir ); itr != fc::directory_iterator(); ++itr )
+   {
+      const std::string name = (*itr).filename().generic_string();
+      if( !name.empty() && std::all_of( name.begin(), name.end(), []( char c ) { return c >= '0' && c <= '9'; } ) )
+         result.push_back( std::stoul( name ) );
+   }
+   std::sort( result.begin(), result.end() );
+   return result;
+}
+
+size_t object_database::delta_count()const
+{
+   const uint32_t merged = read_merged_delta( _data_dir / "object_database" );
+   const auto deltas = list_deltas();
+   return std::count_if( deltas.begin(), deltas.end(), [merged]( uint32_t seq ) { return seq > merged; } );
+}
+
+void object_database::compact_deltas()
+{
+   wait_for_compaction();
+   const auto base_dir = _data_dir / "object_database";
+   if( !fc::exists( base_dir ) )
+      return;
+   const uint32_t merged = read_merged_delta( base_dir );
+   std::vector<uint32_t> deltas;
+   for( uint32_t seq : list_deltas() )
+      if( seq > merged )
+         deltas.push_back( seq );
+   if( deltas.empty() )
+      return;
+
+   std::vector< std::pair<size_t, size_t> > indexes;
+   for( size_t space = 0; space < _index.size(); ++space )
+      for( size_t type = 0; type < _index[space].size(); ++type )
+         if( _index[space][type] )
+            indexes.emplace_back( space, type );
+
+   ilog( "Merging ${n} object database deltas in the background", ("n", deltas.size()) );
+   _compaction = fc::do_parallel( [data_dir=_data_dir,deltas,indexes] () {
+      const auto tmp_dir = data_dir / "object_database.compact";
+      const auto old_dir = data_dir / "object_database.old";
+      const auto target_dir = data_dir / "object_database";
+      const auto deltas_dir = data_dir / deltas_dir_name;
+
+      if( fc::exists( tmp_dir ) )
+         fc::remove_all( tmp_dir );
+      fc::create_directories( tmp_dir / "lock" );
+      for( const auto& item : indexes )
+      {
+         const auto space = fc::to_string( item.first );
+         const auto type = fc::to_string( item.second );
+         std::vector<fc::path> delta_files;
+         delta_files.reserve( deltas.size() );
+         for( uint32_t seq : deltas )
+            delta_files.push_back( deltas_dir / fc::to_string( seq ) / space / type );
+         fc::create_directories( tmp_dir / space );
+         merge_index_deltas( target_dir / space / type, delta_files, tmp_dir / space / type );
+      }
+      write_merged_delta( tmp_dir, deltas.back() );
+      fc::remove_all( tmp_dir / "lock" );
+      if( fc::exists( old_dir ) )
+         fc::remove_all( old_dir );
+      fc::rename( target_dir, old_dir );
+      fc::rename( tmp_dir, target_dir );
+      fc::remove_all( old_dir );
+      for( uint32_t seq : deltas )
+         fc::remove_all( deltas_dir / fc::to_string( seq ) );
+      ilog( "Done merging object database deltas" );
+   } );
+}
+
+void object_database::wait_for_compaction()
+{
+   if( !_compaction.valid() )
+      return;
+   try
+   {
+      _compaction.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Failed to merge object database deltas: ${e}", ("e", e.to_detail_string()) );
+   }
+   _compaction = fc::future<void>();
+}
+
+void object_database::clear_dirty_objects()
+{
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->clear_dirty_objects();
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -124,41 +494,134 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   fc::remove_all(data_dir / deltas_dir_name);
    ilog("Done wiping object database.");
 }
 
 void object_database::open(const fc::path& data_dir)
 { try {
    _data_dir = data_dir;
+   _next_delta = 1;
+   _full_flush_required = false;
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
+       fc::remove_all( _data_dir / deltas_dir_name );
        return;
    }
-   std::vector<fc::future<void>> tasks;
-   tasks.reserve(200);
 
-   auto push_task = [this,&tasks]( size_t space, size_t type ) {
-      if( _index[space][type] )
-         tasks.push_back( fc::do_parallel( [this,space,type] () {
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space) / fc::to_string(type) );
-         } ) );
-   };
-
-   ilog("Opening object database from ${d} ...", ("d", data_dir));
-   const auto spaces = _index.size();
-   for( size_t space = 0; space < spaces; ++space )
+   const uint32_t merged = read_merged_delta( _data_dir / "object_database" );
+   std::vector<uint32_t> deltas;
+   if( fc::exists( _data_dir / "object_database" ) )
    {
-      const auto types = _index[space].size();
-      for( size_t type = 0; type  < types; ++type )
-         push_task( space, type );
+      for( uint32_t seq : list_deltas() )
+         if( seq > merged )
+            deltas.push_back( seq );
    }
-   for( auto& task : tasks )
-      task.wait();
+   else
+      fc::remove_all( _data_dir / deltas_dir_name );
+   _next_delta = std::max( merged, deltas.empty() ? 0 : deltas.back() ) + 1;
+
+   ilog("Opening object database from ${d} ...", ("d", data_dir));
+   load_indexes( _data_dir / "object_database", deltas );
+   if( !deltas.empty() )
+      ilog( "Applied ${n} object database deltas", ("n", deltas.size()) );
    ilog( "Done opening object database." );
 
+   if( _max_deltas > 0 && deltas.size() > _max_deltas )
+      compact_deltas();
+
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void object_database::load_indexes( const fc::path& dir, const std::vector<uint32_t>& deltas )
+{
+   struct index_load
+   {
+      index*                          idx = nullptr;
+      size_t                          space = 0;
+      size_t                          type = 0;
+      size_t                          chunks = 0;
+      fc::time_point                  start;
+      std::vector<fc::future<void>>   decoded;
+   };
+   std::vector<index_load> loads;
+
+   // map the files and find their chunks, this is cheap with a chunk table
+   for( size_t space = 0; space < _index.size(); ++space )
+   {
+      for( size_t type = 0; type < _index[space].size(); ++type )
+      {
+         if( !_index[space][type] )
+            continue;
+         loads.emplace_back();
+         index_load& load = loads.back();
+         load.idx = _index[space][type].get();
+         load.space = space;
+         load.type = type;
+         load.start = fc::time_point::now();
+         load.chunks = load.idx->begin_open( dir / fc::to_string(space) / fc::to_string(type) );
+      }
+   }
+
+   // Decode the chunks of all indexes in parallel, so that the largest index does not keep a single core busy.
+   // The decode tasks are queued before the insert tasks which wait for them, so they can not starve.
+   for( auto& load : loads )
+   {
+      load.decoded.reserve( load.chunks );
+      for( size_t chunk = 0; chunk < load.chunks; ++chunk )
+         load.decoded.push_back( fc::do_parallel( [idx=load.idx,chunk] () { idx->decode_chunk( chunk ); } ) );
+   }
+
+   // the chunks of every index are inserted in order while the later chunks are being decoded
+   std::vector<fc::future<void>> tasks;
+   tasks.reserve( loads.size() );
+   for( auto& load : loads )
+   {
+      tasks.push_back( fc::do_parallel( [this,&load,&deltas] () {
+         size_t chunk = 0;
+         try
+         {
+            for( ; chunk < load.chunks; ++chunk )
+            {
+               load.decoded[chunk].wait();
+               load.idx->insert_chunk( chunk );
+            }
+         }
+         catch( ... )
+         {
+            // the decoders write into the index until they are done
+            for( ++chunk; chunk < load.chunks; ++chunk )
+               load.decoded[chunk].wait();
+            throw;
+         }
+         const size_t objects = load.idx->end_open();
+         for( uint32_t seq : deltas )
+            load.idx->open_delta( _data_dir / deltas_dir_name / fc::to_string(seq)
+                                  / fc::to_string(load.space) / fc::to_string(load.type) );
+         if( objects > 0 )
+            ilog( "Loaded ${n} objects of index ${s}.${t} in ${c} chunks in ${ms} ms",
+                  ("n", objects)("s", load.space)("t", load.type)("c", load.chunks)
+                  ("ms", (fc::time_point::now() - load.start).count() / 1000) );
+      } ) );
+   }
+
+   // all tasks refer to loads, so wait for all of them before reporting the first error
+   std::exception_ptr error;
+   for( auto& task : tasks )
+   {
+      try
+      {
+         task.wait();
+      }
+      catch( ... )
+      {
+         if( !error )
+            error = std::current_exception();
+      }
+   }
+   if( error )
+      std::rethrow_exception( error );
+}
 
 void object_database::pop_undo()
 { try {
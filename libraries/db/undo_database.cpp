@@ -53,7 +53,7 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
    while( size() > max_size() )
       _stack.pop_front();
 
-   _stack.emplace_back();
+   _stack.emplace_back( &_arena_pool );
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -62,7 +62,7 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( &_arena_pool );
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -75,20 +75,21 @@ void undo_database::on_modify( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( &_arena_pool );
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   arena_object_ptr old_value( obj.clone_into( state.arena ) );
+   state.old_values[obj.id] = std::move( old_value );
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( &_arena_pool );
    undo_state& state = _stack.back();
    if( state.new_ids.count(obj.id) > 0 )
    {
@@ -102,7 +103,8 @@ void undo_database::on_remove( const object& obj )
       return;
    }
    if( state.removed.count(obj.id) > 0 ) return;
-   state.removed[obj.id] = obj.clone();
+   arena_object_ptr removed_value( obj.clone_into( state.arena ) );
+   state.removed[obj.id] = std::move( removed_value );
 }
 
 void undo_database::undo()
@@ -252,6 +254,8 @@ void undo_database::merge()
       // nop + del(was=Y) -> del(was=Y)
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
+   // the objects moved to prev_state live in the arena of state
+   prev_state.arena.splice( state.arena );
    _stack.pop_back();
    --_active_sessions;
 }
@@ -298,6 +302,12 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::discard_history()
+{
+   FC_ASSERT( _active_sessions == 0 );
+   _stack.clear();
+}
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
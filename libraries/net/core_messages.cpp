@@ -46,11 +46,42 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum get_compact_block_transactions_message::type  = core_message_type_enum::get_compact_block_transactions_message_type;
+  const core_message_type_enum compact_block_transactions_message::type      = core_message_type_enum::compact_block_transactions_message_type;
+
+  uint64_t get_compact_block_short_id( const transaction_id_type& trx_id )
+  {
+     uint64_t short_id;
+     memcpy( &short_id, trx_id.data(), sizeof(short_id) );
+     return short_id;
+  }
+
+  compact_block_message::compact_block_message( const block_message& full_block,
+                                                const item_hash_t& full_block_message_hash )
+  :item_hash(full_block_message_hash),header(full_block.block),block_id(full_block.block_id)
+  {
+     transactions.reserve( full_block.block.transactions.size() );
+     for( const auto& trx : full_block.block.transactions )
+     {
+        transactions.emplace_back();
+        transactions.back().short_id = get_compact_block_short_id( trx.id() );
+        transactions.back().operation_results = trx.operation_results;
+     }
+  }
 
 } } // graphene::net
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::trx_message, BOOST_PP_SEQ_NIL, (trx) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::block_message, BOOST_PP_SEQ_NIL, (block)(block_id) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_transaction, BOOST_PP_SEQ_NIL,
+                                (short_id)(operation_results) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_message, BOOST_PP_SEQ_NIL,
+                                (item_hash)(header)(block_id)(transactions) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::get_compact_block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (item_hash)(block_id)(indexes) )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::compact_block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (block_id)(transactions) )
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::item_id, BOOST_PP_SEQ_NIL,
                                (item_type)
@@ -131,6 +162,10 @@ FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::get_current_connections_reply_mess
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::get_compact_block_transactions_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transactions_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
@@ -60,7 +60,21 @@
 #define GRAPHENE_NET_DEFAULT_DESIRED_CONNECTIONS             20
 #define GRAPHENE_NET_DEFAULT_MAX_CONNECTIONS                 200
 
-#define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
+/**
+ * The byte budgets of the lanes of a peer's send queue.  A peer whose block or sync lane
+ * exceeds its budget isn't reading what we send, and is disconnected.  Inventory that
+ * doesn't fit in the transaction lane is dropped instead, peers learn about the items
+ * from their other connections.
+ */
+#define GRAPHENE_NET_MAXIMUM_QUEUED_BLOCK_MESSAGES_IN_BYTES       (1024 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_SYNC_MESSAGES_IN_BYTES        (1024 * 1024)
+#define GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTION_MESSAGES_IN_BYTES (1024 * 1024)
+
+/**
+ * The bytes the sync and the transaction lane of a peer's send queue may send in
+ * one round robin turn.  The sync lane gets twice this.
+ */
+#define GRAPHENE_NET_SEND_QUEUE_QUANTUM_IN_BYTES             (64 * 1024)
 
 /**
  * When we receive a message from the network, we advertise it to
@@ -86,6 +100,13 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * During sync, if the next block we need to push has been requested from a
+ * peer for longer than this, and longer than a few times the interval at which
+ * that peer delivers blocks, request it from another peer as well
+ */
+#define GRAPHENE_NET_MIN_SYNC_BLOCK_LAG_MS                   500
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -85,6 +85,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    get_compact_block_transactions_message_type  = 5019,
+    compact_block_transactions_message_type      = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -114,6 +117,61 @@ namespace graphene { namespace net {
 
    };
 
+   /// @return the short id of a transaction in a compact block, the first 8 bytes of its id
+   uint64_t get_compact_block_short_id( const transaction_id_type& trx_id );
+
+   /// A transaction of a compact block, the receiver looks it up by its short id in the transactions it has seen
+   struct compact_block_transaction
+   {
+      uint64_t                                          short_id = 0;
+      std::vector<graphene::protocol::operation_result> operation_results;
+   };
+
+   /**
+    *  A block relayed to a peer which announced support for compact blocks in its hello message: the header,
+    *  including the witness signature, and the short ids of the transactions.  The receiver rebuilds the block
+    *  from the transactions it already received and requests the others with a
+    *  @ref get_compact_block_transactions_message.
+    */
+   struct compact_block_message
+   {
+      static const core_message_type_enum type;
+
+      compact_block_message(){}
+      compact_block_message( const block_message& full_block, const item_hash_t& full_block_message_hash );
+
+      /// Hash of the full @ref block_message, which was advertised and requested
+      item_hash_t                               item_hash;
+      graphene::protocol::signed_block_header   header;
+      block_id_type                             block_id;
+      std::vector<compact_block_transaction>    transactions;
+   };
+
+   /// Requests the transactions of a compact block the receiver could not find, by their index in the block
+   struct get_compact_block_transactions_message
+   {
+      static const core_message_type_enum type;
+
+      get_compact_block_transactions_message(){}
+      get_compact_block_transactions_message( const item_hash_t& item_hash, const block_id_type& block_id,
+                                             std::vector<uint32_t> indexes )
+      :item_hash(item_hash),block_id(block_id),indexes(std::move(indexes)){}
+
+      /// Hash of the full @ref block_message the compact block was sent for
+      item_hash_t            item_hash;
+      block_id_type          block_id;
+      std::vector<uint32_t>  indexes;
+   };
+
+   /// The transactions requested by a @ref get_compact_block_transactions_message, in the requested order
+   struct compact_block_transactions_message
+   {
+      static const core_message_type_enum type;
+
+      block_id_type                                          block_id;
+      std::vector<graphene::protocol::processed_transaction> transactions;
+   };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -422,6 +480,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (get_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
                  (core_message_type_last) )
 FC_REFLECT_ENUM(graphene::net::rejection_reason_code, (unspecified)
                                                  (different_chain)
@@ -443,6 +504,10 @@ FC_REFLECT_ENUM(graphene::net::firewall_check_result, (unable_to_check)
 
 FC_REFLECT_TYPENAME( graphene::net::trx_message )
 FC_REFLECT_TYPENAME( graphene::net::block_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transaction )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message )
+FC_REFLECT_TYPENAME( graphene::net::get_compact_block_transactions_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transactions_message )
 FC_REFLECT_TYPENAME( graphene::net::item_id )
 FC_REFLECT_TYPENAME( graphene::net::item_ids_inventory_message )
 FC_REFLECT_TYPENAME( graphene::net::blockchain_item_ids_inventory_message )
@@ -466,6 +531,10 @@ FC_REFLECT_TYPENAME( graphene::net::get_current_connections_reply_message )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::get_compact_block_transactions_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transactions_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
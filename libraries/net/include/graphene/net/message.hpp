@@ -24,6 +24,9 @@
 #pragma once
 #include <boost/endian/buffers.hpp>
 
+#include <algorithm>
+#include <memory>
+
 #include <graphene/protocol/types.hpp>
 
 #include <fc/io/varint.hpp>
@@ -51,22 +54,65 @@ namespace graphene { namespace net {
 
   using message_hash_type = fc::ripemd160;
 
+  /**
+   *  The immutable, reference counted payload of a message.
+   *
+   *  Copies of a message share one buffer, so a message that is broadcast to all peers, kept in the message cache
+   *  and sitting in the send queues of the peers is stored once.  The buffer is never modified after it was
+   *  created, to change the payload a new buffer has to be assigned.
+   */
+  class message_payload
+  {
+     public:
+        message_payload() = default;
+        message_payload( std::vector<char>&& bytes )
+        :_bytes( std::make_shared<const std::vector<char>>( std::move(bytes) ) ){}
+        message_payload( const std::vector<char>& bytes )
+        :_bytes( std::make_shared<const std::vector<char>>( bytes ) ){}
+
+        const char* data()const { return _bytes ? _bytes->data() : nullptr; }
+        size_t      size()const { return _bytes ? _bytes->size() : 0; }
+        bool        empty()const { return size() == 0; }
+
+        std::vector<char>::const_iterator begin()const { return bytes().begin(); }
+        std::vector<char>::const_iterator end()const { return bytes().end(); }
+        char operator[]( size_t i )const { return (*_bytes)[i]; }
+
+        /// @return the payload, an empty vector if there is none
+        const std::vector<char>& bytes()const;
+
+        /// @return the number of messages sharing this payload
+        long use_count()const { return _bytes.use_count(); }
+
+     private:
+        std::shared_ptr<const std::vector<char>> _bytes;
+  };
+
+  inline bool operator == ( const message_payload& a, const message_payload& b )
+  {
+     return a.size() == b.size() && std::equal( a.begin(), a.end(), b.begin() );
+  }
+
   /**
    *  Abstracts the process of packing/unpacking a message for a
    *  particular channel.
    */
   struct message : public message_header
   {
-     std::vector<char> data;
+     message_payload data;
 
      message(){}
 
      message( message&& m )
      :message_header(m),data( std::move(m.data) ){}
 
+     /// The copy shares the payload of @p m
      message( const message& m )
      :message_header(m),data( m.data ){}
 
+     message& operator=( message&& m ) = default;
+     message& operator=( const message& m ) = default;
+
      /**
       *  Assumes that T::type specifies the message type
       */
@@ -116,6 +162,29 @@ namespace graphene { namespace net {
 
 } } // graphene::net
 
+namespace fc {
+   void to_variant( const graphene::net::message_payload& p, variant& v, uint32_t max_depth );
+   void from_variant( const variant& v, graphene::net::message_payload& p, uint32_t max_depth );
+
+   namespace raw {
+      template<typename Stream>
+      inline void pack( Stream& s, const graphene::net::message_payload& p,
+                        uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+      {
+         pack( s, p.bytes(), _max_depth );
+      }
+      template<typename Stream>
+      inline void unpack( Stream& s, graphene::net::message_payload& p,
+                          uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+      {
+         std::vector<char> bytes;
+         unpack( s, bytes, _max_depth );
+         p = std::move(bytes);
+      }
+   }
+}
+
+FC_REFLECT_TYPENAME( graphene::net::message_payload )
 FC_REFLECT_TYPENAME( graphene::net::message_header )
 FC_REFLECT_TYPENAME( graphene::net::message )
 
@@ -37,6 +37,7 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <array>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -54,6 +55,60 @@ namespace graphene { namespace net
       virtual message get_message_for_item(const item_id& item) = 0;
     };
 
+    /**
+     * Decides in which order the lanes of a peer's send queue are sent.  The messages waiting to be sent
+     * are kept in lanes, so a new block doesn't wait behind the transactions queued before it.  The block
+     * lane, which also carries the small control messages, is always drained first.  The sync and
+     * transaction lanes share the rest of the connection by deficit round robin.  Each lane has its own
+     * budget of queued bytes.
+     *
+     * Only the sizes of the lanes are kept here, the messages themselves are kept by the peer_connection.
+     */
+    class send_lane_scheduler
+    {
+    public:
+      enum lane
+      {
+        block_lane,
+        sync_lane,
+        transaction_lane,
+        lane_count
+      };
+
+      /// @return the maximum number of bytes that may be queued in @p l
+      static size_t get_budget_in_bytes(lane l);
+      /// @return the bytes @p l may send in one round robin turn, 0 for the block lane
+      static int64_t get_quantum_in_bytes(lane l);
+
+      /** @return the lane for a block, compact block or block item.  While the peer is syncing from us
+       * or the sync lane isn't empty, that is the sync lane.  Otherwise it is the block lane, which is
+       * drained first, so it can't overtake the blocks queued before it and the peer gets all blocks in order
+       */
+      lane get_block_lane(bool peer_is_syncing) const;
+      /// @return whether a message taking @p size_in_queue bytes fits in what is left of the budget of @p l
+      bool has_room(lane l, size_t size_in_queue) const;
+      void on_queued(lane l, size_t size_in_queue);
+      /// sets @p l to the lane to send from next, @return false if all lanes are empty
+      bool select(lane& l);
+      /// the first message of @p l, which took @p size_in_queue bytes while queued, was sent as @p bytes_sent
+      void on_sent(lane l, size_t size_in_queue, size_t bytes_sent);
+
+      size_t get_queued_bytes(lane l) const    { return _lanes[l].queued_bytes; }
+      size_t get_queued_messages(lane l) const { return _lanes[l].queued_messages; }
+
+    private:
+      struct lane_state
+      {
+        size_t  queued_messages = 0;
+        size_t  queued_bytes = 0;
+        /// bytes the lane may still send in its current round robin turn
+        int64_t deficit = 0;
+      };
+      std::array<lane_state, lane_count> _lanes;
+      /// the lane whose turn it is among the sync and transaction lanes
+      lane _fair_lane = sync_lane;
+    };
+
     using peer_connection_ptr = std::shared_ptr<peer_connection>;
     class peer_connection : public message_oriented_connection_delegate,
                             public std::enable_shared_from_this<peer_connection>
@@ -115,8 +170,10 @@ namespace graphene { namespace net
         virtual ~queued_message() = default;
       };
 
-      /* when you queue up a 'real_queued_message', a full copy of the message is
-       * stored on the heap until it is sent
+      /* when you queue up a 'real_queued_message', a copy of the message is
+       * stored on the heap until it is sent.  The copy shares the payload with
+       * the message it was made from, so a message queued for many peers is
+       * stored once
        */
       struct real_queued_message : queued_message
       {
@@ -150,8 +207,11 @@ namespace graphene { namespace net
       };
 
 
-      size_t _total_queued_messages_size = 0;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      /// the messages waiting to be sent, by lane, see send_lane_scheduler
+      using send_lane = send_lane_scheduler::lane;
+      std::array<std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > >,
+                 send_lane_scheduler::lane_count> _queued_messages;
+      send_lane_scheduler _send_lanes;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -190,6 +250,8 @@ namespace graphene { namespace net
       fc::optional<fc::time_point_sec> fc_git_revision_unix_timestamp;
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
+      /// Whether the peer announced in its hello message that it accepts blocks as compact_block_message
+      bool supports_compact_blocks = false;
 
       // Initially, these fields record info about our local socket,
       // they are useless (except the remote_inbound_endpoint field for outbound connections).
@@ -223,8 +285,15 @@ namespace graphene { namespace net
       /// The time we received the last sync item or the time we sent the last batch of sync item requests
       /// to this peer
       fc::time_point last_sync_item_received_time;
-      /// IDs of blocks we've requested from this peer during sync. Fetch from another peer if this peer disconnects
-      std::set<item_hash_t> sync_items_requested_from_peer;
+      /// IDs of blocks we've requested from this peer during sync, with the time each request was sent.
+      /// Fetch from another peer if this peer disconnects
+      std::map<item_hash_t, fc::time_point> sync_items_requested_from_peer;
+      /// The time this peer delivered the last sync block we requested from it
+      fc::time_point last_sync_item_delivered_time;
+      /// Moving average of the rate at which this peer delivered the sync blocks we requested, in blocks per
+      /// second, 0 until the first one arrived.  Each block is timed from its request, or from the delivery of
+      /// the block before it if that came later, so the time the peer had nothing to send doesn't count
+      double sync_blocks_per_second = 0;
       /// The hash of the last block  this peer has told us about that the peer knows
       item_hash_t last_block_delegate_has_seen;
       fc::time_point_sec last_block_time_delegate_has_seen;
@@ -261,6 +330,17 @@ namespace graphene { namespace net
       /// Items we've requested from this peer during normal operation.
       /// Fetch from another peer if this peer disconnects
       item_to_time_map_type items_requested_from_peer;
+
+      /// A compact block received from this peer, waiting for the transactions we didn't have
+      struct partial_compact_block
+      {
+        item_hash_t           item_hash;
+        signed_block          block;
+        std::vector<uint32_t> missing_transactions;
+        /// Set when all transactions were requested, because the block rebuilt from ours didn't match
+        bool                  all_transactions_requested = false;
+      };
+      std::map<block_id_type, partial_compact_block> compact_blocks_being_rebuilt;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -298,7 +378,7 @@ namespace graphene { namespace net
       void on_message(message_oriented_connection* originating_connection, const message& received_message) override;
       void on_connection_closed(message_oriented_connection* originating_connection) override;
 
-      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
+      void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send, send_lane lane);
       virtual void send_message( const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1 );
       void send_item(const item_id& item_to_send);
       void close_connection();
@@ -325,6 +405,8 @@ namespace graphene { namespace net
       bool is_inventory_advertised_to_us_list_full() const;
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
     private:
+      send_lane get_send_lane(const message& message_to_send) const;
+      send_lane get_send_lane(const item_id& item_to_send) const;
       void send_queued_messages_task();
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
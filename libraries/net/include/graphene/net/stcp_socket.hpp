@@ -26,6 +26,9 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace graphene { namespace net {
 
 /**
@@ -50,14 +53,27 @@ class stcp_socket : public virtual fc::iostream
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
 
+    /**
+     *  Encrypts and writes the concatenation of @p buffers, padded with zeros to a multiple of 16 bytes.
+     *  The buffers are encrypted directly into the write buffer, so a message doesn't need to be assembled
+     *  in a buffer of its own first.
+     */
+    void             write_padded( const std::vector<std::pair<const char*, size_t>>& buffers );
+
     virtual void     flush();
     virtual void     close();
 
     using istream::get;
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
+
+    /// The read and write buffers grow with the requested lengths up to max_buffer_length, large messages
+    /// are transferred in chunks of this size
+    static constexpr size_t min_buffer_length = 4096;
+    static constexpr size_t max_buffer_length = 64 * 1024;
   private:
     void do_key_exchange();
+    static void reserve_buffer( std::shared_ptr<char>& buffer, size_t& buffer_length, size_t length );
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
@@ -65,7 +81,9 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
+    size_t                _read_buffer_length = 0;
     std::shared_ptr<char> _write_buffer;
+    size_t                _write_buffer_length = 0;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
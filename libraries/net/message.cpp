@@ -25,6 +25,32 @@
 
 #include <graphene/net/message.hpp>
 
+namespace graphene { namespace net {
+
+   const std::vector<char>& message_payload::bytes()const
+   {
+      static const std::vector<char> no_bytes;
+      return _bytes ? *_bytes : no_bytes;
+   }
+
+} } // graphene::net
+
+namespace fc {
+
+   void to_variant( const graphene::net::message_payload& p, variant& v, uint32_t max_depth )
+   {
+      to_variant( p.bytes(), v, max_depth );
+   }
+
+   void from_variant( const variant& v, graphene::net::message_payload& p, uint32_t max_depth )
+   {
+      std::vector<char> bytes;
+      from_variant( v, bytes, max_depth );
+      p = std::move(bytes);
+   }
+
+} // fc
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message_header, BOOST_PP_SEQ_NIL, (size)(msg_type) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message, (graphene::net::message_header), (data) )
 
@@ -29,6 +29,7 @@
 #include <forward_list>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #include <tuple>
 #include <string>
 #include <boost/tuple/tuple.hpp>
@@ -113,6 +114,35 @@ namespace graphene { namespace net { namespace detail {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
    }
 
+   message blockchain_tied_message_cache::get_message_by_contents_hash(
+         const message_hash_type& hash_of_msg_contents_to_lookup, uint32_t msg_type ) const
+   {
+      const auto& contents_index = _message_cache.get<message_contents_hash_index>();
+      for( auto iter = contents_index.find( hash_of_msg_contents_to_lookup );
+           iter != contents_index.end() && iter->message_contents_hash == hash_of_msg_contents_to_lookup; ++iter )
+      {
+         if( iter->message_body.msg_type.value() == msg_type )
+            return iter->message_body;
+      }
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+   }
+
+   fc::optional<message> blockchain_tied_message_cache::get_transaction_message( uint64_t short_id ) const
+   {
+      // the short id is a prefix of the transaction id, the contents hash of a transaction message
+      message_hash_type lower_bound;
+      memcpy( lower_bound.data(), &short_id, sizeof(short_id) );
+      const auto& contents_index = _message_cache.get<message_contents_hash_index>();
+      for( auto iter = contents_index.lower_bound( lower_bound );
+           iter != contents_index.end() && memcmp( iter->message_contents_hash.data(), &short_id, sizeof(short_id) ) == 0;
+           ++iter )
+      {
+         if( iter->message_body.msg_type.value() == trx_message_type )
+            return iter->message_body;
+      }
+      return fc::optional<message>();
+   }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data(
              const message_hash_type& hash_of_msg_contents_to_lookup ) const
     {
@@ -518,9 +548,10 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting item ${item_hash} from peer ${endpoint}", ("item_hash", item_to_request )("endpoint", peer->get_remote_endpoint() ) );
       item_id item_id_to_request( graphene::net::block_message_type, item_to_request );
-      _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
-      peer->last_sync_item_received_time = fc::time_point::now();
-      peer->sync_items_requested_from_peer.insert(item_to_request);
+      const fc::time_point now = fc::time_point::now();
+      _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, now ) );
+      peer->last_sync_item_received_time = now;
+      peer->sync_items_requested_from_peer[item_to_request] = now;
       peer->send_message( fetch_items_message(item_id_to_request.item_type, std::vector<item_hash_t>{item_id_to_request.item_hash} ) );
     }
 
@@ -529,15 +560,110 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      const fc::time_point now = fc::time_point::now();
       for (const item_hash_t& item_to_request : items_to_request)
       {
-        _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
-        peer->last_sync_item_received_time = fc::time_point::now();
-        peer->sync_items_requested_from_peer.insert(item_to_request);
+        _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, now ) );
+        peer->last_sync_item_received_time = now;
+        peer->sync_items_requested_from_peer[item_to_request] = now;
       }
       peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
     }
 
+    bool node_impl::is_sync_item_requested_from_other_peer( const item_hash_t& item_hash,
+                                                             const peer_connection* peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
+      for( const peer_connection_ptr& other_peer : _active_connections )
+      {
+        if( other_peer.get() != peer &&
+            other_peer->sync_items_requested_from_peer.find(item_hash) != other_peer->sync_items_requested_from_peer.end() )
+          return true;
+      }
+      return false;
+    }
+
+    bool node_impl::is_sync_item_obsolete( const item_hash_t& item_hash )
+    {
+      VERIFY_CORRECT_THREAD();
+      if( have_already_received_sync_item(item_hash) )
+        return true;
+      {
+        fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
+        for( const peer_connection_ptr& peer : _active_connections )
+        {
+          if( peer->ids_of_items_being_processed.find(item_hash) != peer->ids_of_items_being_processed.end() )
+            return true;
+        }
+      }
+      return _delegate->has_item( item_id(graphene::net::block_message_type, item_hash) );
+    }
+
+    size_t node_impl::get_sync_blocks_per_peer_limit( const peer_connection_ptr& peer, double best_rate ) const
+    {
+      // a peer that hasn't delivered any block yet gets a full batch, so that its rate gets measured
+      if( peer->sync_blocks_per_second <= 0 || best_rate <= 0 )
+        return _max_sync_blocks_per_peer;
+      return std::max<size_t>( 1, (size_t)( _max_sync_blocks_per_peer * peer->sync_blocks_per_second / best_rate ) );
+    }
+
+    void node_impl::request_lagging_sync_items()
+    {
+      VERIFY_CORRECT_THREAD();
+      // the block we need to push next is the first one in the lists of the peers, if the peer we requested
+      // it from is slow in delivering it, everything behind it waits, so ask the fastest other peer too
+      const fc::time_point now = fc::time_point::now();
+      std::map<item_hash_t, peer_connection_ptr> sync_item_requests_to_send;
+      {
+        fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
+        for( const peer_connection_ptr& peer : _active_connections )
+        {
+          if( peer->ids_of_items_to_get.empty() )
+            continue;
+          const item_hash_t& next_item = peer->ids_of_items_to_get.front();
+          if( peer->sync_items_requested_from_peer.find(next_item) == peer->sync_items_requested_from_peer.end() ||
+              _sync_items_requested_again.find(next_item) != _sync_items_requested_again.end() ||
+              sync_item_requests_to_send.find(next_item) != sync_item_requests_to_send.end() )
+            continue;
+          auto request_iter = _active_sync_requests.find(next_item);
+          if( request_iter == _active_sync_requests.end() )
+            continue;
+          fc::microseconds lag_limit = fc::milliseconds(GRAPHENE_NET_MIN_SYNC_BLOCK_LAG_MS);
+          if( peer->sync_blocks_per_second > 0 )
+            lag_limit = std::max( lag_limit, fc::microseconds( (int64_t)( 4000000 / peer->sync_blocks_per_second ) ) );
+          if( now - request_iter->second < lag_limit )
+            continue;
+
+          peer_connection_ptr best_peer;
+          for( const peer_connection_ptr& other_peer : _active_connections )
+          {
+            if( other_peer != peer &&
+                other_peer->we_need_sync_items_from_peer &&
+                !other_peer->inhibit_fetching_sync_blocks &&
+                !other_peer->ids_of_items_to_get.empty() &&
+                other_peer->ids_of_items_to_get.front() == next_item &&
+                other_peer->sync_items_requested_from_peer.find(next_item) == other_peer->sync_items_requested_from_peer.end() &&
+                ( !best_peer || other_peer->sync_blocks_per_second > best_peer->sync_blocks_per_second ) )
+              best_peer = other_peer;
+          }
+          if( best_peer )
+          {
+            dlog( "sync item ${item} requested from peer ${slow} ${lag} us ago, requesting it from peer ${fast} too",
+                  ("item", next_item)("slow", peer->get_remote_endpoint())
+                  ("lag", (now - request_iter->second).count())("fast", best_peer->get_remote_endpoint()) );
+            sync_item_requests_to_send[next_item] = best_peer;
+          }
+        }
+      } // end non-preemptable section
+
+      for( const auto& sync_item_request : sync_item_requests_to_send )
+      {
+        _sync_items_requested_again.insert( sync_item_request.first );
+        request_sync_item_from_peer( sync_item_request.second, sync_item_request.first );
+      }
+    }
+
     void node_impl::fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -553,8 +679,23 @@ namespace graphene { namespace net { namespace detail {
           {
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
+            // blocks requested or received but not pushed yet are kept in memory until the blocks before them
+            // arrived, only request as many as fit into the prefetch window.  The next block of a peer is
+            // always requested, otherwise a full window could never drain
+            size_t sync_items_in_window = _received_sync_items.size() + _new_received_sync_items.size()
+                                          + _active_sync_requests.size();
+            size_t free_window = sync_items_in_window < _max_sync_blocks_to_prefetch ?
+                                 _max_sync_blocks_to_prefetch - sync_items_in_window : 0;
+
             fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
+
+            // batches are sized by the rate at which the peers delivered blocks so far
+            double best_rate = 0;
+            for( const peer_connection_ptr& peer : _active_connections )
+              if( peer->we_need_sync_items_from_peer )
+                best_rate = std::max( best_rate, peer->sync_blocks_per_second );
+
+            // for each idle peer that we're syncing with
             for( const peer_connection_ptr& peer : _active_connections )
             {
               if( peer->we_need_sync_items_from_peer &&
@@ -564,9 +705,13 @@ namespace graphene { namespace net { namespace detail {
               {
                 if (!peer->inhibit_fetching_sync_blocks)
                 {
+                  const size_t peer_limit = get_sync_blocks_per_peer_limit( peer, best_rate );
                   // loop through the items it has that we don't yet have on our blockchain
                   for( const auto& item_to_potentially_request : peer->ids_of_items_to_get )
                   {
+                    const bool is_next_item = ( item_to_potentially_request == peer->ids_of_items_to_get.front() );
+                    if( !is_next_item && free_window == 0 )
+                      break;
                     // if we don't already have this item in our temporary storage
                     // and we haven't requested from another syncing peer
                     if( // already got it, but for some reson it's still in our list of items to fetch
@@ -579,7 +724,9 @@ namespace graphene { namespace net { namespace detail {
                       // then schedule a request from this peer
                       sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
                       sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _max_sync_blocks_per_peer)
+                      if( free_window > 0 )
+                        --free_window;
+                      if (sync_item_requests_to_send[peer].size() >= peer_limit)
                         break;
                     }
                   }
@@ -592,6 +739,8 @@ namespace graphene { namespace net { namespace detail {
           for( auto sync_item_request : sync_item_requests_to_send )
             request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
           sync_item_requests_to_send.clear();
+
+          request_lagging_sync_items();
         }
         else
           dlog("fetch_sync_items_loop is suspended pending backlog processing");
@@ -601,7 +750,19 @@ namespace graphene { namespace net { namespace detail {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise
                 = fc::promise<void>::create("graphene::net::retrigger_fetch_sync_items_loop");
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          if( _active_sync_requests.empty() )
+            _retrigger_fetch_sync_items_loop_promise->wait();
+          else
+          {
+            // wake up to check for lagging requests
+            try
+            {
+              _retrigger_fetch_sync_items_loop_promise->wait( fc::milliseconds(GRAPHENE_NET_MIN_SYNC_BLOCK_LAG_MS) );
+            }
+            catch( const fc::timeout_exception& )
+            {
+            }
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
@@ -1439,6 +1600,17 @@ namespace graphene { namespace net { namespace detail {
         break;
       case core_message_type_enum::get_current_connections_reply_message_type:
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::get_compact_block_transactions_message_type:
+        on_get_compact_block_transactions_message(
+              originating_peer, received_message.as<get_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(
+              originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1484,6 +1656,8 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1508,6 +1682,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>(1);
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>(1);
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as<bool>(1);
     }
 
    void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2673,7 +2849,14 @@ namespace graphene { namespace net { namespace detail {
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
                ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+          // the blocks in the cache are the recent ones, their transactions have most likely passed through
+          // the peer already, so send them in compact form if the peer supports it
+          if (fetch_items_message_received.item_type == block_message_type &&
+              requested_message.msg_type.value() == block_message_type &&
+              originating_peer->supports_compact_blocks)
+            reply_messages.push_back(get_compact_block_message(requested_message, item_hash));
+          else
+            reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
           continue;
@@ -2721,10 +2904,198 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    message node_impl::get_compact_block_message( const message& full_block_message,
+                                                  const message_hash_type& full_block_message_hash )
+    {
+      VERIFY_CORRECT_THREAD();
+      if( _last_compact_block_hash != full_block_message_hash || _last_compact_block.data.empty() )
+      {
+        _last_compact_block = compact_block_message( full_block_message.as<graphene::net::block_message>(),
+                                                     full_block_message_hash );
+        _last_compact_block_hash = full_block_message_hash;
+      }
+      return _last_compact_block;
+    }
+
+    void node_impl::on_compact_block_message( peer_connection* originating_peer,
+                                              const compact_block_message& compact_block_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = compact_block_message_received.block_id;
+      if( originating_peer->items_requested_from_peer.find(
+                item_id(block_message_type, compact_block_message_received.item_hash) )
+            == originating_peer->items_requested_from_peer.end() &&
+          originating_peer->sync_items_requested_from_peer.find( block_id )
+            == originating_peer->sync_items_requested_from_peer.end() )
+      {
+        wlog( "received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+              ("endpoint", originating_peer->get_remote_endpoint())("block_id", block_id) );
+        fc::exception detailed_error( FC_LOG_MESSAGE(error, "You sent me a block that I didn't ask for, block_id: ${block_id}",
+                                                     ("block_id", block_id)) );
+        disconnect_from_peer( originating_peer, "You sent me a block that I didn't ask for", true, detailed_error );
+        return;
+      }
+
+      // rebuild the block from the transactions we have seen
+      peer_connection::partial_compact_block partial_block;
+      partial_block.item_hash = compact_block_message_received.item_hash;
+      static_cast<graphene::protocol::signed_block_header&>( partial_block.block ) = compact_block_message_received.header;
+      const auto& compact_transactions = compact_block_message_received.transactions;
+      partial_block.block.transactions.resize( compact_transactions.size() );
+      for( uint32_t i = 0; i < compact_transactions.size(); ++i )
+      {
+        fc::optional<message> trx_message_found = _message_cache.get_transaction_message( compact_transactions[i].short_id );
+        if( trx_message_found )
+          partial_block.block.transactions[i] = graphene::protocol::processed_transaction(
+                                                      trx_message_found->as<trx_message>().trx );
+        else
+          partial_block.missing_transactions.push_back( i );
+        partial_block.block.transactions[i].operation_results = compact_transactions[i].operation_results;
+      }
+      dlog( "received compact block ${block_id} from peer ${endpoint}, missing ${missing} of ${count} transactions",
+            ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint())
+            ("missing", partial_block.missing_transactions.size())("count", compact_transactions.size()) );
+
+      if( partial_block.missing_transactions.empty() )
+        process_rebuilt_compact_block( originating_peer, block_id, std::move( partial_block ) );
+      else
+      {
+        originating_peer->send_message( get_compact_block_transactions_message( partial_block.item_hash, block_id,
+                                                                                partial_block.missing_transactions ) );
+        originating_peer->compact_blocks_being_rebuilt[block_id] = std::move( partial_block );
+      }
+    }
+
+    void node_impl::on_get_compact_block_transactions_message( peer_connection* originating_peer,
+          const get_compact_block_transactions_message& get_compact_block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      // Gatekeeping code
+      if( originating_peer->their_state != peer_connection::their_connection_state::connection_accepted )
+      {
+         wlog( "Unexpected get_compact_block_transactions_message from peer ${peer}, disconnecting",
+               ("peer", originating_peer->get_remote_endpoint()) );
+         disconnect_from_peer( originating_peer, "Received an unexpected get_compact_block_transactions_message" );
+         return;
+      }
+
+      const block_id_type& block_id = get_compact_block_transactions_message_received.block_id;
+      const item_id requested_item( block_message_type, block_id );
+      fc::optional<message> full_block_message;
+      try
+      {
+        full_block_message = _message_cache.get_message_by_contents_hash( block_id, block_message_type );
+      }
+      catch( fc::key_not_found_exception& )
+      {
+        try
+        {
+          full_block_message = _delegate->get_item( requested_item );
+        }
+        catch( fc::key_not_found_exception& )
+        {
+        }
+      }
+      if( !full_block_message )
+      {
+        dlog( "peer ${endpoint} requested transactions of compact block ${block_id} which we don't have",
+              ("endpoint", originating_peer->get_remote_endpoint())("block_id", block_id) );
+        // the peer requested the block by the hash of its message, so it expects that one back
+        originating_peer->send_message( item_not_available_message(
+              item_id( block_message_type, get_compact_block_transactions_message_received.item_hash ) ) );
+        return;
+      }
+
+      const auto full_block = full_block_message->as<graphene::net::block_message>();
+      compact_block_transactions_message reply;
+      reply.block_id = block_id;
+      reply.transactions.reserve( get_compact_block_transactions_message_received.indexes.size() );
+      for( uint32_t index : get_compact_block_transactions_message_received.indexes )
+      {
+        if( index >= full_block.block.transactions.size() )
+        {
+          wlog( "peer ${endpoint} requested transaction ${index} of block ${block_id} which has only ${count}",
+                ("endpoint", originating_peer->get_remote_endpoint())("index", index)("block_id", block_id)
+                ("count", full_block.block.transactions.size()) );
+          disconnect_from_peer( originating_peer, "You requested a transaction that is not in the block" );
+          return;
+        }
+        reply.transactions.push_back( full_block.block.transactions[index] );
+      }
+      originating_peer->send_message( reply );
+    }
+
+    void node_impl::on_compact_block_transactions_message( peer_connection* originating_peer,
+          const compact_block_transactions_message& compact_block_transactions_message_received )
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = compact_block_transactions_message_received.block_id;
+      auto partial_block_iter = originating_peer->compact_blocks_being_rebuilt.find( block_id );
+      if( partial_block_iter == originating_peer->compact_blocks_being_rebuilt.end() )
+      {
+        dlog( "received transactions of compact block ${block_id} from peer ${endpoint} which we don't wait for",
+              ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()) );
+        return;
+      }
+      peer_connection::partial_compact_block partial_block = std::move( partial_block_iter->second );
+      originating_peer->compact_blocks_being_rebuilt.erase( partial_block_iter );
+
+      const auto& transactions = compact_block_transactions_message_received.transactions;
+      if( transactions.size() != partial_block.missing_transactions.size() )
+      {
+        wlog( "peer ${endpoint} sent ${count} transactions of compact block ${block_id}, we requested ${requested}",
+              ("endpoint", originating_peer->get_remote_endpoint())("count", transactions.size())
+              ("block_id", block_id)("requested", partial_block.missing_transactions.size()) );
+        disconnect_from_peer( originating_peer, "You sent me a wrong number of transactions of a compact block" );
+        return;
+      }
+      for( size_t i = 0; i < transactions.size(); ++i )
+        partial_block.block.transactions[ partial_block.missing_transactions[i] ] = transactions[i];
+      partial_block.missing_transactions.clear();
+
+      process_rebuilt_compact_block( originating_peer, block_id, std::move( partial_block ) );
+    }
+
+    void node_impl::process_rebuilt_compact_block( peer_connection* originating_peer, const block_id_type& block_id,
+                                                   peer_connection::partial_compact_block&& partial_block )
+    {
+      VERIFY_CORRECT_THREAD();
+      message rebuilt_message = graphene::net::block_message( partial_block.block );
+      const message_hash_type rebuilt_message_hash = rebuilt_message.id();
+      if( rebuilt_message_hash != partial_block.item_hash && !partial_block.all_transactions_requested )
+      {
+        // a short id matched another transaction than the one in the block, get all of them from the peer
+        dlog( "compact block ${block_id} from peer ${endpoint} doesn't match the transactions we have, "
+              "requesting all of them",
+              ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()) );
+        partial_block.all_transactions_requested = true;
+        partial_block.missing_transactions.resize( partial_block.block.transactions.size() );
+        std::iota( partial_block.missing_transactions.begin(), partial_block.missing_transactions.end(), 0 );
+        originating_peer->send_message( get_compact_block_transactions_message( partial_block.item_hash, block_id,
+                                                                                partial_block.missing_transactions ) );
+        originating_peer->compact_blocks_being_rebuilt[block_id] = std::move( partial_block );
+        return;
+      }
+      // if it still doesn't match, the block is processed as one we didn't ask for or one that is invalid
+      process_block_message( originating_peer, rebuilt_message, rebuilt_message_hash );
+    }
+
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
       const item_id& requested_item = item_not_available_message_received.requested_item;
+      if (requested_item.item_type == block_message_type)
+      {
+        // blocks are requested by the hash of their message, the compact blocks being rebuilt are keyed by block id
+        auto& rebuilt = originating_peer->compact_blocks_being_rebuilt;
+        for( auto partial_block_iter = rebuilt.begin(); partial_block_iter != rebuilt.end(); )
+        {
+          if( partial_block_iter->second.item_hash == requested_item.item_hash )
+            partial_block_iter = rebuilt.erase( partial_block_iter );
+          else
+            ++partial_block_iter;
+        }
+      }
       auto regular_item_iter = originating_peer->items_requested_from_peer.find(requested_item);
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
@@ -2745,7 +3116,11 @@ namespace graphene { namespace net { namespace detail {
       auto sync_item_iter = originating_peer->sync_items_requested_from_peer.find(requested_item.item_hash);
       if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
       {
-        _active_sync_requests.erase(*sync_item_iter);
+        if( !is_sync_item_requested_from_other_peer(sync_item_iter->first, originating_peer) )
+        {
+          _active_sync_requests.erase(sync_item_iter->first);
+          _sync_items_requested_again.erase(sync_item_iter->first);
+        }
         originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
 
         if (originating_peer->peer_needs_sync_items_from_us)
@@ -2927,8 +3302,15 @@ namespace graphene { namespace net { namespace detail {
       // received yet, reschedule them to be fetched from another peer
       if (!originating_peer->sync_items_requested_from_peer.empty())
       {
-        for (auto sync_item : originating_peer->sync_items_requested_from_peer)
-          _active_sync_requests.erase(sync_item);
+        for (const auto& sync_item : originating_peer->sync_items_requested_from_peer)
+        {
+          // still requested from another peer if it was requested again because this one lagged
+          if( !is_sync_item_requested_from_other_peer(sync_item.first, originating_peer) )
+          {
+            _active_sync_requests.erase(sync_item.first);
+            _sync_items_requested_again.erase(sync_item.first);
+          }
+        }
         trigger_fetch_sync_items_loop();
       }
 
@@ -3487,15 +3869,39 @@ namespace graphene { namespace net { namespace detail {
         auto sync_item_iter = originating_peer->sync_items_requested_from_peer.find( block_message_to_process.block_id);
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
+          const fc::time_point request_time = sync_item_iter->second;
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           // if exceptions are throw here after removing the sync item from the list (above),
           // it could leave our sync in a stalled state.  Wrap a try/catch around the rest
           // of the function so we can log if this ever happens.
           try
           {
-            originating_peer->last_sync_item_received_time = fc::time_point::now();
+            // the peer worked on this block since we requested it, or since it delivered the block before it
+            // if that was later, the time it had no request from us doesn't count
+            const fc::time_point now = fc::time_point::now();
+            const fc::time_point start_time = std::max( request_time, originating_peer->last_sync_item_delivered_time );
+            const double seconds_for_item = std::max<int64_t>( (now - start_time).count(), 1000 ) / 1000000.0;
+            originating_peer->sync_blocks_per_second = originating_peer->sync_blocks_per_second > 0 ?
+                  ( 3 * originating_peer->sync_blocks_per_second + 1 / seconds_for_item ) / 4 :
+                  1 / seconds_for_item;
+            originating_peer->last_sync_item_received_time = now;
+            originating_peer->last_sync_item_delivered_time = now;
             _active_sync_requests.erase(block_message_to_process.block_id);
-            process_block_during_syncing(originating_peer, block_message_to_process, message_hash);
+
+            // a block requested from two peers is only used from the one delivering it first
+            bool is_duplicate = false;
+            auto again_iter = _sync_items_requested_again.find(block_message_to_process.block_id);
+            if( again_iter != _sync_items_requested_again.end() )
+            {
+              is_duplicate = is_sync_item_obsolete(block_message_to_process.block_id);
+              if( !is_sync_item_requested_from_other_peer(block_message_to_process.block_id, originating_peer) )
+                _sync_items_requested_again.erase(again_iter);
+            }
+            if( is_duplicate )
+              dlog( "dropping sync block ${id} from peer ${endpoint}, it was already delivered by another peer",
+                    ("id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()) );
+            else
+              process_block_during_syncing(originating_peer, block_message_to_process, message_hash);
             if (originating_peer->idle())
             {
               // we have finished fetching a batch of items, so we either need to grab another batch of items
@@ -4834,6 +5240,7 @@ namespace graphene { namespace net { namespace detail {
 
         peer_details["peer_needs_sync_items_from_us"] = peer->peer_needs_sync_items_from_us;
         peer_details["we_need_sync_items_from_peer"] = peer->we_need_sync_items_from_peer;
+        peer_details["sync_blocks_per_second"] = peer->sync_blocks_per_second;
 
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
@@ -229,6 +229,11 @@ public:
                        const message_propagation_data& propagation_data,
                        const message_hash_type& message_content_hash );
    message get_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   message get_message_by_contents_hash( const message_hash_type& hash_of_msg_contents_to_lookup,
+                                         uint32_t msg_type ) const;
+   /// @return the transaction message whose transaction id starts with the compact block @p short_id, if any.
+   ///         Misses are expected, the transaction is then fetched from the peer
+   fc::optional<message> get_transaction_message( uint64_t short_id ) const;
    message_propagation_data get_message_propagation_data(
          const message_hash_type& hash_of_msg_contents_to_lookup ) const;
    size_t size() const { return _message_cache.size(); }
@@ -464,6 +469,9 @@ public:
       /// List of sync blocks we've received, but can't yet process because we are still missing blocks
       /// that come earlier in the chain
       std::list<graphene::net::block_message> _received_sync_items;
+      /// Sync blocks we've requested from a second peer because the first one lagged, the block is pushed
+      /// from whichever peer delivers it first and dropped when the other one delivers it too
+      std::set<item_hash_t>                 _sync_items_requested_again;
       /// @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -550,6 +558,11 @@ public:
       /// The /n/ most recent blocks we've accepted (currently tuned to the max number of connections)
       boost::circular_buffer<item_hash_t> _most_recent_blocks_accepted { _maximum_number_of_connections };
 
+      /// The compact form of the block most recently requested by peers supporting compact blocks, which is
+      /// usually requested by all of them, and the hash of its full block message
+      message_hash_type _last_compact_block_hash;
+      message           _last_compact_block;
+
       uint32_t _sync_item_type = 0;
       /// The number of items we still need to fetch while syncing
       uint32_t _total_num_of_unfetched_items = 0;
@@ -644,6 +657,10 @@ public:
       void trigger_p2p_network_connect_loop();
 
       bool have_already_received_sync_item( const item_hash_t& item_hash );
+      bool is_sync_item_requested_from_other_peer( const item_hash_t& item_hash, const peer_connection* peer ) const;
+      bool is_sync_item_obsolete( const item_hash_t& item_hash );
+      size_t get_sync_blocks_per_peer_limit( const peer_connection_ptr& peer, double best_rate ) const;
+      void request_lagging_sync_items();
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
       void fetch_sync_items_loop();
@@ -709,6 +726,17 @@ public:
       void on_item_ids_inventory_message( peer_connection* originating_peer,
                                           const item_ids_inventory_message& item_ids_inventory_message_received );
 
+      message get_compact_block_message( const message& full_block_message,
+                                         const message_hash_type& full_block_message_hash );
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+      void on_get_compact_block_transactions_message( peer_connection* originating_peer,
+            const get_compact_block_transactions_message& get_compact_block_transactions_message_received );
+      void on_compact_block_transactions_message( peer_connection* originating_peer,
+            const compact_block_transactions_message& compact_block_transactions_message_received );
+      void process_rebuilt_compact_block( peer_connection* originating_peer, const block_id_type& block_id,
+                                          peer_connection::partial_compact_block&& partial_block );
+
       void on_closing_connection_message( peer_connection* originating_peer,
                                           const closing_connection_message& closing_connection_message_received );
 
@@ -44,16 +44,97 @@
 
 namespace graphene { namespace net
   {
+    size_t send_lane_scheduler::get_budget_in_bytes(lane l)
+    {
+      switch (l)
+      {
+      case block_lane:
+        return GRAPHENE_NET_MAXIMUM_QUEUED_BLOCK_MESSAGES_IN_BYTES;
+      case sync_lane:
+        return GRAPHENE_NET_MAXIMUM_QUEUED_SYNC_MESSAGES_IN_BYTES;
+      default:
+        return GRAPHENE_NET_MAXIMUM_QUEUED_TRANSACTION_MESSAGES_IN_BYTES;
+      }
+    }
+
+    int64_t send_lane_scheduler::get_quantum_in_bytes(lane l)
+    {
+      switch (l)
+      {
+      case sync_lane:
+        return 2 * GRAPHENE_NET_SEND_QUEUE_QUANTUM_IN_BYTES;
+      case transaction_lane:
+        return GRAPHENE_NET_SEND_QUEUE_QUANTUM_IN_BYTES;
+      default:
+        return 0;
+      }
+    }
+
+    send_lane_scheduler::lane send_lane_scheduler::get_block_lane(bool peer_is_syncing) const
+    {
+      if (peer_is_syncing || _lanes[sync_lane].queued_messages > 0)
+        return sync_lane;
+      return block_lane;
+    }
+
+    bool send_lane_scheduler::has_room(lane l, size_t size_in_queue) const
+    {
+      return _lanes[l].queued_bytes + size_in_queue <= get_budget_in_bytes(l);
+    }
+
+    void send_lane_scheduler::on_queued(lane l, size_t size_in_queue)
+    {
+      ++_lanes[l].queued_messages;
+      _lanes[l].queued_bytes += size_in_queue;
+    }
+
+    bool send_lane_scheduler::select(lane& l)
+    {
+      if (_lanes[block_lane].queued_messages > 0)
+      {
+        l = block_lane;
+        return true;
+      }
+      if (_lanes[sync_lane].queued_messages == 0 && _lanes[transaction_lane].queued_messages == 0)
+        return false;
+      // deficit round robin, a lane keeps its turn until it has sent its quantum or is empty
+      for (;;)
+      {
+        lane_state& current = _lanes[_fair_lane];
+        if (current.queued_messages > 0 && current.deficit > 0)
+        {
+          l = _fair_lane;
+          return true;
+        }
+        if (current.queued_messages == 0)
+          current.deficit = 0;
+        _fair_lane = _fair_lane == sync_lane ? transaction_lane : sync_lane;
+        _lanes[_fair_lane].deficit += get_quantum_in_bytes(_fair_lane);
+      }
+    }
+
+    void send_lane_scheduler::on_sent(lane l, size_t size_in_queue, size_t bytes_sent)
+    {
+      --_lanes[l].queued_messages;
+      _lanes[l].queued_bytes -= size_in_queue;
+      // the turn is charged with the bytes actually sent, items are only hashes while queued
+      if (l != block_lane)
+        _lanes[l].deficit -= static_cast<int64_t>(bytes_sent);
+    }
+
     message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
         // patch the current time into the message.  Since this operates on the packed version of the structure,
-        // it won't work for anything after a variable-length field
+        // it won't work for anything after a variable-length field.  The payload is shared, so it is patched
+        // in a copy, this is only done for the small time messages
         std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
         assert(message_send_time_field_offset + packed_current_time.size() <= message_to_send.data.size());
-        memcpy(message_to_send.data.data() + message_send_time_field_offset,
+        std::vector<char> patched_data = message_to_send.data.bytes();
+        memcpy(patched_data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
+        message_to_send.data = std::move(patched_data);
       }
       return message_to_send;
     }
@@ -74,7 +155,6 @@ namespace graphene { namespace net
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
       _message_connection(this),
-      _total_queued_messages_size(0),
       direction(peer_connection_direction::unknown),
       our_state(our_connection_state::disconnected),
       they_have_requested_close(false),
@@ -321,6 +401,39 @@ namespace graphene { namespace net
       _node->on_connection_closed( this );
     }
 
+    peer_connection::send_lane peer_connection::get_send_lane(const message& message_to_send) const
+    {
+      switch (message_to_send.msg_type.value())
+      {
+      case trx_message_type:
+        return send_lane_scheduler::transaction_lane;
+      case block_message_type:
+      case compact_block_message_type:
+        return _send_lanes.get_block_lane(peer_needs_sync_items_from_us);
+      case blockchain_item_ids_inventory_message_type:
+      case fetch_blockchain_item_ids_message_type:
+        return send_lane_scheduler::sync_lane;
+      case item_ids_inventory_message_type:
+      {
+        // only the item type is needed, it is the first field of the message
+        uint32_t item_type;
+        fc::datastream<const char*> ds(message_to_send.data.data(), message_to_send.data.size());
+        fc::raw::unpack(ds, item_type);
+        return item_type == block_message_type ? send_lane_scheduler::block_lane
+                                               : send_lane_scheduler::transaction_lane;
+      }
+      default:
+        return send_lane_scheduler::block_lane;
+      }
+    }
+
+    peer_connection::send_lane peer_connection::get_send_lane(const item_id& item_to_send) const
+    {
+      if (item_to_send.item_type != block_message_type)
+        return send_lane_scheduler::transaction_lane;
+      return _send_lanes.get_block_lane(peer_needs_sync_items_from_us);
+    }
+
     void peer_connection::send_queued_messages_task()
     {
       VERIFY_CORRECT_THREAD();
@@ -331,10 +444,13 @@ namespace graphene { namespace net
         ~counter() { assert(_send_message_queue_tasks_counter == 1); --_send_message_queue_tasks_counter; /* dlog("leaving peer_connection::send_queued_messages_task()"); */ }
       } concurrent_invocation_counter(_send_message_queue_tasks_running);
 #endif
-      while (!_queued_messages.empty())
+      send_lane lane;
+      while (_send_lanes.select(lane))
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // messages are only ever appended to a lane while this one is being sent, so it stays at the front
+        auto& lane_queue = _queued_messages[lane];
+        lane_queue.front()->transmission_start_time = fc::time_point::now();
+        message message_to_send = lane_queue.front()->get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
@@ -370,22 +486,24 @@ namespace graphene { namespace net
         {
           wlog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        lane_queue.front()->transmission_finish_time = fc::time_point::now();
+        _send_lanes.on_sent(lane, lane_queue.front()->get_size_in_queue(),
+                            sizeof(message_header) + message_to_send.size.value());
+        lane_queue.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
-    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send)
+    void peer_connection::send_queueable_message(std::unique_ptr<queued_message>&& message_to_send, send_lane lane)
     {
       VERIFY_CORRECT_THREAD();
-      _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
-      if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
+      const size_t size_in_queue = message_to_send->get_size_in_queue();
+      if (!_send_lanes.has_room(lane, size_in_queue))
       {
-        wlog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
-             ("max", GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)("current", _total_queued_messages_size));
+        wlog("send lane ${lane} has no room for a message of ${size} bytes, ${queued} of its ${budget} bytes "
+             "are queued already",
+             ("lane", (uint32_t)lane)("size", size_in_queue)("queued", _send_lanes.get_queued_bytes(lane))
+             ("budget", send_lane_scheduler::get_budget_in_bytes(lane)));
         try
         {
           close_connection();
@@ -396,6 +514,8 @@ namespace graphene { namespace net
         }
         return;
       }
+      _send_lanes.on_queued(lane, size_in_queue);
+      _queued_messages[lane].emplace(std::move(message_to_send));
 
       if( _send_queued_messages_done.valid() && _send_queued_messages_done.canceled() )
         FC_THROW_EXCEPTION(fc::exception, "Attempting to send a message on a connection that is being shut down");
@@ -414,9 +534,20 @@ namespace graphene { namespace net
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint())); // for debug
+      const send_lane lane = get_send_lane(message_to_send);
       auto message_to_enqueue = std::make_unique<real_queued_message>(
                                       message_to_send, message_send_time_field_offset );
-      send_queueable_message(std::move(message_to_enqueue));
+      // inventory is only a hint, when it doesn't fit the peer learns about the items from its other connections
+      if (message_to_send.msg_type.value() == item_ids_inventory_message_type &&
+          !_send_lanes.has_room(lane, message_to_enqueue->get_size_in_queue()))
+      {
+        dlog("send lane ${lane} has no room for an inventory message of ${size} bytes, dropping it for peer "
+             "${endpoint}",
+             ("lane", (uint32_t)lane)("size", message_to_enqueue->get_size_in_queue())
+             ("endpoint", get_remote_endpoint()));
+        return;
+      }
+      send_queueable_message(std::move(message_to_enqueue), lane);
     }
 
     void peer_connection::send_item(const item_id& item_to_send)
@@ -425,7 +556,7 @@ namespace graphene { namespace net
       //dlog("peer_connection::send_item() enqueueing message of type ${type} for peer ${endpoint}",
       //     ("type", item_to_send.item_type)("endpoint", get_remote_endpoint())); // for debug
       auto message_to_enqueue = std::make_unique<virtual_queued_message>(item_to_send);
-      send_queueable_message(std::move(message_to_enqueue));
+      send_queueable_message(std::move(message_to_enqueue), get_send_lane(item_to_send));
     }
 
     void peer_connection::close_connection()
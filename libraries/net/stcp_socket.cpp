@@ -36,6 +36,9 @@
 
 namespace graphene { namespace net {
 
+constexpr size_t stcp_socket::min_buffer_length;
+constexpr size_t stcp_socket::max_buffer_length;
+
 stcp_socket::stcp_socket()
 //:_buf_len(0)
 #ifndef NDEBUG
@@ -69,6 +72,17 @@ void stcp_socket::do_key_exchange()
 }
 
 
+void stcp_socket::reserve_buffer( std::shared_ptr<char>& buffer, size_t& buffer_length, size_t length )
+{
+  const size_t wanted_length = std::min( std::max( length, min_buffer_length ), max_buffer_length );
+  if( !buffer || buffer_length < wanted_length )
+  {
+    // a pending operation on the old buffer keeps it alive
+    buffer.reset( new char[wanted_length], [](char* p){ delete[] p; } );
+    buffer_length = wanted_length;
+  }
+}
+
 void stcp_socket::connect_to( const fc::ip::endpoint& remote_endpoint )
 {
   _sock.connect_to( remote_endpoint );
@@ -100,11 +114,8 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
-    if (!_read_buffer)
-      _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
-
-    len = std::min<size_t>(read_buffer_length, len);
+    reserve_buffer( _read_buffer, _read_buffer_length, len );
+    len = std::min<size_t>(_read_buffer_length, len);
 
     size_t s = _sock.readsome( _read_buffer, len, 0 );
     if( s % 16 ) 
@@ -141,10 +152,8 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
-    if (!_write_buffer)
-      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
-    len = std::min<size_t>(write_buffer_length, len);
+    reserve_buffer( _write_buffer, _write_buffer_length, len );
+    len = std::min<size_t>(_write_buffer_length, len);
     memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
     /**
      * every sizeof(crypt_buf) bytes the aes channel
@@ -163,6 +172,77 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+void stcp_socket::write_padded( const std::vector<std::pair<const char*, size_t>>& buffers )
+{ try {
+#ifndef NDEBUG
+    struct check_buffer_in_use {
+      bool& _buffer_in_use;
+      check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
+      ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
+    } buffer_in_use_checker(_write_buffer_in_use);
+#endif
+
+    size_t total_length = 0;
+    for( const auto& buffer : buffers )
+      total_length += buffer.second;
+    const size_t padded_length = 16 * ((total_length + 15) / 16);
+    if( padded_length == 0 )
+      return;
+    reserve_buffer( _write_buffer, _write_buffer_length, padded_length );
+
+    // the encoder only takes multiples of 16 bytes, the blocks spanning two buffers and the padding are
+    // assembled in carry, everything else is encrypted straight from the buffers
+    size_t used_length = 0;
+    auto encode = [this, &used_length]( const char* plaintext, size_t length ) {
+      while( length > 0 )
+      {
+        const size_t chunk_length = std::min( length, _write_buffer_length - used_length );
+        uint32_t ciphertext_len = _send_aes.encode( plaintext, (uint32_t)chunk_length,
+                                                    _write_buffer.get() + used_length );
+        assert(ciphertext_len == chunk_length);
+        used_length += ciphertext_len;
+        plaintext += chunk_length;
+        length -= chunk_length;
+        if( used_length == _write_buffer_length )
+        {
+          _sock.write( _write_buffer, used_length );
+          used_length = 0;
+        }
+      }
+    };
+
+    char carry[16];
+    size_t carry_length = 0;
+    for( const auto& buffer : buffers )
+    {
+      const char* data = buffer.first;
+      size_t length = buffer.second;
+      if( carry_length > 0 )
+      {
+        const size_t fill_length = std::min( sizeof(carry) - carry_length, length );
+        memcpy( carry + carry_length, data, fill_length );
+        carry_length += fill_length;
+        data += fill_length;
+        length -= fill_length;
+        if( carry_length < sizeof(carry) )
+          continue;
+        encode( carry, sizeof(carry) );
+        carry_length = 0;
+      }
+      const size_t aligned_length = length - length % 16;
+      encode( data, aligned_length );
+      carry_length = length - aligned_length;
+      memcpy( carry, data + aligned_length, carry_length );
+    }
+    if( carry_length > 0 )
+    {
+      memset( carry + carry_length, 0, sizeof(carry) - carry_length );
+      encode( carry, sizeof(carry) );
+    }
+    if( used_length > 0 )
+      _sock.write( _write_buffer, used_length );
+} FC_RETHROW_EXCEPTIONS( warn, "", ("buffers",buffers.size()) ) }
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -39,6 +39,8 @@
 
 #include <fc/thread/thread.hpp>
 
+#include <memory>
+
 namespace graphene { namespace account_history {
 
 namespace detail
@@ -78,6 +80,18 @@ class account_history_plugin_impl
 
       uint32_t _latest_block_number_to_remove = 0;
 
+      uint32_t _history_time_index_interval = 100;
+
+      bool _history_by_operation_type = false;
+      operation_type_history_index* _op_type_history_index = nullptr;
+
+      bool _use_history_store = false;
+      uint32_t _history_store_cache_size = 64;
+      std::shared_ptr<history_store> _history_store;
+
+      /// Opens the history store, or creates an empty one if @p reset is set
+      void open_history_store( bool reset );
+
       uint64_t get_max_ops_to_keep( const account_id_type& account_id );
 
       /** add one history record, then check and remove the earliest history record(s) */
@@ -101,9 +115,21 @@ static T get_biggest_number_to_remove( T biggest_number, T amount_to_keep )
    return ( biggest_number > amount_to_keep ) ? ( biggest_number - amount_to_keep ) : 0;
 }
 
+void account_history_plugin_impl::open_history_store( bool reset )
+{
+   const auto dir = database().get_data_dir() / "account_history";
+   // the history is rebuilt from the first block, the stored history may not match it
+   if( reset )
+      fc::remove_all( dir );
+   std::atomic_store( &_history_store, std::make_shared<history_store>(
+                                          dir, size_t(_history_store_cache_size) * 1024 * 1024 ) );
+}
+
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
 {
    _latest_block_number_to_remove = get_biggest_number_to_remove( b.block_num(), _min_blocks_to_keep );
+   if( _use_history_store && !_history_store )
+      open_history_store( b.block_num() == 1 );
 
    graphene::chain::database& db = database();
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
@@ -238,6 +264,9 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
    }
 
    remove_old_histories();
+
+   if( _history_store )
+      _history_store->flush();
 }
 
 void account_history_plugin_impl::add_account_history( const account_id_type& account_id,
@@ -256,6 +285,15 @@ void account_history_plugin_impl::add_account_history( const account_id_type& ac
        obj.most_recent_op = aho.id;
        obj.total_ops = aho.sequence;
    });
+   // mark the time of every N-th entry
+   if( _history_time_index_interval > 0 && ( aho.sequence - 1 ) % _history_time_index_interval == 0 )
+   {
+      db.create<history_time_mark_object>( [&aho,&op]( history_time_mark_object& obj ){
+         obj.account = aho.account;
+         obj.sequence = aho.sequence;
+         obj.block_time = op.block_time;
+      });
+   }
    // Remove the earliest account history entries if too many.
    remove_old_histories_by_account( stats_obj );
 }
@@ -300,7 +338,8 @@ void account_history_plugin_impl::remove_old_histories()
 
 void account_history_plugin_impl::check_and_remove_op_history_obj( const operation_history_object& op )
 {
-   if( _partial_operations )
+   // the operations that are moved to the history store are not kept in memory
+   if( _partial_operations || _history_store )
    {
       // check for references
       graphene::chain::database& db = database();
@@ -327,6 +366,7 @@ void account_history_plugin_impl::remove_old_histories_by_account( const account
 
    const auto& his_idx = db.get_index_type<account_history_index>();
    const auto& by_seq_idx = his_idx.indices().get<by_seq>();
+   const auto& mark_idx = db.get_index_type<history_time_mark_index>().indices().get<by_seq>();
 
    auto removed_ops = stats_obj.removed_ops;
    // look for the earliest entry if needed
@@ -348,6 +388,22 @@ void account_history_plugin_impl::remove_old_histories_by_account( const account
       if( remove_op.block_num > _latest_block_number_to_remove && removed_ops >= number_of_ops_to_remove_by_blks )
          break;
 
+      if( _history_store )
+      {
+         // only irreversible history is moved to the store, the rest stays in memory until it is
+         if( remove_op.block_num > db.get_dynamic_global_properties().last_irreversible_block_num )
+            break;
+         _history_store->store_operation( remove_op );
+         _history_store->append_account_history( account_id, aho_to_remove.sequence, remove_op.get_id() );
+      }
+      else
+      {
+         // the time of an entry that is dropped is not needed anymore
+         auto mark_itr = mark_idx.find( boost::make_tuple( account_id, aho_to_remove.sequence ) );
+         if( mark_itr != mark_idx.end() )
+            db.remove( *mark_itr );
+      }
+
       // remove the entry
       ++aho_itr;
       db.remove( aho_to_remove );
@@ -449,6 +505,18 @@ void account_history_plugin::plugin_set_program_options(
           "when the min-blocks-to-keep option causes the amount to exceed the limit defined by the "
           "max-ops-per-account option. If this is less than max-ops-per-account, max-ops-per-account will be used. "
           "(default: 1000)")
+         ("history-store", boost::program_options::value<bool>(),
+          "Move the operations that are removed from memory due to the options above to an append-only store "
+          "on disk instead of dropping them, the history API reads them from there. Only operations of "
+          "irreversible blocks are moved. (default: false)")
+         ("history-store-cache-size", boost::program_options::value<uint32_t>(),
+          "Memory in MiB used to cache the pages of the history store (default: 64)")
+         ("history-time-index-interval", boost::program_options::value<uint32_t>(),
+          "Mark the block time of every N-th operation in the history of each account, so the history API finds "
+          "the operations of a time quickly. 0 to disable. (default: 100)")
+         ("history-by-operation-type", boost::program_options::value<bool>(),
+          "Index the account history in memory by operation type, so the history API finds the operations "
+          "of a type without going through the operations of other types (default: false)")
          ;
    cfg.add(cli);
 }
@@ -460,9 +528,13 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
    // connect with group 0 to process before some special steps (e.g. snapshot or next_object_id)
    database().applied_block.connect( 0, [this]( const signed_block& b){ my->update_account_histories(b); } );
    my->_oho_index = database().add_index< primary_index< operation_history_index > >();
-   database().add_index< primary_index< account_history_index > >();
+   auto* aho_index = database().add_index< primary_index< account_history_index > >();
 
    database().add_index< primary_index< exceeded_account_index > >();
+   database().add_index< primary_index< history_time_mark_index > >();
+
+   if( my->_history_by_operation_type )
+      my->_op_type_history_index = aho_index->add_secondary_index< operation_type_history_index >( &database() );
 }
 
 void detail::account_history_plugin_impl::init_program_options(const boost::program_options::variables_map& options)
@@ -484,10 +556,20 @@ void detail::account_history_plugin_impl::init_program_options(const boost::prog
    utilities::get_program_option( options, "max-ops-per-acc-by-min-blocks", _max_ops_per_acc_by_min_blocks );
    if( _max_ops_per_acc_by_min_blocks < _max_ops_per_account )
       _max_ops_per_acc_by_min_blocks = _max_ops_per_account;
+
+   utilities::get_program_option( options, "history-store", _use_history_store );
+   utilities::get_program_option( options, "history-store-cache-size", _history_store_cache_size );
+   utilities::get_program_option( options, "history-time-index-interval", _history_time_index_interval );
+   utilities::get_program_option( options, "history-by-operation-type", _history_by_operation_type );
 }
 
 void account_history_plugin::plugin_startup()
 {
+   if( my->_op_type_history_index != nullptr )
+      my->_op_type_history_index->build();
+   // the store is opened by the first applied block if the chain database was replayed
+   if( my->_use_history_store && !my->_history_store )
+      my->open_history_store( database().head_block_num() == 0 );
 }
 
 flat_set<account_id_type> account_history_plugin::tracked_accounts() const
@@ -495,4 +577,65 @@ flat_set<account_id_type> account_history_plugin::tracked_accounts() const
    return my->_tracked_accounts;
 }
 
+std::shared_ptr<const history_store> account_history_plugin::get_history_store() const
+{
+   return std::atomic_load( &my->_history_store );
+}
+
+const operation_type_history_index* account_history_plugin::get_operation_type_history_index() const
+{
+   return my->_op_type_history_index;
+}
+
+operation_type_history_index::entry operation_type_history_index::make_entry(
+      const account_history_object& aho )const
+{
+   // the operation history objects are not removed while an account history object refers to them
+   const auto op_type = static_cast<uint16_t>( aho.operation_id( *_db ).op.which() );
+   return { aho.account, op_type, aho.sequence, aho.operation_id };
+}
+
+void operation_type_history_index::build()
+{
+   const auto& aho_idx = _db->get_index_type< account_history_index >().indices();
+   _entries.clear();
+   for( const account_history_object& aho : aho_idx )
+      _entries.insert( make_entry( aho ) );
+   _built = true;
+}
+
+void operation_type_history_index::object_inserted( const object& obj )
+{
+   if( _built )
+      _entries.insert( make_entry( static_cast<const account_history_object&>( obj ) ) );
+}
+
+void operation_type_history_index::object_removed( const object& obj )
+{
+   if( !_built )
+      return;
+   const auto& aho = static_cast<const account_history_object&>( obj );
+   _entries.get<by_sequence>().erase( boost::make_tuple( aho.account, aho.sequence ) );
+}
+
+void operation_type_history_index::about_to_modify( const object& before )
+{
+   object_removed( before );
+}
+
+void operation_type_history_index::object_modified( const object& after )
+{
+   object_inserted( after );
+}
+
+std::pair<operation_type_history_index::iterator, operation_type_history_index::iterator>
+operation_type_history_index::get_history( const account_id_type& account, uint16_t op_type,
+                                           uint64_t first_sequence, uint64_t last_sequence )const
+{
+   if( first_sequence > last_sequence )
+      return { _entries.end(), _entries.end() };
+   return { _entries.lower_bound( boost::make_tuple( account, op_type, first_sequence ) ),
+            _entries.upper_bound( boost::make_tuple( account, op_type, last_sequence ) ) };
+}
+
 } }
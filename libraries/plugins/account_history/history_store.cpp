@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_history/history_store.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace account_history {
+
+namespace detail
+{
+
+static const uint64_t page_size = 4096;
+static const uint64_t operations_per_segment = 1 << 20;
+static const uint64_t entries_per_page = page_size / sizeof(uint64_t);
+/// Segments kept open at most, the store only appends to the latest one
+static const size_t max_open_segments = 16;
+
+/// The fixed-width slot of an operation in the index file of its segment
+struct operation_slot
+{
+   uint64_t offset = 0;
+   uint32_t size = 0; ///< 0 if the operation is not stored
+   uint32_t block_num = 0;
+};
+static_assert( sizeof(operation_slot) == 16, "operation slots must not be padded" );
+
+/// Records that a page of the postings file holds a part of the history of an account
+struct posting_page_record
+{
+   uint64_t account;
+   uint64_t page_index; ///< the entries of the page are the sequence numbers from page_index * entries_per_page + 1
+   uint64_t page;       ///< the page in the postings file, or reset_page
+};
+/// Marks that the stored history of the account is dropped, the pages before this record are no longer used
+static const uint64_t reset_page = uint64_t(-1);
+
+class store_file
+{
+   public:
+      void open( const fc::path& path )
+      {
+         const auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+         if( !fc::exists( path ) )
+            _stream.open( path.generic_string().c_str(), mode | std::fstream::trunc );
+         else
+            _stream.open( path.generic_string().c_str(), mode );
+         FC_ASSERT( _stream.is_open(), "Unable to open ${path}", ("path", path) );
+         _stream.seekg( 0, std::fstream::end );
+         _size = _stream.tellg();
+      }
+
+      uint64_t size()const { return _size; }
+
+      /// Reads the page, the part after the end of the file is filled with zeroes
+      void read_page( uint64_t page, char* data )
+      {
+         std::memset( data, 0, page_size );
+         if( page * page_size >= _size )
+            return;
+         _stream.seekg( page * page_size );
+         _stream.read( data, std::min( page_size, _size - page * page_size ) );
+         FC_ASSERT( _stream.good(), "Unable to read from the history store" );
+      }
+
+      void write( uint64_t pos, const char* data, size_t size )
+      {
+         _stream.seekp( pos );
+         _stream.write( data, size );
+         FC_ASSERT( _stream.good(), "Unable to write to the history store" );
+         _size = std::max( _size, pos + size );
+      }
+
+      void flush() { _stream.flush(); }
+
+   private:
+      std::fstream _stream;
+      uint64_t     _size = 0;
+};
+
+/// A least recently used cache of file pages with a bounded number of pages
+class page_cache
+{
+   public:
+      explicit page_cache( size_t cache_size ) : _max_pages( std::max<size_t>( cache_size / page_size, 2 ) ) {}
+
+      /// @return the page of the file, read from @p file if it is not cached
+      const char* get( uint64_t file_id, uint64_t page, store_file& file )
+      {
+         const auto key = std::make_pair( file_id, page );
+         auto itr = _pages.find( key );
+         if( itr != _pages.end() )
+         {
+            _lru.splice( _lru.begin(), _lru, itr->second );
+            return itr->second->second.data();
+         }
+         std::vector<char> data( page_size );
+         file.read_page( page, data.data() );
+         _lru.emplace_front( key, std::move( data ) );
+         _pages[key] = _lru.begin();
+         if( _pages.size() > _max_pages )
+         {
+            _pages.erase( _lru.back().first );
+            _lru.pop_back();
+         }
+         return _lru.front().second.data();
+      }
+
+      /// Drops the cached pages of the file that overlap the written range
+      void invalidate( uint64_t file_id, uint64_t pos, uint64_t size )
+      {
+         for( uint64_t page = pos / page_size; page * page_size < pos + size; ++page )
+         {
+            auto itr = _pages.find( std::make_pair( file_id, page ) );
+            if( itr == _pages.end() )
+               continue;
+            _lru.erase( itr->second );
+            _pages.erase( itr );
+         }
+      }
+
+   private:
+      using key_type = std::pair<uint64_t, uint64_t>;
+      std::list<std::pair<key_type, std::vector<char>>>                        _lru;
+      std::map<key_type, std::list<std::pair<key_type, std::vector<char>>>::iterator> _pages;
+      const size_t                                                               _max_pages;
+};
+
+class history_store_impl
+{
+   public:
+      history_store_impl( const fc::path& dir, size_t cache_size );
+
+      void store_operation( const operation_history_object& op );
+      void append_account_history( const account_id_type& account, uint64_t sequence,
+                                   const operation_history_id_type& op );
+      void flush();
+
+      optional<operation_history_object> get_operation( const operation_history_id_type& id );
+      optional<operation_history_id_type> get_account_history_entry( const account_id_type& account,
+                                                                     uint64_t sequence );
+      uint64_t find_account_history_entry( const account_id_type& account, const operation_history_id_type& op,
+                                           uint64_t last_sequence );
+
+      std::mutex _mutex;
+
+   private:
+      struct segment
+      {
+         store_file index;
+         store_file data;
+      };
+
+      /// The pages of the stored history of an account. The stored entries have consecutive sequence numbers.
+      struct account_postings
+      {
+         uint64_t              first_page_index = 0;
+         std::vector<uint64_t> pages;
+         uint64_t              first_sequence = 0; ///< 0 if no entry is stored
+         uint64_t              last_sequence = 0;
+         bool                  bounds_loaded = false;
+      };
+
+      /// The file IDs of the page cache
+      static uint64_t postings_file_id() { return 0; }
+      static uint64_t index_file_id( uint64_t seg ) { return 2 * seg + 1; }
+      static uint64_t data_file_id( uint64_t seg ) { return 2 * seg + 2; }
+
+      segment* get_segment( uint64_t seg, bool create );
+      operation_slot read_slot( uint64_t seg, segment& s, uint64_t id );
+      void read_data( uint64_t file_id, store_file& file, uint64_t pos, char* data, size_t size );
+
+      account_postings* get_postings( const account_id_type& account );
+      uint64_t read_entry( const account_postings& postings, uint64_t sequence );
+      void write_page_record( const posting_page_record& record );
+
+      const fc::path                                     _dir;
+      page_cache                                         _cache;
+      std::map<uint64_t, std::unique_ptr<segment>>       _segments;
+      store_file                                         _postings;
+      std::ofstream                                      _page_records;
+      std::unordered_map<uint64_t, account_postings>     _accounts;
+      uint64_t                                           _next_page = 0;
+};
+
+history_store_impl::history_store_impl( const fc::path& dir, size_t cache_size )
+   : _dir( dir ), _cache( cache_size )
+{
+   fc::create_directories( _dir / "operations" );
+   _postings.open( _dir / "postings" );
+
+   const auto records_path = _dir / "postings.log";
+   if( fc::exists( records_path ) )
+   {
+      std::ifstream records( records_path.generic_string().c_str(), std::ifstream::binary );
+      posting_page_record record;
+      while( records.read( (char*)&record, sizeof(record) ) )
+      {
+         if( record.page == reset_page )
+         {
+            _accounts.erase( record.account );
+            continue;
+         }
+         account_postings& postings = _accounts[record.account];
+         if( postings.pages.empty() )
+            postings.first_page_index = record.page_index;
+         FC_ASSERT( record.page_index == postings.first_page_index + postings.pages.size(),
+                    "Inconsistent history store postings log" );
+         postings.pages.push_back( record.page );
+         _next_page = std::max( _next_page, record.page + 1 );
+      }
+   }
+   // pages may have been written without their record
+   _next_page = std::max( _next_page, ( _postings.size() + page_size - 1 ) / page_size );
+
+   _page_records.open( records_path.generic_string().c_str(),
+                       std::ofstream::binary | std::ofstream::out | std::ofstream::app );
+   FC_ASSERT( _page_records.is_open(), "Unable to open ${path}", ("path", records_path) );
+}
+
+history_store_impl::segment* history_store_impl::get_segment( uint64_t seg, bool create )
+{
+   auto itr = _segments.find( seg );
+   if( itr != _segments.end() )
+      return itr->second.get();
+
+   const auto index_path = _dir / "operations" / ( fc::to_string( seg ) + ".index" );
+   if( !create && !fc::exists( index_path ) )
+      return nullptr;
+
+   // close the segments that are not appended to, their pages stay valid in the cache
+   if( _segments.size() >= max_open_segments )
+   {
+      auto last = std::prev( _segments.end() );
+      _segments.erase( _segments.begin(), last );
+   }
+   auto s = std::make_unique<segment>();
+   s->index.open( index_path );
+   s->data.open( _dir / "operations" / ( fc::to_string( seg ) + ".data" ) );
+   return ( _segments[seg] = std::move( s ) ).get();
+}
+
+operation_slot history_store_impl::read_slot( uint64_t seg, segment& s, uint64_t id )
+{
+   const uint64_t pos = ( id % operations_per_segment ) * sizeof(operation_slot);
+   operation_slot slot;
+   std::memcpy( (char*)&slot, _cache.get( index_file_id( seg ), pos / page_size, s.index ) + pos % page_size,
+                sizeof(slot) );
+   return slot;
+}
+
+void history_store_impl::read_data( uint64_t file_id, store_file& file, uint64_t pos, char* data, size_t size )
+{
+   while( size > 0 )
+   {
+      const size_t in_page = std::min<uint64_t>( size, page_size - pos % page_size );
+      std::memcpy( data, _cache.get( file_id, pos / page_size, file ) + pos % page_size, in_page );
+      data += in_page;
+      pos += in_page;
+      size -= in_page;
+   }
+}
+
+void history_store_impl::store_operation( const operation_history_object& op )
+{
+   const uint64_t id = op.id.instance();
+   const uint64_t seg = id / operations_per_segment;
+   segment& s = *get_segment( seg, true );
+   if( read_slot( seg, s, id ).size != 0 )
+      return;
+
+   const std::vector<char> packed = fc::raw::pack( op );
+   operation_slot slot;
+   slot.offset = s.data.size();
+   slot.size = static_cast<uint32_t>( packed.size() );
+   slot.block_num = op.block_num;
+
+   // the data is written before the slot, so a slot never refers to missing data
+   s.data.write( slot.offset, packed.data(), packed.size() );
+   _cache.invalidate( data_file_id( seg ), slot.offset, packed.size() );
+   const uint64_t slot_pos = ( id % operations_per_segment ) * sizeof(operation_slot);
+   s.index.write( slot_pos, (const char*)&slot, sizeof(slot) );
+   _cache.invalidate( index_file_id( seg ), slot_pos, sizeof(slot) );
+}
+
+optional<operation_history_object> history_store_impl::get_operation( const operation_history_id_type& id )
+{
+   const uint64_t instance = id.instance.value;
+   const uint64_t seg = instance / operations_per_segment;
+   segment* s = get_segment( seg, false );
+   if( !s )
+      return {};
+   const operation_slot slot = read_slot( seg, *s, instance );
+   if( slot.size == 0 )
+      return {};
+
+   std::vector<char> packed( slot.size );
+   read_data( data_file_id( seg ), s->data, slot.offset, packed.data(), packed.size() );
+   return fc::raw::unpack<operation_history_object>( packed );
+}
+
+history_store_impl::account_postings* history_store_impl::get_postings( const account_id_type& account )
+{
+   auto itr = _accounts.find( account.instance.value );
+   if( itr == _accounts.end() )
+      return nullptr;
+   account_postings& postings = itr->second;
+   if( !postings.bounds_loaded )
+   {
+      // the stored entries are consecutive, they start in the first page and end in the last one
+      const uint64_t* first = (const uint64_t*)_cache.get( postings_file_id(), postings.pages.front(), _postings );
+      for( uint64_t i = 0; i < entries_per_page && postings.first_sequence == 0; ++i )
+         if( first[i] != 0 )
+            postings.first_sequence = postings.first_page_index * entries_per_page + i + 1;
+      const uint64_t* last = (const uint64_t*)_cache.get( postings_file_id(), postings.pages.back(), _postings );
+      for( uint64_t i = entries_per_page; i > 0 && postings.last_sequence == 0; --i )
+         if( last[i - 1] != 0 )
+            postings.last_sequence = ( postings.first_page_index + postings.pages.size() - 1 ) * entries_per_page + i;
+      if( postings.first_sequence == 0 || postings.last_sequence == 0 )
+         postings.first_sequence = postings.last_sequence = 0;
+      postings.bounds_loaded = true;
+   }
+   return &postings;
+}
+
+uint64_t history_store_impl::read_entry( const account_postings& postings, uint64_t sequence )
+{
+   const uint64_t page_index = ( sequence - 1 ) / entries_per_page;
+   const uint64_t* entries = (const uint64_t*)_cache.get( postings_file_id(),
+                                                          postings.pages[ page_index - postings.first_page_index ],
+                                                          _postings );
+   return entries[ ( sequence - 1 ) % entries_per_page ];
+}
+
+void history_store_impl::write_page_record( const posting_page_record& record )
+{
+   _page_records.write( (const char*)&record, sizeof(record) );
+   FC_ASSERT( _page_records.good(), "Unable to write to the history store" );
+}
+
+void history_store_impl::append_account_history( const account_id_type& account, uint64_t sequence,
+                                                 const operation_history_id_type& op )
+{
+   FC_ASSERT( sequence > 0 );
+   account_postings* postings = get_postings( account );
+   if( postings && postings->last_sequence != 0 )
+   {
+      if( sequence <= postings->last_sequence )
+         return;
+      if( sequence != postings->last_sequence + 1 )
+      {
+         // the entries between were removed while the store was not used, start over at the new entry
+         wlog( "History store misses entries ${from} to ${to} of account ${a}, dropping its stored history",
+               ("from", postings->last_sequence + 1)("to", sequence - 1)("a", account) );
+         write_page_record( { account.instance.value, 0, reset_page } );
+         _accounts.erase( account.instance.value );
+         postings = nullptr;
+      }
+   }
+   if( !postings )
+   {
+      postings = &_accounts[account.instance.value];
+      postings->bounds_loaded = true;
+   }
+
+   const uint64_t page_index = ( sequence - 1 ) / entries_per_page;
+   if( postings->pages.empty() )
+      postings->first_page_index = page_index;
+   if( page_index == postings->first_page_index + postings->pages.size() )
+   {
+      // the page is written before its record, so a record never refers to a page that is not allocated
+      const uint64_t page = _next_page++;
+      const std::vector<char> zeroes( page_size, 0 );
+      _postings.write( page * page_size, zeroes.data(), page_size );
+      _cache.invalidate( postings_file_id(), page * page_size, page_size );
+      write_page_record( { account.instance.value, page_index, page } );
+      postings->pages.push_back( page );
+   }
+
+   // 0 marks an empty entry, so the operation instances are stored plus one
+   const uint64_t entry = op.instance.value + 1;
+   const uint64_t pos = postings->pages.back() * page_size + ( ( sequence - 1 ) % entries_per_page ) * sizeof(entry);
+   _postings.write( pos, (const char*)&entry, sizeof(entry) );
+   _cache.invalidate( postings_file_id(), pos, sizeof(entry) );
+
+   if( postings->first_sequence == 0 )
+      postings->first_sequence = sequence;
+   postings->last_sequence = sequence;
+}
+
+optional<operation_history_id_type> history_store_impl::get_account_history_entry( const account_id_type& account,
+                                                                                   uint64_t sequence )
+{
+   const account_postings* postings = get_postings( account );
+   if( !postings || sequence < postings->first_sequence || sequence > postings->last_sequence )
+      return {};
+   return operation_history_id_type( read_entry( *postings, sequence ) - 1 );
+}
+
+uint64_t history_store_impl::find_account_history_entry( const account_id_type& account,
+                                                         const operation_history_id_type& op,
+                                                         uint64_t last_sequence )
+{
+   const account_postings* postings = get_postings( account );
+   if( !postings || postings->first_sequence == 0 )
+      return 0;
+   // the operation IDs grow with the sequence numbers
+   const uint64_t entry = op.instance.value + 1;
+   uint64_t low = postings->first_sequence;
+   uint64_t high = std::min( postings->last_sequence, last_sequence );
+   if( high < low || read_entry( *postings, low ) > entry )
+      return 0;
+   while( low < high )
+   {
+      const uint64_t middle = low + ( high - low + 1 ) / 2;
+      if( read_entry( *postings, middle ) <= entry )
+         low = middle;
+      else
+         high = middle - 1;
+   }
+   return low;
+}
+
+void history_store_impl::flush()
+{
+   for( auto& s : _segments )
+   {
+      s.second->index.flush();
+      s.second->data.flush();
+   }
+   _postings.flush();
+   _page_records.flush();
+}
+
+} // end namespace detail
+
+history_store::history_store( const fc::path& dir, size_t cache_size )
+   : my( std::make_unique<detail::history_store_impl>( dir, cache_size ) )
+{
+   // Nothing else to do
+}
+
+history_store::~history_store()
+{
+   try
+   {
+      my->flush();
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to flush the history store: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
+void history_store::store_operation( const operation_history_object& op )
+{ try {
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   my->store_operation( op );
+} FC_CAPTURE_AND_RETHROW( (op.id) ) }
+
+void history_store::append_account_history( const account_id_type& account, uint64_t sequence,
+                                            const operation_history_id_type& op )
+{ try {
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   my->append_account_history( account, sequence, op );
+} FC_CAPTURE_AND_RETHROW( (account)(sequence)(op) ) }
+
+void history_store::flush()
+{
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   my->flush();
+}
+
+optional<operation_history_object> history_store::get_operation( const operation_history_id_type& id )const
+{ try {
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   return my->get_operation( id );
+} FC_CAPTURE_AND_RETHROW( (id) ) }
+
+optional<operation_history_id_type> history_store::get_account_history_entry( const account_id_type& account,
+                                                                              uint64_t sequence )const
+{ try {
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   return my->get_account_history_entry( account, sequence );
+} FC_CAPTURE_AND_RETHROW( (account)(sequence) ) }
+
+uint64_t history_store::find_account_history_entry( const account_id_type& account,
+                                                    const operation_history_id_type& op,
+                                                    uint64_t last_sequence )const
+{ try {
+   std::lock_guard<std::mutex> guard( my->_mutex );
+   return my->find_account_history_entry( account, op, last_sequence );
+} FC_CAPTURE_AND_RETHROW( (account)(op)(last_sequence) ) }
+
+} } // graphene::account_history
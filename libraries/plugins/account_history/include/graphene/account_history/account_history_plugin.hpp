@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/app/plugin.hpp>
+#include <graphene/account_history/history_store.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
@@ -46,7 +47,8 @@ namespace graphene { namespace account_history {
 
 enum account_history_object_type
 {
-   exceeded_account_object_type = 0
+   exceeded_account_object_type = 0,
+   history_time_mark_object_type = 1
 };
 
 /// This struct tracks accounts that have exceeded the max-ops-per-account limit
@@ -79,6 +81,116 @@ using exceeded_account_multi_idx_type = multi_index_container<
 
 using exceeded_account_index = generic_index< exceeded_account_object, exceeded_account_multi_idx_type >;
 
+/**
+ *  @brief This struct marks the block time of every N-th entry of the history of an account
+ *
+ *  The marks of an account form a sparse table of the times of its history, so the entries of a time are found
+ *  between two marks. The marks of the history that is moved to the history store are kept.
+ */
+struct history_time_mark_object : public abstract_object<history_time_mark_object,
+                                            ACCOUNT_HISTORY_SPACE_ID, history_time_mark_object_type>
+{
+   /// The ID of the account
+   account_id_type account;
+   /// The sequence number of the marked entry in the history of the account
+   uint64_t        sequence = 0;
+   /// The time of the block containing the operation of the marked entry
+   time_point_sec  block_time;
+};
+
+using history_time_mark_multi_idx_type = multi_index_container<
+   history_time_mark_object,
+   indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_seq>,
+         composite_key<
+            history_time_mark_object,
+            member< history_time_mark_object, account_id_type, &history_time_mark_object::account >,
+            member< history_time_mark_object, uint64_t, &history_time_mark_object::sequence >
+         >
+      >,
+      ordered_unique< tag<by_time>,
+         composite_key<
+            history_time_mark_object,
+            member< history_time_mark_object, account_id_type, &history_time_mark_object::account >,
+            member< history_time_mark_object, time_point_sec, &history_time_mark_object::block_time >,
+            member< history_time_mark_object, uint64_t, &history_time_mark_object::sequence >
+         >
+      >
+   >
+>;
+
+using history_time_mark_index = generic_index< history_time_mark_object, history_time_mark_multi_idx_type >;
+
+/**
+ *  @brief This secondary index of the account history objects orders the history of each account by operation type
+ *
+ *  The history of an account with the operations of some types is found without going through the operations of
+ *  the other types. Only the history in memory is indexed, not the history that was moved to the history store.
+ *
+ *  The operation type is taken from the operation history object. The indexes are loaded in parallel, so the
+ *  account history is indexed by @ref build after the database was opened, and changes are tracked from then on.
+ */
+class operation_type_history_index : public secondary_index
+{
+   public:
+      explicit operation_type_history_index( const database* db ) : _db( db ) {}
+
+      struct entry
+      {
+         account_id_type            account;
+         uint16_t                   op_type = 0;
+         uint64_t                   sequence = 0;
+         operation_history_id_type  operation_id;
+      };
+
+      struct by_sequence;
+      using entry_multi_idx_type = multi_index_container<
+         entry,
+         indexed_by<
+            ordered_unique<
+               composite_key<
+                  entry,
+                  member< entry, account_id_type, &entry::account >,
+                  member< entry, uint16_t, &entry::op_type >,
+                  member< entry, uint64_t, &entry::sequence >
+               >
+            >,
+            // an operation history object may be removed first when a block is undone, so entries are removed
+            // without looking up their operation type
+            ordered_unique< tag<by_sequence>,
+               composite_key<
+                  entry,
+                  member< entry, account_id_type, &entry::account >,
+                  member< entry, uint64_t, &entry::sequence >
+               >
+            >
+         >
+      >;
+      using iterator = entry_multi_idx_type::const_iterator;
+
+      void object_inserted( const object& obj ) override;
+      void object_removed( const object& obj ) override;
+      void about_to_modify( const object& before ) override;
+      void object_modified( const object& after ) override;
+
+      /// Indexes the account history objects in the database and tracks their changes from now on
+      void build();
+
+      /// @return the entries of the account with the operation type and a sequence number in the range
+      ///         [@p first_sequence, @p last_sequence], in ascending order of sequence numbers
+      std::pair<iterator, iterator> get_history( const account_id_type& account, uint16_t op_type,
+                                                 uint64_t first_sequence, uint64_t last_sequence )const;
+
+   private:
+      entry make_entry( const account_history_object& aho )const;
+
+      const database*      _db;
+      /// Changes are ignored until the index was built
+      bool                 _built = false;
+      entry_multi_idx_type _entries;
+};
+
 namespace detail
 {
     class account_history_plugin_impl;
@@ -98,6 +210,10 @@ class account_history_plugin : public graphene::app::plugin
       void plugin_startup() override;
 
       flat_set<account_id_type> tracked_accounts()const;
+      /// @return the store of the history removed from memory, or null if the history-store option is not set
+      std::shared_ptr<const history_store> get_history_store()const;
+      /// @return the history index by operation type, or null if the history-by-operation-type option is not set
+      const operation_type_history_index* get_operation_type_history_index()const;
 
    private:
       std::unique_ptr<detail::account_history_plugin_impl> my;
@@ -107,3 +223,5 @@ class account_history_plugin : public graphene::app::plugin
 
 FC_REFLECT_DERIVED( graphene::account_history::exceeded_account_object, (graphene::db::object),
                     (account_id)(block_num) )
+FC_REFLECT_DERIVED( graphene::account_history::history_time_mark_object, (graphene::db::object),
+                    (account)(sequence)(block_time) )
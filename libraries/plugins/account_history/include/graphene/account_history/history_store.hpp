@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <memory>
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+namespace detail
+{
+   class history_store_impl;
+}
+
+/**
+ *  @brief An append-only store on disk for the account history that is removed from memory
+ *
+ *  The operations are kept in segments of a fixed number of consecutive operation IDs. A segment has a
+ *  fixed-width slot per operation ID with the position, size and block number of the operation, and a data
+ *  file the packed operations are appended to. The history of an account is a posting list of operation IDs
+ *  by sequence number, kept in pages of a shared postings file. All reads go through a page cache of a
+ *  bounded size, so the memory used does not grow with the history.
+ *
+ *  Only the history of irreversible blocks may be stored. Entries that are stored already are skipped, so
+ *  history that is removed from memory again, after a restart or an undone block, is not stored twice.
+ *
+ *  The methods may be called from any thread.
+ */
+class history_store
+{
+   public:
+      /// Opens the store in @p dir, @p cache_size is the memory used for cached pages in bytes
+      history_store( const fc::path& dir, size_t cache_size );
+      ~history_store();
+
+      /// Stores the operation, unless it is stored already
+      void store_operation( const operation_history_object& op );
+      /**
+       * Appends the entry with the sequence number to the history of the account, unless it is stored already.
+       * The entries of an account must be appended in the order of their sequence numbers.
+       */
+      void append_account_history( const account_id_type& account, uint64_t sequence,
+                                   const operation_history_id_type& op );
+      /// Writes the buffered data to the files
+      void flush();
+
+      optional<operation_history_object> get_operation( const operation_history_id_type& id )const;
+      /// @return the operation of the entry of the account with the sequence number, if it is stored
+      optional<operation_history_id_type> get_account_history_entry( const account_id_type& account,
+                                                                     uint64_t sequence )const;
+      /**
+       * @return the sequence number of the latest stored entry of the account that is not after
+       *         @p last_sequence and whose operation ID is not greater than @p op, or 0 if there is none
+       */
+      uint64_t find_account_history_entry( const account_id_type& account, const operation_history_id_type& op,
+                                           uint64_t last_sequence )const;
+
+   private:
+      std::unique_ptr<detail::history_store_impl> my;
+};
+
+} } // graphene::account_history
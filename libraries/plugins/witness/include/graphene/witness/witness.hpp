@@ -47,6 +47,15 @@ namespace block_production_condition
    };
 }
 
+/// Time spent in database::generate_block() by this node
+struct block_generation_stats
+{
+   uint64_t          blocks = 0;
+   fc::microseconds  last;
+   fc::microseconds  max;
+   fc::microseconds  total;
+};
+
 class witness_plugin : public graphene::app::plugin {
 public:
    using graphene::app::plugin::plugin;
@@ -69,6 +78,8 @@ public:
    inline const fc::flat_map< chain::witness_id_type, fc::optional<chain::public_key_type> >& get_witness_key_cache()
    { return _witness_key_cache; }
 
+   const block_generation_stats& get_block_generation_stats()const { return _generation_stats; }
+
 private:
    void cleanup() { stop_block_production(); }
 
@@ -93,6 +104,8 @@ private:
    /// For tracking signing keys of specified witnesses, only update when applied a block
    fc::flat_map< chain::witness_id_type, fc::optional<chain::public_key_type> > _witness_key_cache;
 
+   block_generation_stats _generation_stats;
+
 };
 
 } } //graphene::witness_plugin
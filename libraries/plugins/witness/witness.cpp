@@ -175,6 +175,7 @@ void witness_plugin::plugin_startup()
    {
       ilog("Launching block production for ${n} witnesses.", ("n", _witnesses.size()));
       app().set_block_production(true);
+      d.set_candidate_block(true);
       if( _production_enabled )
       {
          if( d.head_block_num() == 0 )
@@ -269,7 +270,7 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    switch( result )
    {
       case block_production_condition::produced:
-         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c}", (capture));
+         ilog("Generated block #${n} with ${x} transaction(s) and timestamp ${t} at time ${c} in ${g} us", (capture));
          break;
       case block_production_condition::not_synced:
          ilog("Not producing block because production is disabled until we receive a recent block "
@@ -375,13 +376,20 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    if( p2p_node() == nullptr )
       return block_production_condition::no_network;
 
+   const fc::time_point generation_start = fc::time_point::now();
    auto block = db.generate_block(
       scheduled_time,
       scheduled_witness,
       private_key_itr->second,
       _production_skip_flags
       );
-   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size());
+   const fc::microseconds generation_time = fc::time_point::now() - generation_start;
+   ++_generation_stats.blocks;
+   _generation_stats.last = generation_time;
+   _generation_stats.max = std::max( _generation_stats.max, generation_time );
+   _generation_stats.total += generation_time;
+   capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size())
+          ("g", generation_time.count());
    fc::async( [this,block](){ p2p_node()->broadcast(net::block_message(block)); } );
 
    return block_production_condition::produced;
@@ -67,6 +67,58 @@ namespace graphene { namespace protocol {
       return signee() == expected_signee;
    }
 
+   void merkle_accumulator::append( const digest_type& digest )
+   {
+      // like a binary counter, complete subtrees of the same size are combined until a free level is found
+      digest_type node = digest;
+      size_t level = 0;
+      while( 0 != ( _count & ( size_t(1) << level ) ) )
+      {
+         node = digest_type::hash( std::make_pair( _subtrees[level], node ) );
+         ++level;
+      }
+      if( level >= _subtrees.size() )
+         _subtrees.resize( level + 1 );
+      _subtrees[level] = node;
+      ++_count;
+   }
+
+   checksum_type merkle_accumulator::root()const
+   {
+      if( 0 == _count )
+         return checksum_type();
+
+      // an incomplete subtree is the right child of the next bigger complete one, or is moved up unchanged
+      digest_type node;
+      bool has_node = false;
+      for( size_t level = 0; level < _subtrees.size(); ++level )
+      {
+         if( 0 == ( _count & ( size_t(1) << level ) ) )
+            continue;
+         node = has_node ? digest_type::hash( std::make_pair( _subtrees[level], node ) ) : _subtrees[level];
+         has_node = true;
+      }
+      return checksum_type::hash( node );
+   }
+
+   void merkle_accumulator::clear()
+   {
+      _subtrees.clear();
+      _count = 0;
+   }
+
+   const checksum_type& signed_block::calculate_merkle_root( const merkle_accumulator& digests )const
+   {
+      static const checksum_type empty_checksum;
+      if( transactions.size() == 0 )
+         return empty_checksum;
+
+      FC_ASSERT( digests.size() == transactions.size(), "Need one digest per transaction" );
+      if( 0 == _calculated_merkle_root._hash[0].value() )
+         _calculated_merkle_root = digests.root();
+      return _calculated_merkle_root;
+   }
+
    const checksum_type& signed_block::calculate_merkle_root()const
    {
       static const checksum_type empty_checksum;
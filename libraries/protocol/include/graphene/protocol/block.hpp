@@ -61,10 +61,34 @@ namespace graphene { namespace protocol {
       mutable block_id_type       _block_id;
    };
 
+   /**
+    *  @brief Computes the transaction merkle root of a block while the merkle digests of its transactions are
+    *  appended one by one
+    *
+    *  Only the digest of one complete subtree per tree level is kept, so appending costs one hash on average
+    *  and the root of the digests appended so far costs at most one hash per level. The root is the same as
+    *  the one of signed_block::calculate_merkle_root().
+    */
+   class merkle_accumulator
+   {
+   public:
+      void          append( const digest_type& digest );
+      checksum_type root()const;
+      size_t        size()const { return _count; }
+      void          clear();
+
+   private:
+      /// Digests of complete subtrees with 2^level leaves, valid for the levels whose bit is set in _count
+      vector<digest_type> _subtrees;
+      size_t              _count = 0;
+   };
+
    class signed_block : public signed_block_header
    {
    public:
       const checksum_type& calculate_merkle_root()const;
+      /// Same as calculate_merkle_root(), from the merkle digests of all transactions appended to @p digests
+      const checksum_type& calculate_merkle_root( const merkle_accumulator& digests )const;
       vector<processed_transaction> transactions;
    protected:
       mutable checksum_type   _calculated_merkle_root;
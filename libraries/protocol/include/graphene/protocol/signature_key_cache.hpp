@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/protocol/types.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace protocol {
+
+   /**
+    *  @brief Process-wide bounded cache of the public keys recovered from signatures
+    *
+    *  The same transaction signatures are recovered when the transaction is received, when it is applied to the
+    *  pending state and when it is applied in a block, usually from different transaction objects. Recovery is
+    *  by far the most expensive part of this, so the recovered keys are cached by a hash of the digest and the
+    *  signature.
+    *
+    *  The cache is split in shards of direct mapped slots, a new entry replaces the one in its slot. Writers of
+    *  a shard are serialized by a mutex, readers do not lock: every slot has a sequence number which is odd while
+    *  the slot is written, and a reader retries the lookup as a miss if it changed.
+    */
+   class signature_key_cache
+   {
+      public:
+         static signature_key_cache& instance();
+
+         explicit signature_key_cache( size_t entries = default_entries );
+
+         /// @return the key recovered from @p sig for @p digest, from the cache if possible
+         public_key_type recover( const digest_type& digest, const signature_type& sig );
+
+         /// @return true and sets @p key if the key recovered from @p sig for @p digest is cached
+         bool find( const digest_type& digest, const signature_type& sig, public_key_type& key )const;
+         void insert( const digest_type& digest, const signature_type& sig, const public_key_type& key );
+
+         /// Drops all entries and sets the number of entries, 0 disables the cache.
+         /// Must not be called while the cache is used by other threads.
+         void resize( size_t entries );
+         size_t capacity()const { return _shard_count * _slots_per_shard; }
+
+         static constexpr size_t default_entries = 64 * 1024;
+
+      private:
+         static constexpr size_t key_words = 4;   ///< sha256 of digest and signature
+         static constexpr size_t value_words = 5; ///< 33 bytes of compressed public key
+
+         struct slot
+         {
+            std::atomic<uint32_t>  sequence{ 0 };
+            std::atomic<uint64_t>  key[key_words];
+            std::atomic<uint64_t>  value[value_words];
+         };
+
+         struct shard
+         {
+            std::mutex               write_mutex;
+            std::unique_ptr<slot[]>  slots;
+         };
+
+         static constexpr size_t        _shard_count = 64;
+         std::unique_ptr<shard[]>       _shards;
+         size_t                         _slots_per_shard = 0;
+   };
+
+} } // graphene::protocol
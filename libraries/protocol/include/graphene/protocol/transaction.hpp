@@ -297,7 +297,14 @@ namespace graphene { namespace protocol {
 
       vector<operation_result> operation_results;
 
-      digest_type merkle_digest()const;
+      /// Replaces the operation_results and drops the cached merkle_digest(), which includes them
+      void set_operation_results( vector<operation_result> results );
+
+      /// The digest is cached, like the precomputed values of precomputable_transaction, so the transaction
+      /// must not be modified after this was called, except for its operation_results by set_operation_results()
+      const digest_type& merkle_digest()const;
+   protected:
+      mutable optional<digest_type> _merkle_digest;
    };
 
    /// @} transactions group
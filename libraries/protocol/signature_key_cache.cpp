@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/protocol/signature_key_cache.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace protocol {
+
+namespace {
+
+struct cache_key
+{
+   uint64_t words[4];
+
+   cache_key( const digest_type& digest, const signature_type& sig )
+   {
+      fc::sha256::encoder enc;
+      enc.write( digest.data(), digest.data_size() );
+      enc.write( (const char*)sig.data, sizeof( sig.data ) );
+      const fc::sha256 hash = enc.result();
+      static_assert( sizeof( words ) == sizeof( hash._hash ), "unexpected hash size" );
+      memcpy( words, hash.data(), sizeof( words ) );
+   }
+};
+
+} // anonymous namespace
+
+constexpr size_t signature_key_cache::default_entries;
+constexpr size_t signature_key_cache::key_words;
+constexpr size_t signature_key_cache::value_words;
+constexpr size_t signature_key_cache::_shard_count;
+
+signature_key_cache& signature_key_cache::instance()
+{
+   static signature_key_cache cache;
+   return cache;
+}
+
+signature_key_cache::signature_key_cache( size_t entries )
+{
+   resize( entries );
+}
+
+void signature_key_cache::resize( size_t entries )
+{
+   _slots_per_shard = ( entries + _shard_count - 1 ) / _shard_count;
+   if( _slots_per_shard == 0 )
+   {
+      _shards.reset();
+      return;
+   }
+   _shards.reset( new shard[ _shard_count ] );
+   for( size_t i = 0; i < _shard_count; ++i )
+      _shards[i].slots.reset( new slot[ _slots_per_shard ] );
+}
+
+bool signature_key_cache::find( const digest_type& digest, const signature_type& sig, public_key_type& key )const
+{
+   if( _slots_per_shard == 0 )
+      return false;
+   // the key is a hash already, its words are used as shard and slot numbers
+   const cache_key k( digest, sig );
+   const slot& s = _shards[ k.words[0] % _shard_count ].slots[ k.words[1] % _slots_per_shard ];
+
+   const uint32_t sequence = s.sequence.load( std::memory_order_acquire );
+   if( sequence == 0 || ( sequence & 1 ) != 0 )
+      return false;
+   for( size_t i = 0; i < key_words; ++i )
+      if( s.key[i].load( std::memory_order_relaxed ) != k.words[i] )
+         return false;
+   uint64_t value[value_words];
+   for( size_t i = 0; i < value_words; ++i )
+      value[i] = s.value[i].load( std::memory_order_relaxed );
+   std::atomic_thread_fence( std::memory_order_acquire );
+   if( s.sequence.load( std::memory_order_relaxed ) != sequence )
+      return false;
+
+   static_assert( sizeof( key.key_data ) <= sizeof( value ), "public key does not fit into a slot" );
+   memcpy( key.key_data.data, value, sizeof( key.key_data ) );
+   return true;
+}
+
+void signature_key_cache::insert( const digest_type& digest, const signature_type& sig,
+                                  const public_key_type& key )
+{
+   if( _slots_per_shard == 0 )
+      return;
+   const cache_key k( digest, sig );
+   uint64_t value[value_words] = {};
+   memcpy( value, key.key_data.data, sizeof( key.key_data ) );
+
+   shard& sh = _shards[ k.words[0] % _shard_count ];
+   slot& s = sh.slots[ k.words[1] % _slots_per_shard ];
+   std::lock_guard<std::mutex> guard( sh.write_mutex );
+   const uint32_t sequence = s.sequence.load( std::memory_order_relaxed );
+   s.sequence.store( sequence + 1, std::memory_order_relaxed );
+   std::atomic_thread_fence( std::memory_order_release );
+   for( size_t i = 0; i < key_words; ++i )
+      s.key[i].store( k.words[i], std::memory_order_relaxed );
+   for( size_t i = 0; i < value_words; ++i )
+      s.value[i].store( value[i], std::memory_order_relaxed );
+   s.sequence.store( sequence + 2, std::memory_order_release );
+}
+
+public_key_type signature_key_cache::recover( const digest_type& digest, const signature_type& sig )
+{
+   public_key_type key;
+   if( find( digest, sig, key ) )
+      return key;
+   key = fc::ecc::public_key( sig, digest );
+   insert( digest, sig, key );
+   return key;
+}
+
+} } // graphene::protocol
@@ -28,16 +28,27 @@
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/pts_address.hpp>
 #include <graphene/protocol/restriction_predicate.hpp>
+#include <graphene/protocol/signature_key_cache.hpp>
 
 #include <fc/io/raw.hpp>
 
 namespace graphene { namespace protocol {
 
-digest_type processed_transaction::merkle_digest()const
+void processed_transaction::set_operation_results( vector<operation_result> results )
 {
-   digest_type::encoder enc;
-   fc::raw::pack( enc, *this );
-   return enc.result();
+   operation_results = std::move( results );
+   _merkle_digest.reset();
+}
+
+const digest_type& processed_transaction::merkle_digest()const
+{
+   if( !_merkle_digest.valid() )
+   {
+      digest_type::encoder enc;
+      fc::raw::pack( enc, *this );
+      _merkle_digest = enc.result();
+   }
+   return *_merkle_digest;
 }
 
 digest_type transaction::digest()const
@@ -351,10 +362,11 @@ const flat_set<public_key_type>& signed_transaction::get_signature_keys( const c
 { try {
    auto d = sig_digest( chain_id );
    flat_set<public_key_type> result;
+   auto& key_cache = signature_key_cache::instance();
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( key_cache.recover( d, sig ) ).second,
             tx_duplicate_sig,
             "Duplicate Signature detected" );
    }
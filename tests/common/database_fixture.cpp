@@ -214,6 +214,31 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
       fc::set_option( options, "min-blocks-to-keep", (uint32_t)3 );
       fc::set_option( options, "max-ops-per-acc-by-min-blocks", (uint64_t)5 );
    }
+   if (fixture.current_test_name == "history_store_test")
+   {
+      fc::set_option( options, "partial-operations", true );
+      fc::set_option( options, "max-ops-per-account", (uint64_t)3 );
+      fc::set_option( options, "min-blocks-to-keep", (uint32_t)0 );
+      fc::set_option( options, "history-store", true );
+   }
+   if (fixture.current_test_name == "history_time_index_test")
+   {
+      fc::set_option( options, "partial-operations", true );
+      fc::set_option( options, "max-ops-per-account", (uint64_t)5 );
+      fc::set_option( options, "min-blocks-to-keep", (uint32_t)0 );
+      fc::set_option( options, "history-store", true );
+      fc::set_option( options, "history-time-index-interval", (uint32_t)4 );
+   }
+   if (fixture.current_test_name == "history_by_operation_type_test")
+   {
+      fc::set_option( options, "max-ops-per-account", (uint64_t)30 );
+      fc::set_option( options, "min-blocks-to-keep", (uint32_t)0 );
+      fc::set_option( options, "history-by-operation-type", true );
+   }
+   if (fixture.current_test_name == "account_history_by_operation_type_benchmark")
+   {
+      fc::set_option( options, "history-by-operation-type", true );
+   }
    if (fixture.current_test_name == "get_account_history_operations")
    {
       fc::set_option( options, "max-ops-per-account", (uint64_t)75 );
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/api.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/**
+ * Measures the history API queries by operation type for an account with 1M operations, one of 10,000 of them of
+ * a rare type, with the history-by-operation-type index against the walk through the whole history of the account.
+ */
+BOOST_FIXTURE_TEST_CASE( account_history_by_operation_type_benchmark, database_fixture )
+{ try {
+   BOOST_REQUIRE( app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" )
+                     ->get_operation_type_history_index() != nullptr );
+   ACTORS( (alice) );
+   generate_block();
+
+   const uint64_t ops = 1000000;
+   const uint64_t rare_every = 10000;
+   const int rare_type = operation::tag<account_update_operation>::value;
+
+   // the history is created directly, as in vote_tally_benchmark there is no undo
+   db._undo_db.disable();
+   auto start = fc::time_point::now();
+   const auto& stats = alice_id(db).statistics(db);
+   for( uint64_t i = 1; i <= ops; ++i )
+   {
+      const auto& oho = db.create<operation_history_object>( [&]( operation_history_object& o ) {
+         if( i % rare_every == 0 )
+            o.op = account_update_operation();
+         else
+            o.op = transfer_operation();
+         // the operations are not in a real block, they are kept apart from its ones in the by_block index
+         o.block_num = db.head_block_num();
+         o.trx_in_block = std::numeric_limits<uint16_t>::max();
+         o.virtual_op = static_cast<uint32_t>( i );
+         o.block_time = db.head_block_time();
+      });
+      const auto& aho = db.create<account_history_object>( [&]( account_history_object& a ) {
+         a.account = alice_id;
+         a.operation_id = oho.get_id();
+         a.sequence = stats.total_ops + 1;
+         a.next = stats.most_recent_op;
+      });
+      db.modify( stats, [&aho]( account_statistics_object& s ) {
+         s.most_recent_op = aho.get_id();
+         s.total_ops = aho.sequence;
+      });
+   }
+   db._undo_db.enable();
+   wlog( "Created ${n} operations in the history of an account in ${t} ms",
+         ("n", ops)("t", (fc::time_point::now() - start).count() / 1000) );
+
+   graphene::app::history_api hist_api( app );
+   const uint32_t limit = 100;
+
+   // the walk through the linked history entries, as get_account_history_operations does without the index
+   start = fc::time_point::now();
+   vector<operation_history_id_type> walked;
+   for( const account_history_object* node = &stats.most_recent_op(db); node != nullptr && walked.size() < limit;
+        node = ( node->next == account_history_id_type() ) ? nullptr : &node->next(db) )
+   {
+      if( node->operation_id(db).op.which() == rare_type )
+         walked.push_back( node->operation_id );
+   }
+   const auto walk_time = fc::time_point::now() - start;
+
+   start = fc::time_point::now();
+   const auto indexed = hist_api.get_account_history_operations( "alice", rare_type, operation_history_id_type(),
+                                                                 operation_history_id_type(), limit );
+   const auto indexed_time = fc::time_point::now() - start;
+   wlog( "Benchmark: get_account_history_operations for ${c} of ${n} operations took ${i} us indexed, "
+         "${w} us through the linked history",
+         ("c", indexed.size())("n", ops)("i", indexed_time.count())("w", walk_time.count()) );
+
+   BOOST_REQUIRE_EQUAL( indexed.size(), walked.size() );
+   for( size_t i = 0; i < indexed.size(); ++i )
+      BOOST_CHECK( indexed[i].get_id() == walked[i] );
+
+   // page through the whole history, against the filtered relative history as get_account_history_by_operations
+   // returns without the index
+   const flat_set<uint16_t> types { static_cast<uint16_t>( rare_type ) };
+   start = fc::time_point::now();
+   size_t found = 0;
+   for( uint32_t first = 1; first <= stats.total_ops; first += limit )
+      found += hist_api.get_account_history_by_operations( "alice", types, first, limit )
+                  .operation_history_objs.size();
+   const auto paged_indexed_time = fc::time_point::now() - start;
+
+   start = fc::time_point::now();
+   size_t filtered = 0;
+   for( uint32_t first = 1; first <= stats.total_ops; first += limit )
+   {
+      for( const auto& o : hist_api.get_relative_account_history( "alice", first, limit, first + limit - 1 ) )
+         if( types.find( o.op.which() ) != types.end() )
+            ++filtered;
+   }
+   const auto paged_filtered_time = fc::time_point::now() - start;
+   wlog( "Benchmark: get_account_history_by_operations through ${n} operations in pages of ${l} took ${i} ms "
+         "indexed, ${f} ms filtering the relative history",
+         ("n", ops)("l", limit)("i", paged_indexed_time.count() / 1000)("f", paged_filtered_time.count() / 1000) );
+
+   BOOST_CHECK_EQUAL( found, ops / rare_every );
+   BOOST_CHECK_EQUAL( filtered, ops / rare_every );
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/protocol/block.hpp>
+#include <graphene/protocol/transfer.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/**
+ * Compares the merkle root of a block with 10,000 transfers computed from scratch, as the node did for every
+ * block, with the root computed from the transaction digests cached by the precomputation, and with the
+ * incremental root of a candidate block which is queried after every appended transaction.
+ */
+BOOST_AUTO_TEST_CASE( merkle_root_benchmark )
+{ try {
+   const uint32_t num_tx = 10000;
+   clearable_block block;
+   block.transactions.reserve( num_tx );
+   for( uint32_t i = 0; i < num_tx; ++i )
+   {
+      processed_transaction tx;
+      tx.ref_block_num = i & 0xffff;
+      tx.ref_block_prefix = i;
+      transfer_operation op;
+      op.from = account_id_type( i );
+      op.to = account_id_type( i + 1 );
+      op.amount = asset( i );
+      tx.operations.push_back( op );
+      tx.signatures.emplace_back();
+      block.transactions.push_back( tx );
+   }
+
+   auto start = fc::time_point::now();
+   const checksum_type full_root = block.calculate_merkle_root();
+   const auto full_time = fc::time_point::now() - start;
+   wlog( "Benchmark: merkle root of ${n} transactions from scratch took ${t} us",
+         ("n", num_tx)("t", full_time.count()) );
+
+   // the digests are cached in the transactions now
+   block.clear();
+   start = fc::time_point::now();
+   const checksum_type cached_root = block.calculate_merkle_root();
+   const auto cached_time = fc::time_point::now() - start;
+   wlog( "Benchmark: merkle root of ${n} transactions with cached digests took ${t} us",
+         ("n", num_tx)("t", cached_time.count()) );
+   BOOST_CHECK( cached_root == full_root );
+
+   start = fc::time_point::now();
+   merkle_accumulator acc;
+   checksum_type incremental_root;
+   for( const auto& tx : block.transactions )
+   {
+      acc.append( tx.merkle_digest() );
+      incremental_root = acc.root();
+   }
+   const auto incremental_time = fc::time_point::now() - start;
+   wlog( "Benchmark: ${n} incremental merkle roots of a growing block took ${t} us",
+         ("n", num_tx)("t", incremental_time.count()) );
+   BOOST_CHECK( incremental_root == full_root );
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/protocol/transfer.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using graphene::net::message;
+
+/**
+ * Queues a block message of about 1 MB for 200 peers, as a broadcast does with the message cache and the send
+ * queues of the peers, once with a private copy of the payload per peer, as the node did before, and once with
+ * the shared payload.
+ */
+BOOST_AUTO_TEST_CASE( message_broadcast_benchmark )
+{ try {
+   const uint32_t num_peers = 200;
+   const uint32_t num_tx = 8000;
+   signed_block block;
+   block.transactions.reserve( num_tx );
+   for( uint32_t i = 0; i < num_tx; ++i )
+   {
+      processed_transaction tx;
+      tx.ref_block_num = i & 0xffff;
+      tx.ref_block_prefix = i;
+      transfer_operation op;
+      op.from = account_id_type( i );
+      op.to = account_id_type( i + 1 );
+      op.amount = asset( i );
+      tx.operations.push_back( op );
+      tx.signatures.emplace_back();
+      block.transactions.push_back( tx );
+   }
+   const message block_msg{ graphene::net::block_message( block ) };
+   const size_t payload_size = block_msg.data.size();
+
+   auto start = fc::time_point::now();
+   std::vector<message> private_queues;
+   private_queues.reserve( num_peers + 1 );
+   for( uint32_t i = 0; i <= num_peers; ++i ) // the message cache and the queues
+   {
+      message copy;
+      copy.size = block_msg.size;
+      copy.msg_type = block_msg.msg_type;
+      copy.data = block_msg.data.bytes();
+      private_queues.push_back( std::move( copy ) );
+   }
+   const auto private_time = fc::time_point::now() - start;
+   wlog( "Benchmark: queueing a ${s} byte message for ${n} peers with private payloads took ${t} us, "
+         "${b} bytes of payloads",
+         ("s", payload_size)("n", num_peers)("t", private_time.count())("b", payload_size * private_queues.size()) );
+   private_queues.clear();
+
+   start = fc::time_point::now();
+   std::vector<message> shared_queues;
+   shared_queues.reserve( num_peers + 1 );
+   for( uint32_t i = 0; i <= num_peers; ++i )
+      shared_queues.push_back( block_msg );
+   const auto shared_time = fc::time_point::now() - start;
+   wlog( "Benchmark: queueing a ${s} byte message for ${n} peers with a shared payload took ${t} us, "
+         "${b} bytes of payloads",
+         ("s", payload_size)("n", num_peers)("t", shared_time.count())("b", payload_size) );
+
+   BOOST_CHECK_EQUAL( block_msg.data.use_count(), long( num_peers ) + 2 );
+   BOOST_CHECK( shared_queues.back().as<graphene::net::block_message>().block_id == block.id() );
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <ctime>
+
+using graphene::net::stcp_socket;
+
+namespace {
+
+size_t padded_size( size_t size )
+{
+   return 16 * ( ( size + 15 ) / 16 );
+}
+
+struct transfer_result
+{
+   double mb_per_second;
+   double cpu_ns_per_byte;
+};
+
+/// Sends @p messages messages of @p message_size bytes from @p sender to @p receiver with @p send, the receiver
+/// reads them in chunks of up to @p read_length bytes
+template<typename Send>
+transfer_result transfer( stcp_socket& sender, stcp_socket& receiver, uint32_t messages, size_t message_size,
+                          size_t read_length, Send send )
+{
+   const size_t padded_message_size = padded_size( message_size );
+   std::vector<char> payload( message_size, 'x' );
+   auto reader = fc::async( [&]() {
+      std::vector<char> buffer( padded_message_size );
+      for( uint32_t i = 0; i < messages; ++i )
+         for( size_t offset = 0; offset < padded_message_size; offset += read_length )
+            receiver.read( buffer.data() + offset, std::min( read_length, padded_message_size - offset ) );
+   }, "stcp_benchmark_reader" );
+
+   const std::clock_t cpu_start = std::clock();
+   const fc::time_point start = fc::time_point::now();
+   for( uint32_t i = 0; i < messages; ++i )
+   {
+      send( sender, payload, padded_message_size );
+      sender.flush();
+   }
+   reader.wait();
+   const fc::microseconds elapsed = fc::time_point::now() - start;
+   const double cpu_seconds = double( std::clock() - cpu_start ) / CLOCKS_PER_SEC;
+
+   const double bytes = double( padded_message_size ) * messages;
+   // both ends run in this process, the CPU time covers encryption and decryption
+   return { bytes / ( 1024 * 1024 ) / ( elapsed.count() / 1000000.0 ), cpu_seconds * 1e9 / bytes };
+}
+
+}
+
+/**
+ * Sends 256 messages of 1 MB over an encrypted loopback connection, once by assembling each padded message in
+ * a buffer of its own and writing it in 4 kB chunks, as message_oriented_connection did before, and once with
+ * stcp_socket::write_padded.
+ */
+BOOST_AUTO_TEST_CASE( stcp_throughput_benchmark )
+{ try {
+   fc::tcp_server server;
+   server.listen( fc::ip::endpoint::from_string( "127.0.0.1:0" ) );
+   stcp_socket sender;
+   stcp_socket receiver;
+   auto accepted = fc::async( [&]() {
+      server.accept( receiver.get_socket() );
+      receiver.accept();
+   }, "stcp_benchmark_accept" );
+   sender.connect_to( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), server.get_port() ) );
+   accepted.wait();
+
+   const uint32_t messages = 256;
+   const size_t message_size = 1024 * 1024 + 8;
+
+   // the socket buffers only grow, so the 4 kB run goes first
+   const auto assembled = transfer( sender, receiver, messages, message_size, stcp_socket::min_buffer_length,
+         []( stcp_socket& sock, const std::vector<char>& payload, size_t padded_message_size ) {
+      std::vector<char> padded_message( padded_message_size );
+      memcpy( padded_message.data(), payload.data(), payload.size() );
+      for( size_t offset = 0; offset < padded_message_size; offset += stcp_socket::min_buffer_length )
+         sock.write( padded_message.data() + offset,
+                     std::min<size_t>( stcp_socket::min_buffer_length, padded_message_size - offset ) );
+   });
+   wlog( "Benchmark: ${n} messages of ${s} bytes assembled and written in 4 kB chunks: ${r} MB/s, "
+         "${c} ns CPU per byte", ("n", messages)("s", message_size)
+         ("r", assembled.mb_per_second)("c", assembled.cpu_ns_per_byte) );
+
+   const auto batched = transfer( sender, receiver, messages, message_size, padded_size( message_size ),
+         []( stcp_socket& sock, const std::vector<char>& payload, size_t ) {
+      sock.write_padded( { { payload.data(), 8 }, { payload.data() + 8, payload.size() - 8 } } );
+   });
+   wlog( "Benchmark: ${n} messages of ${s} bytes written with write_padded: ${r} MB/s, ${c} ns CPU per byte",
+         ("n", messages)("s", message_size)("r", batched.mb_per_second)("c", batched.cpu_ns_per_byte) );
+
+   sender.close();
+   receiver.close();
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <random>
+
+using namespace graphene::chain;
+
+/**
+ * Measures the time taken by the notifications of a block for 10,000 database API sessions that subscribed to
+ * random accounts, as the time of the blocks with the sessions less the time of the same blocks without them.
+ */
+BOOST_FIXTURE_TEST_CASE( subscription_dispatch_benchmark, database_fixture )
+{ try {
+   const uint32_t account_count = 1000;
+   const uint32_t session_count = 10000;
+   const uint32_t block_count = 20;
+   const uint32_t transfers_per_block = 100;
+
+   vector<account_id_type> accounts;
+   accounts.reserve( account_count );
+   for( uint32_t i = 0; i < account_count; ++i )
+   {
+      accounts.push_back( create_account( "account" + fc::to_string( uint64_t(i) ) ).get_id() );
+      transfer( committee_account, accounts.back(), asset( 1000000 ) );
+      if( i % 100 == 99 )
+         generate_block();
+   }
+   generate_block();
+
+   std::mt19937 rng( 1000 );
+   std::uniform_int_distribution<uint32_t> random_account( 0, account_count - 1 );
+   std::uniform_int_distribution<uint32_t> random_offset( 1, account_count - 1 );
+   auto generate_blocks_with_transfers = [&]() {
+      fc::microseconds total;
+      for( uint32_t b = 0; b < block_count; ++b )
+      {
+         for( uint32_t t = 0; t < transfers_per_block; ++t )
+         {
+            // the amounts differ so the transactions of a block are not duplicates
+            const uint32_t from = random_account( rng );
+            const uint32_t to = ( from + random_offset( rng ) ) % account_count;
+            transfer( accounts[from], accounts[to], asset( t + 1 ) );
+         }
+         const auto start = fc::time_point::now();
+         generate_block();
+         total += fc::time_point::now() - start;
+      }
+      return total;
+   };
+
+   const auto time_without_sessions = generate_blocks_with_transfers();
+
+   uint64_t notifications = 0;
+   vector<graphene::app::database_api> sessions;
+   sessions.reserve( session_count );
+   for( uint32_t i = 0; i < session_count; ++i )
+   {
+      sessions.emplace_back( db, &app.get_options() );
+      sessions.back().set_subscribe_callback( [&notifications]( const variant& ) { ++notifications; }, false );
+      sessions.back().get_full_accounts( { string( object_id_type( accounts[random_account( rng )] ) ) }, true );
+   }
+
+   const auto time_with_sessions = generate_blocks_with_transfers();
+   fc::usleep( fc::milliseconds( 200 ) ); // sleep a while to execute the callbacks in another thread
+
+   wlog( "Benchmark: ${b} blocks of ${t} transfers between ${a} accounts took ${n} us per block, "
+         "${s} us per block with ${c} sessions subscribed to random accounts, "
+         "${d} us per block to dispatch ${u} notifications",
+         ("b", block_count)("t", transfers_per_block)("a", account_count)
+         ("n", time_without_sessions.count() / block_count)
+         ("s", time_with_sessions.count() / block_count)("c", session_count)
+         ("d", ( time_with_sessions - time_without_sessions ).count() / block_count)("u", notifications) );
+
+   BOOST_CHECK_GT( notifications, 0u );
+} FC_LOG_AND_RETHROW() }
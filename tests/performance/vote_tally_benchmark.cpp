@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/**
+ * Measures the maintenance block with 1M voting accounts, and the next one after the stake of 1% of the accounts
+ * changed. Every account votes for one witness and one committee member, every 10th account votes through a proxy.
+ */
+BOOST_FIXTURE_TEST_CASE( vote_tally_benchmark, database_fixture )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+
+   const uint32_t accounts = 1000000;
+   const auto& gpo = db.get_global_properties();
+   vector<vote_id_type> witness_votes;
+   for( const auto& wit : gpo.active_witnesses )
+      witness_votes.push_back( wit(db).vote_id );
+   vector<vote_id_type> committee_votes;
+   for( const auto& cm : gpo.active_committee_members )
+      committee_votes.push_back( cm(db).vote_id );
+
+   const public_key_type key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bench" ) ) )
+                                  .get_public_key();
+   const time_point_sec now = db.head_block_time();
+
+   // the accounts are created directly, as in one_hundred_k_benchmark there is no undo
+   db._undo_db.disable();
+   auto start = fc::time_point::now();
+   vector<account_statistics_id_type> stats_ids;
+   stats_ids.reserve( accounts );
+   account_id_type first_account;
+   for( uint32_t i = 0; i < accounts; ++i )
+   {
+      const auto& acct = db.create<account_object>( [&]( account_object& a ) {
+         a.name = "bench" + fc::to_string( i );
+         a.registrar = a.referrer = a.lifetime_referrer = GRAPHENE_COMMITTEE_ACCOUNT;
+         a.membership_expiration_date = time_point_sec::maximum();
+         a.owner = a.active = authority( 1, key, 1 );
+         a.options.memo_key = key;
+         if( i % 10 == 9 )
+            a.options.voting_account = account_id_type( first_account.instance.value + i / 10 );
+         else
+         {
+            a.options.votes.insert( witness_votes[ i % witness_votes.size() ] );
+            a.options.votes.insert( committee_votes[ i % committee_votes.size() ] );
+            a.options.num_witness = 1;
+            a.options.num_committee = 1;
+         }
+         a.num_committee_voted = a.options.num_committee_voted();
+         a.creation_time = now;
+      });
+      if( i == 0 )
+         first_account = acct.get_id();
+      const auto& stats = db.create<account_statistics_object>( [&]( account_statistics_object& s ) {
+         s.owner = acct.get_id();
+         s.name = acct.name;
+         s.is_voting = true;
+         s.last_vote_time = now;
+         s.total_core_in_orders = 1000 + i % 1000;
+      });
+      db.modify( acct, [&stats]( account_object& a ) { a.statistics = stats.get_id(); } );
+      stats_ids.push_back( stats.get_id() );
+   }
+   db._undo_db.enable();
+   wlog( "Created ${n} voting accounts in ${t} ms",
+         ("n", accounts)("t", (fc::time_point::now() - start).count() / 1000) );
+
+   start = fc::time_point::now();
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   const auto maintenance_time = fc::time_point::now() - start;
+   wlog( "Benchmark: maintenance with ${n} voting accounts took ${t} ms",
+         ("n", accounts)("t", maintenance_time.count() / 1000) );
+
+   BOOST_CHECK( first_account(db).statistics(db).vote_tally_time
+                == db.get_dynamic_global_properties().last_vote_tally_time );
+
+   // the next maintenance only counts the accounts whose stake changed
+   const uint32_t changed = accounts / 100;
+   for( uint32_t i = 0; i < changed; ++i )
+      db.modify( stats_ids[ i * 100 ](db), []( account_statistics_object& s ) { s.total_core_in_orders += 1; } );
+   start = fc::time_point::now();
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   const auto incremental_time = fc::time_point::now() - start;
+   wlog( "Benchmark: maintenance with ${c} of ${n} voting accounts changed took ${t} ms",
+         ("c", changed)("n", accounts)("t", incremental_time.count() / 1000) );
+
+   // there are no orders backing the stakes, remove them for the supply check of the fixture
+   db._undo_db.disable();
+   for( const auto& id : stats_ids )
+      db.modify( id(db), []( account_statistics_object& s ) { s.total_core_in_orders = 0; } );
+   db._undo_db.enable();
+} FC_LOG_AND_RETHROW() }
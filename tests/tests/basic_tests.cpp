@@ -32,6 +32,8 @@
 
 #include <graphene/db/simple_index.hpp>
 
+#include <graphene/protocol/signature_key_cache.hpp>
+
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
 #include "../common/database_fixture.hpp"
@@ -641,6 +643,67 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( merkle_accumulator_test )
+{
+   clearable_block block;
+   merkle_accumulator acc;
+   BOOST_CHECK( acc.root() == block.calculate_merkle_root() );
+
+   for( uint32_t i = 0; i < 100; ++i )
+   {
+      processed_transaction tx;
+      tx.ref_block_prefix = i;
+      block.transactions.push_back( tx );
+      block.clear();
+      acc.append( tx.merkle_digest() );
+      BOOST_CHECK_EQUAL( acc.size(), block.transactions.size() );
+      BOOST_CHECK( acc.root() == block.calculate_merkle_root() );
+   }
+
+   block.clear();
+   BOOST_CHECK( block.calculate_merkle_root( acc ) == acc.root() );
+   acc.append( digest_type() );
+   block.clear();
+   GRAPHENE_CHECK_THROW( block.calculate_merkle_root( acc ), fc::exception );
+
+   acc.clear();
+   BOOST_CHECK_EQUAL( acc.size(), 0u );
+   BOOST_CHECK( acc.root() == checksum_type() );
+}
+
+BOOST_AUTO_TEST_CASE( signature_key_cache_test )
+{
+   const auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "cache" ) ) );
+   const auto digest1 = fc::sha256::hash( std::string( "one" ) );
+   const auto digest2 = fc::sha256::hash( std::string( "two" ) );
+   const auto sig1 = key.sign_compact( digest1 );
+   const auto sig2 = key.sign_compact( digest2 );
+   const public_key_type expected( key.get_public_key() );
+
+   signature_key_cache cache( 1024 );
+   public_key_type found;
+   BOOST_CHECK( !cache.find( digest1, sig1, found ) );
+   BOOST_CHECK( cache.recover( digest1, sig1 ) == expected );
+   BOOST_REQUIRE( cache.find( digest1, sig1, found ) );
+   BOOST_CHECK( found == expected );
+   // the key depends on the digest and the signature
+   BOOST_CHECK( !cache.find( digest2, sig1, found ) );
+   BOOST_CHECK( !cache.find( digest2, sig2, found ) );
+   BOOST_CHECK( cache.recover( digest2, sig2 ) == expected );
+
+   // a wrong key in the cache is returned as it is, which shows that it was not recovered again
+   const public_key_type other( fc::ecc::private_key::regenerate( fc::sha256::hash( std::string( "other" ) ) )
+                                   .get_public_key() );
+   cache.insert( digest1, sig1, other );
+   BOOST_CHECK( cache.recover( digest1, sig1 ) == other );
+
+   cache.resize( 0 );
+   BOOST_CHECK_EQUAL( cache.capacity(), 0u );
+   BOOST_CHECK( !cache.find( digest2, sig2, found ) );
+   BOOST_CHECK( cache.recover( digest1, sig1 ) == expected );
+   BOOST_CHECK( !cache.find( digest1, sig1, found ) );
+}
+
 /**
  * Reproduces https://github.com/bitshares/bitshares-core/issues/888 and tests fix for it.
  */
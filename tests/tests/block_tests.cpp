@@ -40,6 +40,7 @@
 
 #include <fc/crypto/digest.hpp>
 #include <fc/io/fstream.hpp>
+#include <fc/thread/parallel.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -133,6 +134,208 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_mapped_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( !bdb.last().valid() );
+      BOOST_CHECK_EQUAL( bdb.total_block_size(), 0u );
+
+      clearable_block b;
+      std::vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+         // stored blocks are visible to readers without an explicit flush
+         BOOST_CHECK( bdb.contains( b.id() ) );
+         BOOST_CHECK( bdb.fetch_block_id( b.block_num() ) == b.id() );
+      }
+      BOOST_CHECK_GT( bdb.total_block_size(), 0u );
+
+      // concurrent readers
+      std::vector<fc::future<void>> readers;
+      for( uint32_t t = 0; t < 4; ++t )
+         readers.push_back( fc::do_parallel( [&bdb,&ids] () {
+            for( uint32_t i = 1; i <= ids.size(); ++i )
+            {
+               auto blk = bdb.fetch_by_number( i );
+               FC_ASSERT( blk.valid() );
+               FC_ASSERT( blk->id() == ids[i-1] );
+               FC_ASSERT( bdb.fetch_optional( ids[i-1] ).valid() );
+            }
+         } ) );
+      for( auto& reader : readers )
+         reader.wait();
+
+      // packed blocks unpack to the same blocks
+      for( uint32_t i = 1; i <= ids.size(); ++i )
+      {
+         auto packed = bdb.fetch_packed_by_number( i );
+         BOOST_REQUIRE( packed.valid() );
+         BOOST_CHECK( fc::raw::unpack<signed_block>( *packed ).id() == ids[i-1] );
+      }
+
+      bdb.remove( ids[49] );
+      BOOST_CHECK( !bdb.contains( ids[49] ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 50 ).valid() );
+      BOOST_CHECK( !bdb.fetch_packed_by_number( 50 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 51 ).valid() );
+
+      // removing the tail makes last() fall back to the previous block
+      bdb.remove( ids[99] );
+      auto last_id = bdb.last_id();
+      BOOST_REQUIRE( last_id.valid() );
+      BOOST_CHECK( *last_id == ids[98] );
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id().valid() && *bdb.last_id() == ids[98] );
+      BOOST_CHECK( !bdb.fetch_by_number( 100 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 99 ).valid() );
+      BOOST_CHECK_GT( bdb.blocks_current_position(), 0u );
+
+      // blocks stored after the files were mapped are read past the mappings, next to the mapped ones
+      const size_t mapped_size = bdb.total_block_size();
+      b.previous = ids[98];
+      b.witness = witness_id_type(1000);
+      b.clear();
+      bdb.store( b.id(), b );
+      BOOST_CHECK_GT( bdb.total_block_size(), mapped_size );
+      BOOST_CHECK( bdb.contains( b.id() ) );
+      BOOST_REQUIRE( bdb.fetch_by_number( 100 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 100 )->id() == b.id() );
+      BOOST_CHECK( bdb.fetch_packed_by_number( 100 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 99 )->id() == ids[98] );
+      BOOST_CHECK( *bdb.last_id() == b.id() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_archive_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_archive_chunk_size( 10 );
+      bdb.open( data_dir.path() );
+      BOOST_CHECK_EQUAL( bdb.archive_chunk_size(), 10u );
+
+      clearable_block b;
+      std::vector<block_id_type> ids;
+      auto store_blocks = [&b,&ids,&bdb]( uint32_t count ) {
+         for( uint32_t i = 0; i < count; ++i )
+         {
+            if( !ids.empty() ) b.previous = b.id();
+            b.witness = witness_id_type( ids.size() + 1 );
+            b.clear();
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+      };
+      auto check_blocks = [&ids,&bdb]() {
+         for( uint32_t i = 1; i <= ids.size(); ++i )
+         {
+            auto blk = bdb.fetch_by_number( i );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == ids[i-1] );
+            BOOST_CHECK( bdb.fetch_optional( ids[i-1] ).valid() );
+            BOOST_CHECK( bdb.contains( ids[i-1] ) );
+         }
+      };
+
+      store_blocks( 100 );
+      const size_t logical_size = bdb.total_block_size();
+      const uint64_t physical_size = fc::file_size( data_dir.path() / "blocks" );
+
+      // only complete chunks of irreversible blocks are archived
+      bdb.archive_blocks( 8 );
+      BOOST_CHECK_EQUAL( bdb.archived_chunk_count(), 0u );
+      bdb.archive_blocks( 9 );
+      BOOST_CHECK_EQUAL( bdb.archived_chunk_count(), 1u );
+      check_blocks();
+
+      // most of the blocks file is archived now, so it gets compacted
+      bdb.archive_blocks( 85 );
+      BOOST_CHECK_EQUAL( bdb.archived_chunk_count(), 8u );
+      BOOST_CHECK_EQUAL( bdb.total_block_size(), logical_size );
+      BOOST_CHECK_LT( fc::file_size( data_dir.path() / "blocks" ), physical_size );
+      check_blocks();
+
+      store_blocks( 20 );
+      check_blocks();
+
+      bdb.close();
+      bdb.set_archive_chunk_size( 0 );
+      bdb.open( data_dir.path() );
+      // the archive is still read after archiving is disabled
+      BOOST_CHECK_EQUAL( bdb.archive_chunk_size(), 10u );
+      check_blocks();
+      BOOST_CHECK( bdb.last_id().valid() && *bdb.last_id() == ids.back() );
+      bdb.archive_blocks( 119 );
+      BOOST_CHECK_EQUAL( bdb.archived_chunk_count(), 8u );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_compacted_reopen_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      clearable_block b;
+      std::vector<block_id_type> ids;
+      {
+         block_database bdb;
+         bdb.set_archive_chunk_size( 10 );
+         bdb.open( data_dir.path() );
+         for( uint32_t i = 0; i < 50; ++i )
+         {
+            if( !ids.empty() ) b.previous = b.id();
+            b.witness = witness_id_type( ids.size() + 1 );
+            b.clear();
+            bdb.store( b.id(), b );
+            ids.push_back( b.id() );
+         }
+         const uint64_t physical_size = fc::file_size( data_dir.path() / "blocks" );
+         bdb.archive_blocks( 39 );
+         BOOST_CHECK_EQUAL( bdb.archived_chunk_count(), 4u );
+         // the blocks file is compacted, so the logical positions of the tail are beyond its size
+         BOOST_REQUIRE_LT( fc::file_size( data_dir.path() / "blocks" ), physical_size );
+         bdb.close();
+      }
+
+      // the tail of the chain is not cut off when the store is opened again
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == ids.back() );
+      auto head = bdb.fetch_by_number( ids.size() );
+      BOOST_REQUIRE( head.valid() );
+      BOOST_CHECK( head->id() == ids.back() );
+      auto archived = bdb.fetch_by_number( 1 );
+      BOOST_REQUIRE( archived.valid() );
+      BOOST_CHECK( archived->id() == ids.front() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -192,6 +395,108 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( state_checkpoint_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      uint32_t last_block;
+      std::map<uint32_t, block_id_type> irreversible_ids;
+      {
+         database db;
+         db.set_state_checkpoints( 10, 2 );
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 50 )
+         {
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                               database::skip_nothing );
+            irreversible_ids[ db.get_dynamic_global_properties().last_irreversible_block_num ]
+                  = db.get_block_id_for_num( db.get_dynamic_global_properties().last_irreversible_block_num );
+         }
+         last_block = db.head_block_num();
+         BOOST_CHECK_GT( last_block, db.get_dynamic_global_properties().last_irreversible_block_num );
+         // no close(), as if the node was killed
+      }
+      BOOST_CHECK( fc::exists( data_dir.path() / "open_state_head" ) );
+      BOOST_CHECK( !fc::exists( data_dir.path() / "object_database" ) );
+      size_t checkpoints = 0;
+      for( fc::directory_iterator itr( data_dir.path() / "checkpoints" ); itr != fc::directory_iterator(); ++itr )
+      {
+         ++checkpoints;
+         if( (*itr).extension().generic_string() == ".tmp" ) // still being written
+            continue;
+         // checkpoints are taken at the last irreversible block, not at the head
+         const uint32_t num = std::stoul( (*itr).filename().generic_string() );
+         BOOST_REQUIRE( irreversible_ids.count( num ) > 0 );
+         std::string head_id;
+         fc::read_file_contents( *itr / "head_block_id", head_id );
+         BOOST_CHECK( block_id_type( head_id ) == irreversible_ids[num] );
+      }
+      BOOST_CHECK_GE( checkpoints, 1u );
+      BOOST_CHECK_LE( checkpoints, 2u );
+      {
+         database db;
+         db.set_state_checkpoints( 10, 2 );
+         // the state comes from a checkpoint, so the genesis state is not needed
+         db.open(data_dir.path(), []() -> genesis_state_type { FC_THROW( "Replaying from genesis" ); }, "TEST");
+         BOOST_CHECK_EQUAL( db.head_block_num(), last_block );
+         db.close();
+      }
+      BOOST_CHECK( !fc::exists( data_dir.path() / "open_state_head" ) );
+      BOOST_CHECK( fc::exists( data_dir.path() / "object_database" ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( trusted_catch_up_test )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis, "TEST");
+      for( uint32_t i = 0; i < 30; ++i )
+         db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key,
+                             database::skip_nothing );
+
+      database db2;
+      // the testing genesis is far in the past, so every block is applied in trusted catch-up mode
+      db2.set_trusted_catch_up( 60, 7 );
+      db2.open(data_dir2.path(), make_genesis, "TEST");
+      uint32_t applied_blocks = 0;
+      db2.applied_block.connect( [&applied_blocks]( const signed_block& ) { ++applied_blocks; } );
+      for( uint32_t num = 1; num <= 20; ++num )
+         PUSH_BLOCK( db2, *db1.fetch_block_by_number( num ) );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 20u );
+      BOOST_CHECK( db2.head_block_id() == db1.get_block_id_for_num( 20 ) );
+      BOOST_CHECK_EQUAL( applied_blocks, 20u );
+
+      // a bad block is undone alone, the valid blocks of the open batch are not applied again
+      signed_block bad_block = *db1.fetch_block_by_number( 21 );
+      bad_block.timestamp += db2.block_interval();
+      BOOST_CHECK_THROW( PUSH_BLOCK( db2, bad_block ), fc::exception );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 20u );
+      BOOST_CHECK( db2.get_dynamic_global_properties().head_block_id == db1.get_block_id_for_num( 20 ) );
+      BOOST_CHECK_EQUAL( applied_blocks, 20u );
+
+      for( uint32_t num = 21; num <= 30; ++num )
+         PUSH_BLOCK( db2, *db1.fetch_block_by_number( num ) );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( db2.get_dynamic_global_properties().current_aslot
+                   == db1.get_dynamic_global_properties().current_aslot );
+
+      // the caught up blocks are not in the undo history
+      BOOST_CHECK_THROW( db2.pop_block(), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -1105,6 +1410,149 @@ BOOST_FIXTURE_TEST_CASE( pop_block_twice, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( lazy_pending_restore, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice_id(db), asset(100000) );
+   generate_block();
+   set_expiration( db, trx );
+
+   transfer( alice_id, bob_id, asset(100) );
+   const signed_block block = generate_block();
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), 1u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 100 );
+
+   // pop the block and push another transaction, then push the block again
+   db.pop_block();
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 0 );
+   transfer( alice_id, bob_id, asset(10) );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 10 );
+
+   db.set_lazy_pending_restore( true );
+   PUSH_BLOCK( db, block );
+   // the transaction in the block is dropped, the other one is queued but not applied yet
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 1u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 100 );
+
+   // a new transaction is applied after the queued one
+   transfer( alice_id, bob_id, asset(1) );
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 0u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 111 );
+
+   // generating a block applies the queued transactions without restoring them first
+   db.pop_block();
+   PUSH_BLOCK( db, block );
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 2u );
+   const signed_block next = generate_block();
+   BOOST_CHECK_EQUAL( next.transactions.size(), 2u );
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 0u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 111 );
+
+   // without lazy restore the pending transactions are applied right away
+   db.set_lazy_pending_restore( false );
+   transfer( alice_id, bob_id, asset(1000) );
+   db.pop_block();
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 0u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 100 );
+   PUSH_BLOCK( db, next );
+   BOOST_CHECK_EQUAL( db.queued_pending_transaction_count(), 0u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1111 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( parallel_authority_checks, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice_id(db), asset(100000) );
+   generate_block();
+
+   const fc::ecc::private_key alice_new_key = generate_private_key( "alice_new" );
+   auto make_transfer = [&]( share_type amount, const fc::ecc::private_key& key ) {
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset( amount );
+      tx.operations.push_back( op );
+      set_expiration( db, tx );
+      sign( tx, key );
+      return tx;
+   };
+
+   // the third transaction is signed with the key set by the second one
+   signed_transaction key_change;
+   account_update_operation uop;
+   uop.account = alice_id;
+   uop.active = authority( 1, public_key_type( alice_new_key.get_public_key() ), 1 );
+   key_change.operations.push_back( uop );
+   set_expiration( db, key_change );
+   sign( key_change, alice_private_key );
+
+   PUSH_TX( db, make_transfer( 100, alice_private_key ) );
+   PUSH_TX( db, key_change );
+   PUSH_TX( db, make_transfer( 10, alice_new_key ) );
+   const signed_block block = generate_block();
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+   db.pop_block();
+
+   db.set_parallel_authority_checks( true, true );
+   PUSH_BLOCK( db, block, database::skip_nothing );
+   BOOST_CHECK( db.head_block_id() == block.id() );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 110 );
+
+   // a transaction signed with the old key passes its precheck, but must fail after the key change
+   db.pop_block();
+   signed_block bad_block;
+   bad_block.previous = block.previous;
+   bad_block.timestamp = block.timestamp;
+   bad_block.witness = block.witness;
+   bad_block.transactions = block.transactions;
+   bad_block.transactions.emplace_back( make_transfer( 1, alice_private_key ) );
+   bad_block.transaction_merkle_root = bad_block.calculate_merkle_root();
+   bad_block.sign( init_account_priv_key );
+   BOOST_CHECK_THROW( PUSH_BLOCK( db, bad_block, database::skip_nothing ), fc::exception );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 110 ); // the pending transactions
+
+   PUSH_BLOCK( db, block, database::skip_nothing );
+   BOOST_CHECK( db.head_block_id() == block.id() );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 110 );
+   db.set_parallel_authority_checks( false, false );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( candidate_block, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice_id(db), asset(100000) );
+   generate_block();
+   set_expiration( db, trx );
+
+   db.set_candidate_block( true );
+   transfer( alice_id, bob_id, asset(100) ); // not in the candidate, it was pushed before the block
+   generate_block();
+   BOOST_CHECK_EQUAL( db.candidate_transaction_count(), 0u );
+
+   transfer( alice_id, bob_id, asset(10) );
+   transfer( alice_id, bob_id, asset(20) );
+   transfer( alice_id, bob_id, asset(30) );
+   BOOST_CHECK_EQUAL( db.candidate_transaction_count(), 3u );
+
+   // the block made from the candidate is the same as the one made by applying the transactions again
+   const signed_block from_candidate = generate_block();
+   BOOST_CHECK_EQUAL( from_candidate.transactions.size(), 3u );
+   BOOST_CHECK_EQUAL( db.candidate_transaction_count(), 0u );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 160 );
+
+   db.pop_block();
+   BOOST_CHECK_EQUAL( db.candidate_transaction_count(), 0u );
+   db.set_candidate_block( false );
+   db.clear_pending();
+   for( const auto& tx : from_candidate.transactions )
+      PUSH_TX( db, tx, ~0 );
+   const signed_block rebuilt = generate_block();
+   BOOST_CHECK( rebuilt.transaction_merkle_root == from_candidate.transaction_merkle_root );
+   BOOST_CHECK( rebuilt.id() == from_candidate.id() );
+   BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 160 );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_FIXTURE_TEST_CASE( rsf_missed_blocks, database_fixture )
 {
    try
@@ -29,6 +29,7 @@
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/io/json.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -1090,6 +1091,164 @@ BOOST_AUTO_TEST_CASE( subscription_notification_test )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( shared_notification_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   const auto& uia = create_user_issued_asset( "UIATEST" );
+   const asset_id_type uia_id = uia.get_id();
+   issue_uia( alice_id, uia.amount(1000) );
+   transfer( committee_account, bob_id, asset(1000) );
+   generate_block();
+
+   const string core_name = string( object_id_type( asset_id_type() ) );
+   const string uia_name = string( object_id_type( uia_id ) );
+
+   // the sessions get the same notifications of the market and of the blocks
+   uint32_t market_updates1 = 0;
+   uint32_t market_updates2 = 0;
+   string last_market_update1;
+   string last_market_update2;
+   uint32_t blocks1 = 0;
+   uint32_t blocks2 = 0;
+
+   graphene::app::database_api db_api1( db );
+   db_api1.subscribe_to_market( [&]( const variant& v ) {
+      ++market_updates1;
+      last_market_update1 = fc::json::to_string( v );
+   }, uia_name, core_name );
+   db_api1.set_block_applied_callback( [&]( const variant& ) { ++blocks1; } );
+
+   graphene::app::database_api db_api2( db );
+   db_api2.subscribe_to_market( [&]( const variant& v ) {
+      ++market_updates2;
+      last_market_update2 = fc::json::to_string( v );
+   }, core_name, uia_name );
+   db_api2.set_block_applied_callback( [&]( const variant& ) { ++blocks2; } );
+
+   // a session that is freed is not notified anymore
+   {
+      uint32_t blocks3 = 0;
+      graphene::app::database_api db_api3( db );
+      db_api3.set_block_applied_callback( [&blocks3]( const variant& ) { ++blocks3; } );
+      generate_block();
+      fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+      BOOST_CHECK_EQUAL( blocks3, 1u );
+   }
+
+   create_sell_order( alice_id, uia.amount(100), asset(100) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_GT( market_updates1, 0u );
+   BOOST_CHECK_EQUAL( market_updates1, market_updates2 );
+   BOOST_CHECK_EQUAL( last_market_update1, last_market_update2 );
+
+   // the order is filled
+   const uint32_t updates_before_fill = market_updates1;
+   create_sell_order( bob_id, asset(100), uia.amount(100) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_GT( market_updates1, updates_before_fill );
+   BOOST_CHECK_EQUAL( market_updates1, market_updates2 );
+   BOOST_CHECK_EQUAL( last_market_update1, last_market_update2 );
+
+   BOOST_CHECK_EQUAL( blocks1, 3u );
+   BOOST_CHECK_EQUAL( blocks2, 3u );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( subscribed_objects_limit_test )
+{ try {
+   const object_id_type dgp_id = dynamic_global_property_id_type();
+   const object_id_type uia1_id = create_user_issued_asset( "UIATESTA" ).id;
+   const object_id_type uia2_id = create_user_issued_asset( "UIATESTB" ).id;
+   generate_block();
+
+   uint32_t objects_changed = 0;
+   graphene::app::application_options opt;
+   opt.api_limit_subscribed_objects = 2;
+   graphene::app::database_api db_api( db, &opt );
+   db_api.set_subscribe_callback( [&objects_changed]( const variant& ) { ++objects_changed; }, false );
+
+   // the dynamic global properties change in every block, the assets do not
+   db_api.get_objects( { dgp_id } );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_EQUAL( objects_changed, 1u );
+
+   // beyond the limit, the least recently used subscription is dropped
+   db_api.get_objects( { uia1_id } );
+   db_api.get_objects( { uia2_id } );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_EQUAL( objects_changed, 1u );
+
+   // querying an object again makes it the most recently used one, so the other one is dropped
+   db_api.get_objects( { dgp_id } );
+   db_api.get_objects( { uia1_id } );
+   db_api.get_objects( { dgp_id } );
+   db_api.get_objects( { uia2_id } );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_EQUAL( objects_changed, 2u );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( unsubscribe_and_cancel_subscriptions_test )
+{ try {
+   ACTORS( (alice) );
+   const auto& uia = create_user_issued_asset( "UIATEST" );
+   issue_uia( alice_id, uia.amount(1000) );
+   generate_block();
+
+   const string core_name = string( object_id_type( asset_id_type() ) );
+   const string uia_name = string( object_id_type( uia.get_id() ) );
+   const object_id_type dgp_id = dynamic_global_property_id_type();
+
+   uint32_t market_updates1 = 0;
+   uint32_t market_updates2 = 0;
+   uint32_t market_updates3 = 0;
+   uint32_t objects_changed2 = 0;
+   uint32_t objects_changed3 = 0;
+
+   graphene::app::database_api db_api1( db );
+   db_api1.subscribe_to_market( [&]( const variant& ) { ++market_updates1; }, uia_name, core_name );
+
+   graphene::app::database_api db_api2( db );
+   db_api2.set_subscribe_callback( [&]( const variant& ) { ++objects_changed2; }, false );
+   db_api2.subscribe_to_market( [&]( const variant& ) { ++market_updates2; }, uia_name, core_name );
+   db_api2.get_objects( { dgp_id } );
+
+   graphene::app::database_api db_api3( db );
+   db_api3.set_subscribe_callback( [&]( const variant& ) { ++objects_changed3; }, false );
+   db_api3.subscribe_to_market( [&]( const variant& ) { ++market_updates3; }, core_name, uia_name );
+   db_api3.get_objects( { dgp_id } );
+
+   create_sell_order( alice_id, uia.amount(100), asset(100) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_GT( market_updates1, 0u );
+   BOOST_CHECK_EQUAL( market_updates2, market_updates1 );
+   BOOST_CHECK_EQUAL( market_updates3, market_updates1 );
+   BOOST_CHECK_EQUAL( objects_changed2, 1u );
+   BOOST_CHECK_EQUAL( objects_changed3, 1u );
+
+   // only the session which unsubscribed from the market is not notified anymore
+   const uint32_t market_updates_before = market_updates1;
+   db_api1.unsubscribe_from_market( core_name, uia_name );
+   // all subscriptions of the session are removed, the other sessions keep theirs
+   db_api2.cancel_all_subscriptions();
+
+   create_sell_order( alice_id, uia.amount(100), asset(100) );
+   generate_block();
+   fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+   BOOST_CHECK_EQUAL( market_updates1, market_updates_before );
+   BOOST_CHECK_EQUAL( market_updates2, market_updates_before );
+   BOOST_CHECK_GT( market_updates3, market_updates_before );
+   BOOST_CHECK_EQUAL( objects_changed2, 1u );
+   BOOST_CHECK_EQUAL( objects_changed3, 2u );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( get_all_workers )
 { try {
    graphene::app::database_api db_api( db, &( app.get_options() ));
@@ -29,6 +29,8 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -138,6 +140,171 @@ BOOST_AUTO_TEST_CASE( merge_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( object_id_map_test )
+{ try {
+   graphene::db::object_id_map<uint64_t> map;
+   graphene::db::object_id_set set;
+   std::map<object_id_type, uint64_t> expected;
+   // insert, overwrite and erase enough IDs of two types to rehash several times
+   for( uint64_t i = 0; i < 5000; ++i )
+   {
+      object_id_type id( 1, 2 + ( i % 2 ), i / 2 );
+      map[id] = i;
+      set.insert( id );
+      expected[id] = i;
+      if( i % 3 == 0 )
+      {
+         object_id_type old_id( 1, 2 + ( i % 2 ), i / 4 );
+         BOOST_CHECK_EQUAL( map.erase( old_id ), expected.erase( old_id ) );
+         set.erase( old_id );
+      }
+   }
+   BOOST_CHECK_EQUAL( map.size(), expected.size() );
+   BOOST_CHECK_EQUAL( set.size(), expected.size() );
+   size_t count = 0;
+   for( const auto& item : map )
+   {
+      ++count;
+      BOOST_REQUIRE( expected.count( item.first ) > 0 );
+      BOOST_CHECK_EQUAL( item.second, expected[item.first] );
+      BOOST_CHECK( set.count( item.first ) > 0 );
+   }
+   BOOST_CHECK_EQUAL( count, expected.size() );
+   for( const auto& item : expected )
+   {
+      auto itr = map.find( item.first );
+      BOOST_REQUIRE( itr != map.end() );
+      BOOST_CHECK_EQUAL( itr->second, item.second );
+   }
+   BOOST_CHECK( map.find( object_id_type( 1, 4, 0 ) ) == map.end() );
+   BOOST_CHECK( !set.insert( expected.begin()->first ).second );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( undo_merge_arena_test )
+{ try {
+   database db;
+   const auto& obj1 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } );
+   const auto& obj2 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 2; } );
+   const account_balance_id_type id1 = obj1.id;
+   const account_balance_id_type id2 = obj2.id;
+   {
+      auto outer = db._undo_db.start_undo_session( true );
+      db.modify( obj1, []( account_balance_object& obj ){ obj.balance = 10; } );
+      {
+         auto inner = db._undo_db.start_undo_session();
+         // saved in the arena of the inner state, which is handed to the outer state on merge
+         db.modify( obj2, []( account_balance_object& obj ){ obj.balance = 20; } );
+         db.remove( obj1 );
+         db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 3; } );
+         inner.merge();
+      }
+      // more sessions reuse the released memory
+      for( int i = 0; i < 100; ++i )
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( id2(db), [i]( account_balance_object& obj ){ obj.balance = i; } );
+      }
+      BOOST_CHECK( db.find( id1 ) == nullptr );
+      BOOST_CHECK_EQUAL( id2(db).balance.value, 20 );
+   }
+   BOOST_CHECK_EQUAL( id1(db).balance.value, 1 );
+   BOOST_CHECK_EQUAL( id2(db).balance.value, 2 );
+   BOOST_CHECK( db.find( id2 + 1 ) == nullptr );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( object_database_delta_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   account_balance_id_type id1, id2, id3, id4;
+   {
+      database db1;
+      db1.set_max_deltas( 2 );
+      db1.object_database::open( data_dir.path() );
+      id1 = db1.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } ).id;
+      id2 = db1.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 2; } ).id;
+      // without a complete state this writes all objects
+      db1.flush_delta();
+      BOOST_CHECK_EQUAL( 0u, db1.delta_count() );
+
+      id3 = db1.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 3; } ).id;
+      db1.modify( id1(db1), []( account_balance_object& obj ){ obj.balance = 10; } );
+      db1.remove( id2(db1) );
+      db1.flush_delta();
+      BOOST_CHECK_EQUAL( 1u, db1.delta_count() );
+      db1.close();
+   }
+   {
+      database db2;
+      db2.set_max_deltas( 2 );
+      db2.object_database::open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 10, id1(db2).balance.value );
+      BOOST_CHECK( db2.find( id2 ) == nullptr );
+      BOOST_CHECK_EQUAL( 3, id3(db2).balance.value );
+
+      db2.modify( id3(db2), []( account_balance_object& obj ){ obj.balance = 30; } );
+      db2.flush_delta();
+      id4 = db2.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 4; } ).id;
+      // the third delta exceeds the limit and starts merging
+      db2.flush_delta();
+      db2.close();
+      BOOST_CHECK_EQUAL( 0u, db2.delta_count() );
+   }
+   {
+      database db3;
+      db3.object_database::open( data_dir.path() );
+      BOOST_CHECK_EQUAL( 10, id1(db3).balance.value );
+      BOOST_CHECK( db3.find( id2 ) == nullptr );
+      BOOST_CHECK_EQUAL( 30, id3(db3).balance.value );
+      BOOST_CHECK_EQUAL( 4, id4(db3).balance.value );
+      const auto& obj5 = db3.create<account_balance_object>( []( account_balance_object& obj ){} );
+      BOOST_CHECK( obj5.id > object_id_type( id4 ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( chunked_open_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const uint32_t count = index_chunk_objects * 5 / 2;
+   const fc::path file = data_dir.path() / "object_database" / fc::to_string( account_balance_object::space_id )
+                         / fc::to_string( account_balance_object::type_id );
+   {
+      database db1;
+      db1.object_database::open( data_dir.path() );
+      for( uint32_t i = 0; i < count; ++i )
+         db1.create<account_balance_object>( [i]( account_balance_object& obj ){ obj.balance = i; } );
+      db1.flush();
+      db1.close();
+   }
+   BOOST_REQUIRE( fc::exists( index_chunk_table( file ) ) );
+
+   auto check = [&data_dir,count]() {
+      database db;
+      db.object_database::open( data_dir.path() );
+      const auto& idx = db.get_index_type<account_balance_index>().indices();
+      BOOST_REQUIRE_EQUAL( idx.size(), count );
+      uint32_t i = 0;
+      for( const auto& obj : idx )
+      {
+         BOOST_CHECK_EQUAL( obj.id.instance(), i );
+         BOOST_CHECK_EQUAL( obj.balance.value, i );
+         ++i;
+      }
+      // the next ID is restored as well
+      BOOST_CHECK_EQUAL( db.create<account_balance_object>( []( account_balance_object& ){} ).id.instance(), count );
+   };
+   // three chunks from the table
+   check();
+   // a table which does not match the file is ignored
+   {
+      std::ofstream out( index_chunk_table( file ).generic_string(), std::ofstream::binary | std::ofstream::trunc );
+      out << "garbage";
+   }
+   check();
+   // without a table the chunks are found by a scan
+   fc::remove( index_chunk_table( file ) );
+   check();
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( direct_index_test )
 { try {
    try {
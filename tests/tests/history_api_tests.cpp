@@ -26,6 +26,9 @@
 
 #include <graphene/app/api.hpp>
 
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/history_store.hpp>
+
 #include <graphene/chain/hardfork.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
@@ -920,6 +923,194 @@ BOOST_AUTO_TEST_CASE(min_blocks_to_keep_test) {
    }
 }
 
+BOOST_AUTO_TEST_CASE(history_store_test) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      // max-ops-per-account = 3
+      // min-blocks-to-keep = 0
+      // history-store = true
+
+      //account_id_type() creates the accounts
+      for( int i = 0; i < 20; ++i )
+         create_account( "storeacct" + std::to_string(i) );
+      generate_block();
+      const uint32_t ops_block = db.head_block_num();
+
+      // the history is moved to the store once its block is irreversible
+      generate_blocks( 30 );
+      BOOST_REQUIRE_GE( db.get_dynamic_global_properties().last_irreversible_block_num, ops_block );
+
+      const auto& stats = account_id_type()(db).statistics(db);
+      BOOST_REQUIRE_GE( stats.total_ops, 20u );
+      BOOST_CHECK_EQUAL( stats.removed_ops, stats.total_ops - 3 );
+
+      const auto& by_seq_idx = db.get_index_type<account_history_index>().indices().get<by_seq>();
+      size_t in_memory = 0;
+      for( auto itr = by_seq_idx.lower_bound( account_id_type() );
+           itr != by_seq_idx.end() && itr->account == account_id_type(); ++itr )
+         ++in_memory;
+      BOOST_CHECK_EQUAL( in_memory, 3u );
+
+      const vector<operation_history_object> all = hist_api.get_relative_account_history( "1.2.0", 0, 100, 0 );
+      BOOST_REQUIRE_EQUAL( all.size(), stats.total_ops );
+      for( size_t i = 1; i < all.size(); ++i )
+         BOOST_CHECK( all[i].id < all[i-1].id );
+
+      // the history by operation ID continues in the store
+      vector<operation_history_object> histories = hist_api.get_account_history( "1.2.0",
+                                                      operation_history_id_type(), 100, operation_history_id_type() );
+      BOOST_REQUIRE_EQUAL( histories.size(), all.size() );
+      for( size_t i = 0; i < histories.size(); ++i )
+         BOOST_CHECK( histories[i].id == all[i].id );
+
+      histories = hist_api.get_account_history( "1.2.0", all[15].id, 5, all[8].id );
+      BOOST_REQUIRE_EQUAL( histories.size(), 5u );
+      BOOST_CHECK( histories.front().id == all[8].id );
+      BOOST_CHECK( histories.back().id == all[12].id );
+
+      // the sequence numbers from 10 down to 7
+      histories = hist_api.get_relative_account_history( "1.2.0", 2, 4, 10 );
+      BOOST_REQUIRE_EQUAL( histories.size(), 4u );
+      BOOST_CHECK( histories.front().id == all[ all.size() - 10 ].id );
+      BOOST_CHECK( histories.back().id == all[ all.size() - 7 ].id );
+
+      int account_create_op_id = operation::tag<account_create_operation>::value;
+      histories = hist_api.get_account_history_operations( "1.2.0", account_create_op_id,
+                                                           operation_history_id_type(),
+                                                           operation_history_id_type(), 100 );
+      BOOST_CHECK_EQUAL( histories.size(), 20u );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(history_time_index_test) {
+   try {
+      graphene::app::history_api hist_api(app);
+
+      // max-ops-per-account = 5
+      // min-blocks-to-keep = 0
+      // history-store = true
+      // history-time-index-interval = 4
+
+      //account_id_type() creates the accounts, a few in each block
+      for( int i = 0; i < 30; ++i )
+      {
+         create_account( "timeacct" + std::to_string(i) );
+         if( i % 3 == 2 )
+            generate_block();
+      }
+      generate_blocks( 30 );
+
+      const auto& stats = account_id_type()(db).statistics(db);
+      BOOST_REQUIRE_GE( stats.total_ops, 30u );
+      BOOST_CHECK_GT( stats.removed_ops, 0u );
+
+      // every 4th entry is marked, the marks of the stored history are kept
+      const auto& mark_idx = db.get_index_type<graphene::account_history::history_time_mark_index>()
+                               .indices().get<by_seq>();
+      size_t marks = 0;
+      for( auto itr = mark_idx.lower_bound( account_id_type() );
+           itr != mark_idx.end() && itr->account == account_id_type(); ++itr )
+      {
+         BOOST_CHECK_EQUAL( itr->sequence % 4, 1u );
+         ++marks;
+      }
+      BOOST_CHECK_EQUAL( marks, ( stats.total_ops + 3 ) / 4 );
+
+      const vector<operation_history_object> all = hist_api.get_relative_account_history( "1.2.0", 0, 100, 0 );
+      BOOST_REQUIRE_EQUAL( all.size(), stats.total_ops );
+
+      // the history before each time, from memory and from the store
+      for( const auto& o : all )
+      {
+         for( const auto& time : { o.block_time, o.block_time - 1 } )
+         {
+            vector<operation_history_id_type> expected;
+            for( const auto& e : all )
+               if( e.block_time <= time && expected.size() < 7 )
+                  expected.push_back( e.get_id() );
+            const auto histories = hist_api.get_account_history_by_time( "1.2.0", 7, time );
+            BOOST_REQUIRE_EQUAL( histories.size(), expected.size() );
+            for( size_t i = 0; i < histories.size(); ++i )
+               BOOST_CHECK( histories[i].get_id() == expected[i] );
+         }
+      }
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(history_store_persistence) {
+   try {
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      const account_id_type account( 1 );
+      const uint64_t count = 1500; // the postings of the account span several pages
+
+      {
+         graphene::account_history::history_store store( dir.path(), 1024 * 1024 );
+         operation_history_object op;
+         for( uint64_t i = 0; i < count; ++i )
+         {
+            // the operations span several segments
+            op.id = operation_history_id_type( i * 1000 );
+            op.block_num = static_cast<uint32_t>( i );
+            store.store_operation( op );
+            store.append_account_history( account, i + 1, op.get_id() );
+         }
+         // stored entries are skipped
+         op.id = operation_history_id_type( 0 );
+         op.block_num = 12345;
+         store.store_operation( op );
+         store.append_account_history( account, 1, operation_history_id_type( 7 ) );
+      }
+
+      // a cache of a few pages is enough
+      graphene::account_history::history_store store( dir.path(), 0 );
+      for( uint64_t i = 0; i < count; ++i )
+      {
+         const auto op_id = store.get_account_history_entry( account, i + 1 );
+         BOOST_REQUIRE( op_id.valid() );
+         BOOST_CHECK_EQUAL( op_id->instance.value, i * 1000 );
+         const auto op = store.get_operation( *op_id );
+         BOOST_REQUIRE( op.valid() );
+         BOOST_CHECK_EQUAL( op->block_num, i );
+      }
+      BOOST_CHECK( !store.get_operation( operation_history_id_type( 1 ) ).valid() );
+      BOOST_CHECK( !store.get_account_history_entry( account, count + 1 ).valid() );
+      BOOST_CHECK( !store.get_account_history_entry( account_id_type( 2 ), 1 ).valid() );
+
+      BOOST_CHECK_EQUAL( store.find_account_history_entry( account, operation_history_id_type( count * 1000 ), count ),
+                         count );
+      BOOST_CHECK_EQUAL( store.find_account_history_entry( account, operation_history_id_type( 2500 ), count ), 3u );
+      BOOST_CHECK_EQUAL( store.find_account_history_entry( account, operation_history_id_type( 999 ), count ), 1u );
+      BOOST_CHECK_EQUAL( store.find_account_history_entry( account, operation_history_id_type( 2500 ), 2 ), 2u );
+      BOOST_CHECK_EQUAL( store.find_account_history_entry( account_id_type( 2 ), operation_history_id_type( 2500 ),
+                                                           count ), 0u );
+
+      // a gap in the sequence numbers drops the stored history of the account
+      store.append_account_history( account, count + 100, operation_history_id_type( count * 1000 ) );
+      BOOST_CHECK( !store.get_account_history_entry( account, 1 ).valid() );
+      BOOST_CHECK( store.get_account_history_entry( account, count + 100 ).valid() );
+      store.flush();
+
+      graphene::account_history::history_store reopened( dir.path(), 0 );
+      BOOST_CHECK( !reopened.get_account_history_entry( account, 1 ).valid() );
+      const auto op_id = reopened.get_account_history_entry( account, count + 100 );
+      BOOST_REQUIRE( op_id.valid() );
+      BOOST_CHECK_EQUAL( op_id->instance.value, count * 1000 );
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE(get_account_history_operations) {
    try {
       graphene::app::history_api hist_api(app);
@@ -988,6 +1179,96 @@ BOOST_AUTO_TEST_CASE(get_account_history_operations) {
       throw;
    }
 }
+BOOST_AUTO_TEST_CASE(history_by_operation_type_test) {
+   try {
+      graphene::app::history_api hist_api(app);
+      BOOST_REQUIRE( app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" )
+                        ->get_operation_type_history_index() != nullptr );
+
+      ACTORS( (alice) );
+      for( int i = 0; i < 40; ++i )
+      {
+         transfer( account_id_type(), alice_id, asset(1) );
+         if( i % 4 == 0 )
+            create_account( "mytempacct" + std::to_string(i) );
+         if( i % 10 == 0 )
+            generate_block();
+      }
+      generate_block();
+
+      const int transfer_op_id = operation::tag<transfer_operation>::value;
+      const int account_create_op_id = operation::tag<account_create_operation>::value;
+      const int asset_create_op_id = operation::tag<asset_create_operation>::value;
+
+      const auto filter = []( const vector<operation_history_object>& objs, const flat_set<uint16_t>& types ) {
+         vector<operation_history_id_type> result;
+         for( const auto& o : objs )
+            if( types.find( o.op.which() ) != types.end() )
+               result.push_back( o.get_id() );
+         return result;
+      };
+      const auto ids = []( const vector<operation_history_object>& objs ) {
+         vector<operation_history_id_type> result;
+         for( const auto& o : objs )
+            result.push_back( o.get_id() );
+         return result;
+      };
+
+      // the results are the same as the ones of the whole history filtered by operation type
+      const auto check = [&]() {
+         const auto all = hist_api.get_relative_account_history( "committee-account", 0, 100, 0 );
+         BOOST_REQUIRE_GT( all.size(), 10u );
+         for( const int op_type : { transfer_op_id, account_create_op_id, asset_create_op_id } )
+         {
+            const flat_set<uint16_t> types { static_cast<uint16_t>( op_type ) };
+            BOOST_CHECK( ids( hist_api.get_account_history_operations( "committee-account", op_type,
+                                 operation_history_id_type(), operation_history_id_type(), 100 ) )
+                         == filter( all, types ) );
+
+            // from the middle of the history, stopping before the end
+            const auto start = all[3].get_id();
+            const auto stop = all[all.size() - 4].get_id();
+            vector<operation_history_object> expected;
+            for( const auto& o : all )
+               if( o.id.instance() <= start.instance.value && o.id.instance() > stop.instance.value )
+                  expected.push_back( o );
+            auto expected_ids = filter( expected, types );
+            if( expected_ids.size() > 3 )
+               expected_ids.resize( 3 );
+            BOOST_CHECK( ids( hist_api.get_account_history_operations( "committee-account", op_type,
+                                                                       start, stop, 3 ) ) == expected_ids );
+         }
+
+         const flat_set<uint16_t> types { static_cast<uint16_t>( transfer_op_id ),
+                                          static_cast<uint16_t>( account_create_op_id ) };
+         for( const auto& window : { std::make_pair( 0u, 10u ), std::make_pair( 1u, 1u ), std::make_pair( 0u, 1u ),
+                                     std::make_pair( 5u, 20u ), std::make_pair( 30u, 100u ) } )
+         {
+            const auto objs = hist_api.get_relative_account_history( "committee-account", window.first, window.second,
+                                                                     window.second + window.first - 1 );
+            const auto detail = hist_api.get_account_history_by_operations( "committee-account", types,
+                                                                            window.first, window.second );
+            BOOST_CHECK_EQUAL( detail.total_count, objs.size() );
+            BOOST_CHECK( ids( detail.operation_history_objs ) == filter( objs, types ) );
+         }
+      };
+
+      check();
+
+      // the index follows the removal of old history and undone blocks
+      for( int i = 0; i < 10; ++i )
+         transfer( account_id_type(), alice_id, asset(1) );
+      generate_block();
+      check();
+      db.pop_block();
+      check();
+
+   } catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 //new test case for increasing the limit based on the config file
 BOOST_AUTO_TEST_CASE(api_limit_get_account_history_operations) {
  try {
@@ -326,6 +326,28 @@ public:
          }).wait();
    }
 
+   void activate_test_peer( std::shared_ptr<test_peer> peer_ptr )
+   {
+      this->my->get_thread()->async( [&](){
+            my->move_peer_to_active_list( peer_ptr );
+         }).wait();
+   }
+
+   void request_sync_items( std::shared_ptr<test_peer> peer_ptr,
+                            const std::vector<graphene::net::item_hash_t>& items )
+   {
+      this->my->get_thread()->async( [&](){
+            my->request_sync_items_from_peer( peer_ptr, items );
+         }).wait();
+   }
+
+   void request_lagging_sync_items()
+   {
+      this->my->get_thread()->async( [&](){
+            my->request_lagging_sync_items();
+         }).wait();
+   }
+
    graphene::net::hello_message create_hello_message_from_peer( std::shared_ptr<test_peer> peer_ptr,
                                                                 const graphene::net::chain_id_type& chain_id )
    {
@@ -1002,4 +1024,266 @@ BOOST_AUTO_TEST_CASE( advertising_all_test )
    test_closing_connection_message( msg2 );
 }
 
+BOOST_AUTO_TEST_CASE( lagging_sync_item_is_requested_again )
+{
+   // create a node (node1)
+   int node1_port = fc::network::get_available_port();
+   fc::temp_directory node1_dir( graphene::utilities::temp_directory_path() );
+   test_node node1( "Node1", node1_dir.path(), node1_port );
+
+   // two peers we sync from, both offer the same two blocks
+   std::shared_ptr<test_peer> slow_peer = node1.create_test_peer( "1.2.3.4:5678" ).second;
+   std::shared_ptr<test_peer> other_peer = node1.create_test_peer( "1.2.3.5:5678" ).second;
+   const graphene::net::item_hash_t first_block = fc::ripemd160::hash( std::string( "block 1" ) );
+   const graphene::net::item_hash_t second_block = fc::ripemd160::hash( std::string( "block 2" ) );
+   for( const auto& peer : { slow_peer, other_peer } )
+   {
+      peer->we_need_sync_items_from_peer = true;
+      peer->ids_of_items_to_get.push_back( first_block );
+      peer->ids_of_items_to_get.push_back( second_block );
+      node1.activate_test_peer( peer );
+   }
+
+   // the first block is requested from the slow peer only
+   node1.request_sync_items( slow_peer, { first_block } );
+   BOOST_CHECK_EQUAL( slow_peer->messages_received.size(), 1U );
+   node1.request_lagging_sync_items();
+   BOOST_CHECK( other_peer->messages_received.empty() );
+
+   // when it lags, the other peer is asked too
+   fc::usleep( fc::milliseconds( GRAPHENE_NET_MIN_SYNC_BLOCK_LAG_MS + 100 ) );
+   node1.request_lagging_sync_items();
+   BOOST_REQUIRE_EQUAL( other_peer->messages_received.size(), 1U );
+   const auto fetch = other_peer->messages_received.front().as<graphene::net::fetch_items_message>();
+   BOOST_REQUIRE_EQUAL( fetch.items_to_fetch.size(), 1U );
+   BOOST_CHECK( fetch.items_to_fetch.front() == first_block );
+   BOOST_CHECK( other_peer->sync_items_requested_from_peer.count( first_block ) == 1U );
+   BOOST_CHECK( slow_peer->sync_items_requested_from_peer.count( first_block ) == 1U );
+
+   // but only once
+   node1.request_lagging_sync_items();
+   BOOST_CHECK_EQUAL( other_peer->messages_received.size(), 1U );
+   BOOST_CHECK_EQUAL( slow_peer->messages_received.size(), 1U );
+}
+
+BOOST_AUTO_TEST_CASE( compact_block_relay )
+{
+   // create a node (node1)
+   int node1_port = fc::network::get_available_port();
+   fc::temp_directory node1_dir( graphene::utilities::temp_directory_path() );
+   test_node node1( "Node1", node1_dir.path(), node1_port );
+
+   // a block with two transactions
+   graphene::protocol::signed_block block;
+   for( uint16_t i = 0; i < 2; ++i )
+   {
+      graphene::protocol::processed_transaction trx;
+      trx.ref_block_num = i;
+      trx.operation_results.emplace_back( graphene::protocol::void_result() );
+      block.transactions.push_back( trx );
+   }
+   const graphene::net::message full_block_message{ graphene::net::block_message( block ) };
+   const graphene::net::message_hash_type full_block_hash = full_block_message.id();
+   node1.broadcast( full_block_message );
+
+   // the compact form carries the header and the short ids of the transactions
+   const graphene::net::compact_block_message compact( full_block_message.as<graphene::net::block_message>(),
+                                                       full_block_hash );
+   BOOST_CHECK( compact.item_hash == full_block_hash );
+   BOOST_CHECK( compact.block_id == block.id() );
+   BOOST_REQUIRE_EQUAL( compact.transactions.size(), 2U );
+   BOOST_CHECK_EQUAL( compact.transactions[1].short_id,
+                      graphene::net::get_compact_block_short_id( block.transactions[1].id() ) );
+   BOOST_CHECK_EQUAL( compact.transactions[1].operation_results.size(), 1U );
+
+   // a peer supporting compact blocks gets the block from the cache in compact form
+   std::shared_ptr<test_peer> peer = node1.create_test_peer( "1.2.3.4:5678" ).second;
+   peer->their_state = test_peer::their_connection_state::connection_accepted;
+   peer->supports_compact_blocks = true;
+   node1.on_message( peer, graphene::net::fetch_items_message( graphene::net::block_message_type,
+                                                               { full_block_hash } ) );
+   BOOST_REQUIRE_EQUAL( peer->messages_received.size(), 1U );
+   BOOST_REQUIRE( peer->messages_received.front().msg_type.value() == graphene::net::compact_block_message::type );
+   const auto received = peer->messages_received.front().as<graphene::net::compact_block_message>();
+   BOOST_CHECK( received.item_hash == full_block_hash );
+   BOOST_CHECK_EQUAL( received.transactions.size(), 2U );
+
+   // and the transactions it is missing on request
+   node1.on_message( peer, graphene::net::get_compact_block_transactions_message( full_block_hash, block.id(),
+                                                                                  { 1 } ) );
+   BOOST_REQUIRE_EQUAL( peer->messages_received.size(), 2U );
+   const auto transactions = peer->messages_received.back().as<graphene::net::compact_block_transactions_message>();
+   BOOST_CHECK( transactions.block_id == block.id() );
+   BOOST_REQUIRE_EQUAL( transactions.transactions.size(), 1U );
+   BOOST_CHECK( transactions.transactions.front().id() == block.transactions[1].id() );
+}
+
+BOOST_AUTO_TEST_CASE( message_payload_is_shared )
+{
+   graphene::net::address_message addresses;
+   addresses.addresses.resize( 10 );
+   const graphene::net::message original( addresses );
+   BOOST_CHECK_EQUAL( original.data.use_count(), 1 );
+
+   // copies share the payload
+   std::vector<graphene::net::message> queued( 10, original );
+   BOOST_CHECK_EQUAL( original.data.use_count(), 11 );
+   for( const auto& m : queued )
+      BOOST_CHECK( m.data.data() == original.data.data() );
+   BOOST_CHECK( queued.front().id() == original.id() );
+   BOOST_CHECK_EQUAL( queued.back().as<graphene::net::address_message>().addresses.size(), 10U );
+
+   // assigning a new payload leaves the others untouched
+   graphene::net::message changed( original );
+   std::vector<char> bytes = changed.data.bytes();
+   bytes[0] ^= 1;
+   changed.data = std::move( bytes );
+   BOOST_CHECK( changed.data.data() != original.data.data() );
+   BOOST_CHECK( !( changed.data == original.data ) );
+   BOOST_CHECK( queued.front().data == original.data );
+
+   // serialization is the one of a vector of bytes
+   const auto packed = fc::raw::pack( original );
+   const auto unpacked = fc::raw::unpack<graphene::net::message>( packed );
+   BOOST_CHECK_EQUAL( unpacked.msg_type.value(), original.msg_type.value() );
+   BOOST_CHECK( unpacked.data == original.data );
+   BOOST_CHECK( unpacked.id() == original.id() );
+   BOOST_CHECK( fc::raw::pack( original.data ) == fc::raw::pack( original.data.bytes() ) );
+
+   queued.clear();
+   BOOST_CHECK_EQUAL( original.data.use_count(), 1 );
+
+   // an empty payload
+   const graphene::net::message empty;
+   BOOST_CHECK( empty.data.empty() );
+   BOOST_CHECK( fc::raw::pack( empty.data ) == fc::raw::pack( std::vector<char>() ) );
+}
+
+BOOST_AUTO_TEST_CASE( send_lanes_block_lane_first )
+{
+   using graphene::net::send_lane_scheduler;
+   send_lane_scheduler lanes;
+   send_lane_scheduler::lane lane;
+   BOOST_CHECK( !lanes.select( lane ) );
+
+   lanes.on_queued( send_lane_scheduler::transaction_lane, 100 );
+   lanes.on_queued( send_lane_scheduler::sync_lane, 100 );
+   lanes.on_queued( send_lane_scheduler::block_lane, 100 );
+   lanes.on_queued( send_lane_scheduler::block_lane, 100 );
+
+   // the block lane is drained before the other lanes get a turn
+   for( int i = 0; i < 2; ++i )
+   {
+      BOOST_REQUIRE( lanes.select( lane ) );
+      BOOST_CHECK_EQUAL( lane, send_lane_scheduler::block_lane );
+      lanes.on_sent( lane, 100, 100 );
+   }
+   BOOST_CHECK_EQUAL( lanes.get_queued_messages( send_lane_scheduler::block_lane ), 0U );
+   for( int i = 0; i < 2; ++i )
+   {
+      BOOST_REQUIRE( lanes.select( lane ) );
+      BOOST_CHECK( lane != send_lane_scheduler::block_lane );
+      lanes.on_sent( lane, 100, 100 );
+   }
+   BOOST_CHECK( !lanes.select( lane ) );
+}
+
+BOOST_AUTO_TEST_CASE( send_lanes_byte_budgets )
+{
+   using graphene::net::send_lane_scheduler;
+   send_lane_scheduler lanes;
+   const auto tx_lane = send_lane_scheduler::transaction_lane;
+   const size_t budget = send_lane_scheduler::get_budget_in_bytes( tx_lane );
+
+   BOOST_CHECK( lanes.has_room( tx_lane, budget ) );
+   BOOST_CHECK( !lanes.has_room( tx_lane, budget + 1 ) );
+   lanes.on_queued( tx_lane, budget - 10 );
+   BOOST_CHECK( lanes.has_room( tx_lane, 10 ) );
+   BOOST_CHECK( !lanes.has_room( tx_lane, 11 ) );
+   BOOST_CHECK_EQUAL( lanes.get_queued_bytes( tx_lane ), budget - 10 );
+
+   // each lane has its own budget
+   BOOST_CHECK( lanes.has_room( send_lane_scheduler::block_lane,
+                                send_lane_scheduler::get_budget_in_bytes( send_lane_scheduler::block_lane ) ) );
+   BOOST_CHECK( lanes.has_room( send_lane_scheduler::sync_lane,
+                                send_lane_scheduler::get_budget_in_bytes( send_lane_scheduler::sync_lane ) ) );
+
+   // the room is given back by the size the message took in the queue, not by the bytes sent
+   send_lane_scheduler::lane lane;
+   BOOST_REQUIRE( lanes.select( lane ) );
+   BOOST_CHECK_EQUAL( lane, tx_lane );
+   lanes.on_sent( lane, budget - 10, 42 );
+   BOOST_CHECK_EQUAL( lanes.get_queued_bytes( tx_lane ), 0U );
+   BOOST_CHECK( lanes.has_room( tx_lane, budget ) );
+}
+
+BOOST_AUTO_TEST_CASE( send_lanes_deficit_round_robin )
+{
+   using graphene::net::send_lane_scheduler;
+   send_lane_scheduler lanes;
+   const auto sync_lane = send_lane_scheduler::sync_lane;
+   const auto tx_lane = send_lane_scheduler::transaction_lane;
+   // items are queued as hashes, the turns are charged with the messages sent
+   const size_t queued_size = 32;
+   const size_t message_size = send_lane_scheduler::get_quantum_in_bytes( tx_lane ) / 4;
+   BOOST_REQUIRE_EQUAL( send_lane_scheduler::get_quantum_in_bytes( sync_lane ),
+                        2 * send_lane_scheduler::get_quantum_in_bytes( tx_lane ) );
+   for( int i = 0; i < 100; ++i )
+   {
+      lanes.on_queued( sync_lane, queued_size );
+      lanes.on_queued( tx_lane, queued_size );
+   }
+
+   // a lane keeps its turn until it has sent its quantum, the sync lane gets twice the bytes
+   std::string order;
+   send_lane_scheduler::lane lane;
+   for( int i = 0; i < 36; ++i )
+   {
+      BOOST_REQUIRE( lanes.select( lane ) );
+      order += ( lane == sync_lane ? 'S' : 'T' );
+      lanes.on_sent( lane, queued_size, message_size );
+   }
+   BOOST_CHECK_EQUAL( order, "TTTTSSSSSSSSTTTTSSSSSSSSTTTTSSSSSSSS" );
+
+   // a lane that runs empty gives up the rest of its turn
+   while( lanes.get_queued_messages( sync_lane ) > 0 )
+   {
+      BOOST_REQUIRE( lanes.select( lane ) );
+      lanes.on_sent( lane, queued_size, message_size );
+   }
+   BOOST_REQUIRE( lanes.select( lane ) );
+   BOOST_CHECK_EQUAL( lane, tx_lane );
+}
+
+BOOST_AUTO_TEST_CASE( send_lanes_keep_blocks_in_order )
+{
+   using graphene::net::send_lane_scheduler;
+   send_lane_scheduler lanes;
+
+   // blocks of a peer that is syncing from us go in the sync lane
+   BOOST_CHECK_EQUAL( lanes.get_block_lane( true ), send_lane_scheduler::sync_lane );
+   BOOST_CHECK_EQUAL( lanes.get_block_lane( false ), send_lane_scheduler::block_lane );
+
+   // after the sync, a new block or compact block must not overtake the blocks still in the sync lane
+   lanes.on_queued( send_lane_scheduler::sync_lane, 32 );
+   BOOST_CHECK_EQUAL( lanes.get_block_lane( false ), send_lane_scheduler::sync_lane );
+   lanes.on_queued( send_lane_scheduler::sync_lane, 32 );
+
+   send_lane_scheduler::lane lane;
+   for( int i = 0; i < 2; ++i )
+   {
+      BOOST_REQUIRE( lanes.select( lane ) );
+      BOOST_CHECK_EQUAL( lane, send_lane_scheduler::sync_lane );
+      lanes.on_sent( lane, 32, 1000 );
+   }
+   BOOST_CHECK( !lanes.select( lane ) );
+
+   // once it is drained, blocks use the block lane again, which is sent before any later sync messages
+   BOOST_CHECK_EQUAL( lanes.get_block_lane( false ), send_lane_scheduler::block_lane );
+   lanes.on_queued( send_lane_scheduler::block_lane, 32 );
+   lanes.on_queued( send_lane_scheduler::sync_lane, 32 );
+   BOOST_REQUIRE( lanes.select( lane ) );
+   BOOST_CHECK_EQUAL( lane, send_lane_scheduler::block_lane );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -27,6 +27,7 @@
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/vote_tally_engine.hpp>
 
 #include <iostream>
 
@@ -981,4 +982,226 @@ BOOST_AUTO_TEST_CASE( committee_votes_calculation )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( vote_tally_engine_test )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   set_expiration( db, trx );
+
+   ACTORS( (alice)(bob)(carol) );
+   fund( alice_id(db), asset(10000) );
+   fund( bob_id(db), asset(10000) );
+   fund( carol_id(db), asset(10000) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).get_id();
+
+   const witness_id_type wit_id = *db.get_global_properties().active_witnesses.begin();
+   const vote_id_type wit_vote = wit_id(db).vote_id;
+
+   // alice votes directly, bob through alice as proxy, carol votes but has no core in orders
+   auto update_options = [this]( account_id_type acct, account_id_type proxy, const flat_set<vote_id_type>& votes ) {
+      account_update_operation op;
+      op.account = acct;
+      op.new_options = acct(db).options;
+      op.new_options->voting_account = proxy;
+      op.new_options->votes = votes;
+      op.new_options->num_witness = votes.empty() ? 0 : 1;
+      trx.operations.clear();
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   };
+   update_options( alice_id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { wit_vote } );
+   update_options( bob_id, alice_id, {} );
+   update_options( carol_id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { wit_vote } );
+
+   create_sell_order( alice_id, asset(1000), asset(1000, usd_id) );
+   create_sell_order( bob_id, asset(300), asset(300, usd_id) );
+
+   const uint64_t votes_before = wit_id(db).total_votes;
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, votes_before + 1300 );
+   const auto& alice_stats = alice_id(db).statistics(db);
+   BOOST_CHECK_EQUAL( alice_stats.vp_all, 1300u );
+   BOOST_CHECK_EQUAL( alice_stats.vp_witness, 1300u );
+   BOOST_CHECK( alice_stats.vote_tally_time == db.get_dynamic_global_properties().last_vote_tally_time );
+   BOOST_CHECK_EQUAL( bob_id(db).statistics(db).vp_all, 0u );
+   BOOST_CHECK_EQUAL( carol_id(db).statistics(db).vp_all, 0u );
+
+   // an undone change of the votes is undone in the engine as well
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.modify( alice_id(db), []( account_object& a ) {
+         a.options.votes.clear();
+         a.options.num_witness = 0;
+      });
+      session.undo();
+   }
+   // bob votes on his own now
+   update_options( bob_id, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { wit_vote } );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, votes_before + 1300 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1000u );
+   BOOST_CHECK_EQUAL( bob_id(db).statistics(db).vp_all, 300u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( incremental_vote_tally_test )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   set_expiration( db, trx );
+   // only the first tally and undone tallies are full recounts
+   db.set_vote_tally_full_recount_interval( 0 );
+
+   ACTORS( (alice)(bob) );
+   fund( alice_id(db), asset(10000) );
+   fund( bob_id(db), asset(10000) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).get_id();
+
+   const witness_id_type wit_id = *db.get_global_properties().active_witnesses.begin();
+   const vote_id_type wit_vote = wit_id(db).vote_id;
+
+   {
+      account_update_operation op;
+      op.account = alice_id;
+      op.new_options = alice_id(db).options;
+      op.new_options->votes = { wit_vote };
+      op.new_options->num_witness = 1;
+      trx.operations.push_back( op );
+      op.account = bob_id;
+      op.new_options = bob_id(db).options;
+      op.new_options->voting_account = alice_id;
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+
+   create_sell_order( alice_id, asset(1000), asset(1000, usd_id) );
+   const limit_order_id_type bob_order = create_sell_order( bob_id, asset(300), asset(300, usd_id) )->get_id();
+
+   const uint64_t votes_before = wit_id(db).total_votes;
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, votes_before + 1300 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1300u );
+
+   // the changed stake of bob is counted without a full recount
+   cancel_limit_order( bob_order(db) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, votes_before + 1000 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1000u );
+
+   create_sell_order( bob_id, asset(300), asset(300, usd_id) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, votes_before + 1300 );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1300u );
+
+   // nobody votes for a year, the voting power decays with time alone
+   const auto full_power_seconds = detail::vote_recalc_options::witness().full_power_seconds;
+   generate_blocks( alice_id(db).statistics(db).last_vote_time + full_power_seconds + 86400 );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   set_expiration( db, trx );
+
+   const auto incremental_stats = alice_id(db).statistics(db);
+   const uint64_t incremental_votes = wit_id(db).total_votes;
+   BOOST_CHECK_EQUAL( incremental_stats.vp_all, 1300u );
+   BOOST_CHECK_LT( incremental_stats.vp_active, 1300u );
+   BOOST_CHECK_LT( incremental_stats.vp_witness, incremental_stats.vp_active );
+
+   // the same maintenance block gives the same result with a full recount
+   const signed_block maintenance_block = *db.fetch_block_by_number( db.head_block_num() );
+   db.pop_block();
+   db.set_vote_tally_full_recount_interval( 1 );
+   PUSH_BLOCK( db, maintenance_block );
+
+   const auto& full_stats = alice_id(db).statistics(db);
+   BOOST_CHECK_EQUAL( wit_id(db).total_votes, incremental_votes );
+   BOOST_CHECK_EQUAL( full_stats.vp_all, incremental_stats.vp_all );
+   BOOST_CHECK_EQUAL( full_stats.vp_active, incremental_stats.vp_active );
+   BOOST_CHECK_EQUAL( full_stats.vp_committee, incremental_stats.vp_committee );
+   BOOST_CHECK_EQUAL( full_stats.vp_witness, incremental_stats.vp_witness );
+   BOOST_CHECK_EQUAL( full_stats.vp_worker, incremental_stats.vp_worker );
+} FC_LOG_AND_RETHROW() }
+
+
+BOOST_AUTO_TEST_CASE( vote_tally_self_check_test )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   set_expiration( db, trx );
+   // every incremental tally is compared to a full recount, a mismatch fails the maintenance block
+   db.set_vote_tally_full_recount_interval( 0 );
+   db.set_vote_tally_self_check( true );
+
+   ACTORS( (alice)(bob) );
+   fund( alice_id(db), asset(10000) );
+   fund( bob_id(db), asset(10000) );
+   const asset_id_type usd_id = create_user_issued_asset( "USD" ).get_id();
+
+   const witness_id_type wit_id = *db.get_global_properties().active_witnesses.begin();
+   const vote_id_type wit_vote = wit_id(db).vote_id;
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+   auto is_top_voter = [&db_api]( account_id_type acct ) {
+      const auto top_voters = db_api.get_top_voters( 10 );
+      return std::any_of( top_voters.begin(), top_voters.end(),
+                          [acct]( const account_statistics_object& s ) { return s.owner == acct; } );
+   };
+
+   {
+      account_update_operation op;
+      op.account = alice_id;
+      op.new_options = alice_id(db).options;
+      op.new_options->votes = { wit_vote };
+      op.new_options->num_witness = 1;
+      trx.operations.push_back( op );
+      op.account = bob_id;
+      op.new_options = bob_id(db).options;
+      op.new_options->voting_account = alice_id;
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+
+   const limit_order_id_type alice_order = create_sell_order( alice_id, asset(1000), asset(1000, usd_id) )->get_id();
+   const limit_order_id_type bob_order = create_sell_order( bob_id, asset(300), asset(300, usd_id) )->get_id();
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1300u );
+
+   // an unchanged voting power is written with the time of every tally
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   set_expiration( db, trx );
+   BOOST_CHECK( alice_id(db).statistics(db).vote_tally_time
+                == db.get_dynamic_global_properties().last_vote_tally_time );
+   BOOST_CHECK( is_top_voter( alice_id ) );
+
+   // undone changes of the stake and of the votes
+   {
+      auto session = db._undo_db.start_undo_session();
+      cancel_limit_order( bob_order(db) );
+      db.modify( alice_id(db), []( account_object& a ) {
+         a.options.votes.clear();
+         a.options.num_witness = 0;
+      });
+      session.undo();
+   }
+   cancel_limit_order( bob_order(db) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1000u );
+
+   // an undone maintenance block applied again
+   const signed_block maintenance_block = *db.fetch_block_by_number( db.head_block_num() );
+   db.pop_block();
+   PUSH_BLOCK( db, maintenance_block );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1000u );
+
+   // an account which is not counted anymore keeps its last voting power, but is not a top voter anymore
+   set_expiration( db, trx );
+   cancel_limit_order( alice_order(db) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_CHECK_EQUAL( alice_id(db).statistics(db).vp_all, 1000u );
+   BOOST_CHECK( alice_id(db).statistics(db).vote_tally_time
+                < db.get_dynamic_global_properties().last_vote_tally_time );
+   BOOST_CHECK( !is_top_voter( alice_id ) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()